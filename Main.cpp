@@ -16,11 +16,42 @@
 #include <algorithm>
 #include <iomanip>
 #include <limits>
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include <condition_variable>
+#include <thread>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <deque>
+#include <set>
+#include <tuple>
+#include <unordered_map>
+#include <unordered_set>
+#include <filesystem>
 #include <cstdio> // for remove in clear screen
+#include <cstdlib>
+#include <cstring>
+#include <cmath>
+#include <cctype>
+#include <stdexcept>
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define VCLASS_SSE2 1
+#else
+#define VCLASS_SSE2 0
+#endif
 #ifdef _WIN32
 #include <windows.h>
+#include <io.h>
 #else
 #include <unistd.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <sys/wait.h>
 #endif
 
 // ANSI console color codes for gray text and emphasis (some terminals support)
@@ -37,321 +68,9868 @@ void ClearScreen() {
 #endif
 }
 
-// Model: Manages data storage for classes and students
-class Model {
-public:
-    Model() {
-        LoadData();
+// CRC-32 (IEEE 802.3) used to detect torn or corrupted snapshot files
+uint32_t Crc32(const char* data, size_t size, uint32_t crc = 0) {
+    static const std::vector<uint32_t> table = [] {
+        std::vector<uint32_t> t(256);
+        for (uint32_t i = 0; i < 256; ++i) {
+            uint32_t c = i;
+            for (int k = 0; k < 8; ++k) c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+            t[i] = c;
+        }
+        return t;
+    }();
+    crc = ~crc;
+    for (size_t i = 0; i < size; ++i) crc = table[(crc ^ static_cast<unsigned char>(data[i])) & 0xFF] ^ (crc >> 8);
+    return ~crc;
+}
+
+// Snapshot files end with a trailer line carrying the body's size and CRC
+const std::string kSnapshotTrailer = "#vclass-snapshot ";
+
+// Force a written file (or, on POSIX, a directory) to stable storage
+bool SyncFile(std::FILE* file) {
+    if (std::fflush(file) != 0) return false;
+#ifdef _WIN32
+    return _commit(_fileno(file)) == 0;
+#else
+    return fsync(fileno(file)) == 0;
+#endif
+}
+
+void SyncDirectory(const std::string& dir) {
+#ifndef _WIN32
+    int fd = open(dir.c_str(), O_RDONLY);
+    if (fd >= 0) {
+        fsync(fd);
+        close(fd);
+    }
+#else
+    (void)dir; // NTFS metadata is journaled; MOVEFILE_WRITE_THROUGH covers the rename
+#endif
+}
+
+// Write body plus checksum trailer to staged and fsync it
+bool StageSnapshotFile(const std::string& staged, const std::string& body) {
+    std::FILE* out = std::fopen(staged.c_str(), "wb");
+    if (!out) return false;
+
+    std::ostringstream trailer;
+    trailer << kSnapshotTrailer << "size=" << body.size() << " crc32="
+            << std::hex << std::setw(8) << std::setfill('0') << Crc32(body.data(), body.size()) << '\n';
+    const std::string tail = trailer.str();
+    bool ok = std::fwrite(body.data(), 1, body.size(), out) == body.size()
+           && std::fwrite(tail.data(), 1, tail.size(), out) == tail.size()
+           && SyncFile(out);
+    ok = std::fclose(out) == 0 && ok;
+    if (!ok) std::remove(staged.c_str());
+    return ok;
+}
+
+// Keep the current path as path.prev and atomically rename staged over path
+bool InstallSnapshotFile(const std::string& staged, const std::string& path) {
+    const std::string prev = path + ".prev";
+    bool ok;
+#ifdef _WIN32
+    if (GetFileAttributesA(path.c_str()) != INVALID_FILE_ATTRIBUTES) {
+        CopyFileA(path.c_str(), prev.c_str(), FALSE);
     }
+    ok = MoveFileExA(staged.c_str(), path.c_str(), MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH) != 0;
+#else
+    unlink(prev.c_str());
+    link(path.c_str(), prev.c_str()); // fails harmlessly on first save
+    ok = std::rename(staged.c_str(), path.c_str()) == 0;
+#endif
+    if (ok) SyncDirectory(".");
+    return ok;
+}
 
-    // Add a class if name is unique
-    bool AddClass(const std::string& className) {
-        if (!Exists(classes, className)) {
-            classes.push_back(className);
-            SaveData();
-            return true;
+// Crash-safe replacement of path with body plus checksum trailer. The data goes
+// to path.tmp and is fsynced; the current file is kept as path.prev; then
+// path.tmp is atomically renamed over path. At every instant path is either the
+// complete old snapshot or the complete new one.
+bool WriteSnapshotFile(const std::string& path, const std::string& body) {
+    return StageSnapshotFile(path + ".tmp", body) && InstallSnapshotFile(path + ".tmp", path);
+}
+
+// Replace several snapshot files as one. Each body is staged in path.staged
+// and fsynced; then the list of paths is written to manifest as a snapshot
+// of its own, which is the commit point; only then is each staged file
+// installed. A crash before the manifest lands leaves every file as it was,
+// and RecoverSnapshotBatch discards the staged copies; after it,
+// RecoverSnapshotBatch finishes the installs.
+bool WriteSnapshotBatch(const std::string& manifest, const std::vector<std::pair<std::string, std::string>>& files) {
+    if (files.size() == 1) return WriteSnapshotFile(files[0].first, files[0].second);
+    std::string list;
+    for (const auto& file : files) {
+        if (!StageSnapshotFile(file.first + ".staged", file.second)) {
+            for (const auto& staged : files) std::remove((staged.first + ".staged").c_str());
+            return false;
         }
+        list += file.first + '\n';
+    }
+    if (!WriteSnapshotFile(manifest, list)) return false;
+    bool ok = true;
+    for (const auto& file : files) ok = InstallSnapshotFile(file.first + ".staged", file.first) && ok;
+    if (ok) {
+        std::remove(manifest.c_str());
+        SyncDirectory(".");
+    }
+    return ok;
+}
+
+// Read a snapshot file and verify its trailer. A trailer that does not match
+// the body marks a torn or corrupted write. Files written before trailers
+// existed have none; they are accepted only when allowLegacy is set.
+bool ReadSnapshotFile(const std::string& path, std::string& body, bool allowLegacy) {
+    std::ifstream in(path, std::ios::binary);
+    if (!in.is_open()) return false;
+    std::string content((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+
+    // The trailer must be the last line; anything after it is corruption
+    size_t lineStart = content.compare(0, kSnapshotTrailer.size(), kSnapshotTrailer) == 0
+        ? 0 : content.rfind("\n" + kSnapshotTrailer);
+    if (lineStart == std::string::npos) {
+        if (!allowLegacy) return false;
+        body = std::move(content);
+        return true;
+    }
+    if (lineStart > 0) ++lineStart;
+    if (content.find('\n', lineStart) != content.size() - 1) return false;
+
+    size_t expectedSize = 0;
+    uint32_t expectedCrc = 0;
+    std::istringstream fields(content.substr(lineStart + kSnapshotTrailer.size()));
+    std::string sizeField, crcField;
+    fields >> sizeField >> crcField;
+    if (sizeField.compare(0, 5, "size=") != 0 || crcField.compare(0, 6, "crc32=") != 0) return false;
+    try {
+        expectedSize = std::stoull(sizeField.substr(5));
+        expectedCrc = static_cast<uint32_t>(std::stoul(crcField.substr(6), nullptr, 16));
+    } catch (const std::exception&) {
         return false;
     }
+    if (expectedSize != lineStart || Crc32(content.data(), lineStart) != expectedCrc) return false;
 
-    // Add a student if name is unique
-    bool AddStudent(const std::string& studentName) {
-        if (!Exists(students, studentName)) {
-            students.push_back(studentName);
-            SaveData();
-            return true;
+    content.resize(lineStart);
+    body = std::move(content);
+    return true;
+}
+
+// Load the newest intact copy of a snapshot: the file itself, else a fully
+// written path.tmp that never got renamed, else path.prev (always a complete
+// former snapshot). A torn path.tmp is discarded. Returns false when there is
+// no usable snapshot.
+bool RecoverSnapshotFile(const std::string& path, std::string& body) {
+    const std::string tmp = path + ".tmp", prev = path + ".prev";
+    bool found = ReadSnapshotFile(path, body, true);
+    if (!found && ReadSnapshotFile(tmp, body, false)) {
+        found = true;
+        std::rename(tmp.c_str(), path.c_str());
+        std::cerr << "Recovered " << path << " from an unfinished save.\n";
+    } else if (!found && ReadSnapshotFile(prev, body, true)) {
+        found = true;
+        std::remove(path.c_str());
+        std::rename(prev.c_str(), path.c_str());
+        std::cerr << "Recovered " << path << " from its previous snapshot; the latest save was torn.\n";
+    } else if (!found && std::ifstream(path).is_open()) {
+        std::cerr << "Warning: " << path << " is corrupt and no intact copy exists; ignoring it.\n";
+    }
+    std::remove(tmp.c_str());
+    return found;
+}
+
+// Run before loading the files of a batch: finish a committed batch, or
+// discard the staged files of one that never reached its commit point. Only
+// the staged copies of owned (every path the caller's batches may write) are
+// touched.
+void RecoverSnapshotBatch(const std::string& manifest, const std::vector<std::string>& owned) {
+    std::string list, body, path;
+    if (ReadSnapshotFile(manifest, list, false)) {
+        std::istringstream paths(list);
+        while (std::getline(paths, path)) {
+            if (std::find(owned.begin(), owned.end(), path) == owned.end()) continue;
+            if (ReadSnapshotFile(path + ".staged", body, false)) InstallSnapshotFile(path + ".staged", path);
         }
-        return false;
+        std::cerr << "Finished a multi-file save interrupted by a crash.\n";
     }
+    for (const auto& file : owned) std::remove((file + ".staged").c_str());
+    std::remove(manifest.c_str());
+    std::remove((manifest + ".tmp").c_str());
+    std::remove((manifest + ".prev").c_str());
+    SyncDirectory(".");
+}
 
-    const std::vector<std::string>& GetClasses() const { return classes; }
-    const std::vector<std::string>& GetStudents() const { return students; }
+// Epoch-based reclamation for retired roster versions and evicted pages. Each
+// reader announces the epoch it entered in; an object retired in epoch E is
+// freed once every active reader entered after E.
+class EpochManager {
+public:
+    static constexpr size_t kSlots = 128;
 
-private:
-    std::vector<std::string> classes;
-    std::vector<std::string> students;
+    EpochManager() {
+        for (auto& slot : slots) slot.epoch.store(kIdle);
+    }
 
-    bool Exists(const std::vector<std::string>& vec, const std::string& val) {
-        return std::find(vec.begin(), vec.end(), val) != vec.end();
+    ~EpochManager() {
+        for (auto& r : retired) r.destroy(r.object);
     }
 
-    void LoadData() {
-        // Load classes from "classes.txt"
-        std::ifstream finClasses("classes.txt");
-        if (finClasses.is_open()) {
-            std::string line;
-            while (std::getline(finClasses, line)) {
-                Trim(line);
-                if (!line.empty()) classes.push_back(line);
+    // Claim a reader slot and record the current epoch in it
+    size_t Enter() {
+        size_t start = std::hash<std::thread::id>()(std::this_thread::get_id()) % kSlots;
+        for (;;) {
+            for (size_t i = 0; i < kSlots; ++i) {
+                Slot& slot = slots[(start + i) % kSlots];
+                uint64_t expected = kIdle;
+                if (slot.epoch.compare_exchange_strong(expected, kEntering)) {
+                    slot.epoch.store(globalEpoch.load());
+                    return (start + i) % kSlots;
+                }
             }
-            finClasses.close();
+            std::this_thread::yield();
         }
-        // Load students from "students.txt"
-        std::ifstream finStudents("students.txt");
-        if (finStudents.is_open()) {
-            std::string line;
-            while (std::getline(finStudents, line)) {
-                Trim(line);
-                if (!line.empty()) students.push_back(line);
-            }
-            finStudents.close();
+    }
+
+    void Exit(size_t slot) {
+        slots[slot].epoch.store(kIdle, std::memory_order_release);
+    }
+
+    // Retire an object that has already been unpublished
+    template <typename T>
+    void Retire(const T* object) {
+        std::lock_guard<std::mutex> lock(retiredMutex);
+        uint64_t epoch = globalEpoch.fetch_add(1);
+        retired.push_back({object, epoch, [](const void* p) { delete static_cast<const T*>(p); }});
+        Reclaim();
+    }
+
+    // Free every retired object no active reader can still see. Caller holds
+    // retiredMutex.
+    void Reclaim() {
+        uint64_t oldestReader = std::numeric_limits<uint64_t>::max();
+        for (const auto& slot : slots) {
+            uint64_t e = slot.epoch.load();
+            if (e != kIdle) oldestReader = std::min(oldestReader, e);
         }
+        auto keep = std::remove_if(retired.begin(), retired.end(), [&](const Retired& r) {
+            if (r.epoch >= oldestReader) return false;
+            r.destroy(r.object);
+            return true;
+        });
+        retired.erase(keep, retired.end());
     }
 
-    void SaveData() {
-        // Save classes
-        std::ofstream foutClasses("classes.txt", std::ios::trunc);
-        for (const auto& c : classes) foutClasses << c << '\n';
-        foutClasses.close();
+    size_t PendingCount() const {
+        std::lock_guard<std::mutex> lock(retiredMutex);
+        return retired.size();
+    }
 
-        // Save students
-        std::ofstream foutStudents("students.txt", std::ios::trunc);
-        for (const auto& s : students) foutStudents << s << '\n';
-        foutStudents.close();
+private:
+    static constexpr uint64_t kIdle = 0;
+    static constexpr uint64_t kEntering = 1; // slot claimed, epoch not yet recorded
+
+    struct alignas(64) Slot {
+        std::atomic<uint64_t> epoch;
+    };
+
+    struct Retired {
+        const void* object;
+        uint64_t epoch;
+        void (*destroy)(const void*);
+    };
+
+    Slot slots[kSlots];
+    std::atomic<uint64_t> globalEpoch{2};
+    mutable std::mutex retiredMutex;
+    std::vector<Retired> retired;
+};
+
+// Spill encodings for page contents; every PagedList element type has a set
+inline size_t PageItemBytes(const std::vector<std::string>& items) {
+    size_t bytes = items.capacity() * sizeof(std::string);
+    for (const auto& s : items) bytes += s.capacity() > 15 ? s.capacity() + 1 : 0;
+    return bytes;
+}
+
+inline void EncodePageItems(const std::vector<std::string>& items, std::string& out) {
+    for (const auto& s : items) {
+        uint32_t length = static_cast<uint32_t>(s.size());
+        out.append(reinterpret_cast<const char*>(&length), 4);
+        out += s;
     }
+}
 
-    // Trim helper
-    static void Trim(std::string& s) {
-        const char* whitespace = " \t\n\r\f\v";
-        s.erase(s.find_last_not_of(whitespace) + 1);
-        s.erase(0, s.find_first_not_of(whitespace));
+inline bool DecodePageItems(const std::string& in, std::vector<std::string>& items) {
+    for (size_t pos = 0; pos < in.size();) {
+        uint32_t length;
+        if (in.size() - pos < 4) return false;
+        std::memcpy(&length, in.data() + pos, 4);
+        pos += 4;
+        if (in.size() - pos < length) return false;
+        items.emplace_back(in.data() + pos, length);
+        pos += length;
     }
+    return true;
+}
+
+// A roster page the PageCache can drop from memory
+class CachedPage {
+public:
+    virtual ~CachedPage() = default;
+    // Write the page to the spill file if needed and free its contents;
+    // false if it is busy or already out
+    virtual bool Evict() = 0;
+
+    mutable std::atomic<bool> referenced{true}; // clock bit, set on every access
 };
 
-// View: Manages all console output and input UI
-class View {
+// Memory budget for roster pages. Tracks the bytes of every resident page;
+// once over budget it sweeps full pages in clock order, writes each to the
+// spill file the first time it is evicted, and drops it. The next access
+// faults it back in. Evicted contents are retired through the EpochManager,
+// so references a pinned reader already holds stay valid.
+class PageCache {
 public:
-    View() = default;
+    struct Stats {
+        size_t budgetBytes = 0;
+        size_t residentBytes = 0;
+        size_t trackedPages = 0;
+        uint64_t evictions = 0;
+        uint64_t faults = 0;
+        uint64_t spillFileBytes = 0;
+    };
 
-    // Display header with app name and top nav
-    void DisplayHeader() {
-        ClearScreen();
-        using namespace std;
-        cout << COLOR_BOLD;
-        cout << "=============================================\n";
-        cout << "                VCLASS 1.0                   \n";
-        cout << "=============================================\n" << COLOR_RESET;
-        cout << "\n";
-        cout << COLOR_GRAY;
-        cout << "1. Add Class     2. Add Student     3. View Classes\n";
-        cout << "4. View Students 5. Quit\n";
-        cout << COLOR_RESET << "\n";
-    }
+    PageCache(size_t budgetBytes, const std::string& spillPath, EpochManager& epochs)
+        : budget(budgetBytes), spillPath(spillPath), epochs(epochs) {}
 
-    // Prompt user for menu choice
-    int PromptMainMenuChoice() {
-        std::cout << "Choose an option (1-5): ";
-        int choice = 0;
-        while (!(std::cin >> choice) || choice < 1 || choice > 5) {
-            std::cout << "Invalid input. Enter 1-5: ";
-            std::cin.clear();
-            std::cin.ignore(std::numeric_limits<std::streamsize>::max(), '\n');
+    ~PageCache() {
+        if (spill) {
+            std::fclose(spill);
+            std::remove(spillPath.c_str());
         }
-        std::cin.ignore(std::numeric_limits<std::streamsize>::max(), '\n'); // flush newline
-        return choice;
     }
 
-    // Prompt for a non-empty string with a label, return result trimmed
-    std::string PromptNonEmptyString(const std::string& prompt) {
-        std::string input;
-        do {
-            std::cout << prompt;
-            std::getline(std::cin, input);
-            Trim(input);
-            if (input.empty()) std::cout << "Input cannot be empty. Try again.\n";
-        } while (input.empty());
-        return input;
+    // Make a full page eligible for eviction
+    void Track(const std::shared_ptr<CachedPage>& page) {
+        std::lock_guard<std::mutex> lock(sweepMutex);
+        pages.push_back(page);
     }
 
-    // Display a "card"-style box with title and content lines
-    void DisplayCard(const std::string& title, const std::vector<std::string>& lines, int cardWidth = 50) {
-        using namespace std;
-        const std::string topBot = "╭" + std::string(cardWidth - 2, '_') + "╮\n";
-        const std::string bottom = "╰" + std::string(cardWidth - 2, '_') + "╯\n";
-
-        std::cout << COLOR_GRAY << topBot << COLOR_RESET;
+    void Charge(size_t bytes) {
+        if (resident.fetch_add(bytes) + bytes > budget && budget > 0) EvictToBudget();
+    }
 
-        // Title line centered
-        std::cout << "│" << std::string((cardWidth - 2 - title.size()) / 2, ' ')
-                  << COLOR_BOLD << title << COLOR_RESET
-                  << std::string((cardWidth - 2 - title.size() + 1) / 2, ' ') << "│\n";
+    void Release(size_t bytes) { resident.fetch_sub(bytes); }
 
-        std::cout << "│" << std::string(cardWidth - 2, ' ') << "│\n";
+    void CountFault() { faults.fetch_add(1, std::memory_order_relaxed); }
 
-        // Content lines wrapped and padded
-        for (const auto& line : lines) {
-            std::cout << "│ " << line;
-            int padding = cardWidth - 3 - line.size();
-            std::cout << std::string(padding > 0 ? padding : 0, ' ') << "│\n";
-        }
+    template <typename T>
+    void Retire(const T* contents) { epochs.Retire(contents); }
 
-        std::cout << COLOR_GRAY << bottom << COLOR_RESET;
+    // Append raw page bytes to the spill file; returns false on I/O failure
+    bool Spill(const std::string& bytes, uint64_t& offset) {
+        std::lock_guard<std::mutex> lock(spillMutex);
+        if (!spill) spill = std::fopen(spillPath.c_str(), "w+b");
+        if (!spill) return false;
+        offset = spillBytes;
+        if (std::fseek(spill, static_cast<long>(offset), SEEK_SET) != 0
+            || std::fwrite(bytes.data(), 1, bytes.size(), spill) != bytes.size()) return false;
+        spillBytes += bytes.size();
+        return true;
     }
 
-    // Display list of cards in a grid style (2 per row)
-    void DisplayCardsGrid(const std::vector<std::pair<std::string, std::vector<std::string>>>& cards) {
-        int cardsPerRow = 2;
-        int cardWidth = 50;
-        size_t count = cards.size();
-        for (size_t i = 0; i < count; i += cardsPerRow) {
-            // collect line-by-line output for all cards in row to print side by side
-            // cards have 7 lines each (top+title+blank+3 content+bot)
-
-            std::vector<std::string> lines[7];
+    bool Unspill(uint64_t offset, size_t length, std::string& bytes) {
+        std::lock_guard<std::mutex> lock(spillMutex);
+        bytes.resize(length);
+        return spill && std::fseek(spill, static_cast<long>(offset), SEEK_SET) == 0
+            && std::fread(&bytes[0], 1, length, spill) == length;
+    }
 
-            for (int c = 0; c < cardsPerRow; ++c) {
-                size_t idx = i + c;
-                if (idx >= count) break;
-                const auto& card = cards[idx];
+    Stats GetStats() const {
+        Stats stats;
+        stats.budgetBytes = budget;
+        stats.residentBytes = resident.load();
+        stats.evictions = evictions.load();
+        stats.faults = faults.load();
+        {
+            std::lock_guard<std::mutex> lock(sweepMutex);
+            stats.trackedPages = pages.size();
+        }
+        std::lock_guard<std::mutex> lock(spillMutex);
+        stats.spillFileBytes = spillBytes;
+        return stats;
+    }
 
-                // Compose card lines
-                lines[0].push_back("╭" + std::string(cardWidth - 2, '_') + "╮");
-                int titlePadLeft = (cardWidth - 2 - card.first.size()) / 2;
-                int titlePadRight = cardWidth - 2 - card.first.size() - titlePadLeft;
-                std::string titleLine = "│" + std::string(titlePadLeft, ' ') + COLOR_BOLD + card.first + COLOR_RESET + std::string(titlePadRight, ' ') + "│";
-                lines[1].push_back(titleLine);
-                lines[2].push_back("│" + std::string(cardWidth - 2, ' ') + "│");
+private:
+    size_t budget;
+    std::string spillPath;
+    EpochManager& epochs;
+    std::atomic<size_t> resident{0};
+    std::atomic<uint64_t> evictions{0}, faults{0};
 
-                // Up to 3 content lines, pad shorter lines with spaces
-                int contentLines = 3;
-                for (int ln = 0; ln < contentLines; ++ln) {
-                    if (ln < (int)card.second.size()) {
-                        std::string content = card.second[ln];
-                        if ((int)content.size() > cardWidth - 3) // truncate content if too long
-                            content = content.substr(0, cardWidth - 6) + "...";
-                        int padRight = cardWidth - 3 - content.size();
-                        lines[3 + ln].push_back("│ " + content + std::string(padRight, ' ') + "│");
-                    } else {
-                        lines[3 + ln].push_back("│" + std::string(cardWidth - 2, ' ') + "│");
-                    }
-                }
+    mutable std::mutex sweepMutex; // guards pages and hand
+    std::vector<std::weak_ptr<CachedPage>> pages;
+    size_t hand = 0;
 
-                lines[6].push_back("╰" + std::string(cardWidth - 2, '_') + "╯");
-            }
+    mutable std::mutex spillMutex; // guards the spill file
+    std::FILE* spill = nullptr;
+    uint64_t spillBytes = 0;
 
-            // Print lines side by side separated by 4 spaces
-            for (int lineNum = 0; lineNum < 7; ++lineNum) {
-                for (size_t cardIdx = 0; cardIdx < lines[lineNum].size(); ++cardIdx) {
-                    std::cout << COLOR_GRAY << lines[lineNum][cardIdx] << COLOR_RESET;
-                    if (cardIdx != lines[lineNum].size() - 1)
-                        std::cout << "    "; // spacing between cards
-                }
-                std::cout << "\n";
+    // One clock rotation at most, so a page touched just now is never evicted
+    // by the sweep its own fault started
+    void EvictToBudget() {
+        std::unique_lock<std::mutex> lock(sweepMutex, std::try_to_lock);
+        if (!lock) return; // someone else is already sweeping
+        for (size_t steps = pages.size(); steps > 0 && resident.load() > budget; --steps) {
+            if (hand >= pages.size()) hand = 0;
+            std::shared_ptr<CachedPage> page = pages[hand].lock();
+            if (!page) {
+                pages[hand] = std::move(pages.back());
+                pages.pop_back();
+                continue;
             }
-            std::cout << "\n";
+            ++hand;
+            if (page->referenced.exchange(false)) continue;
+            if (page->Evict()) evictions.fetch_add(1, std::memory_order_relaxed);
         }
     }
+};
 
-    // Display hero section with big headline, subtext and prompt
-    void DisplayHero() {
-        std::cout << COLOR_BOLD;
-        std::cout << "\n======================== WELCOME TO VCLASS ========================\n\n";
-        std::cout << COLOR_RESET;
-        std::cout << COLOR_GRAY;
-        std::cout << "Create and manage your virtual classes and students with ease.\n\n";
-        std::cout << COLOR_RESET;
+// One immutable page of a PagedList. Its contents can be evicted to the
+// PageCache's spill file and are faulted back in on the next access.
+// References returned by Items() stay valid while the caller holds a Model
+// snapshot (or is the only thread touching the list).
+template <typename T>
+class ListPage : public CachedPage {
+public:
+    static std::shared_ptr<const ListPage> Make(std::vector<T> items, PageCache* cache, bool full) {
+        auto page = std::make_shared<ListPage>(std::move(items), cache);
+        if (cache && full) cache->Track(page);
+        return page;
     }
 
-    // Display footer
-    void DisplayFooter() {
-        std::cout << COLOR_GRAY << "====================================================================\n";
-        std::cout << "                   © 2024 VClass Virtual Classroom                  \n";
-        std::cout << "====================================================================" << COLOR_RESET << "\n\n";
+    ListPage(std::vector<T> items, PageCache* cache)
+        : cache(cache), contents(new std::vector<T>(std::move(items))) {
+        bytes = PageItemBytes(*contents.load());
+        if (cache) cache->Charge(bytes);
     }
 
-    // Pause prompt
-    void Pause() {
-        std::cout << "Press Enter to continue...";
-        std::cin.ignore(std::numeric_limits<std::streamsize>::max(), '\n');
+    ~ListPage() override {
+        const std::vector<T>* items = contents.load();
+        if (items && cache) cache->Release(bytes);
+        delete items;
     }
 
-private:
-    static void Trim(std::string& s) {
-        const char* ws = " \t\n\r\f\v";
-        s.erase(s.find_last_not_of(ws) + 1);
-        s.erase(0, s.find_first_not_of(ws));
+    const std::vector<T>& Items() const {
+        referenced.store(true, std::memory_order_relaxed);
+        const std::vector<T>* items = contents.load(std::memory_order_acquire);
+        return items ? *items : Fault();
     }
-};
-
-// Controller: orchestrates program flow
-class Controller {
-public:
-    Controller(): model(), view() {}
 
-    void Run() {
-        view.DisplayHero();
-        bool running = true;
-        while (running) {
-            view.DisplayHeader();
-            int choice = view.PromptMainMenuChoice();
-            switch(choice) {
-                case 1: AddClassFlow(); break;
-                case 2: AddStudentFlow(); break;
-                case 3: ViewClassesFlow(); break;
-                case 4: ViewStudentsFlow(); break;
-                case 5: running = false; break;
-            }
+    bool Evict() override {
+        std::unique_lock<std::mutex> lock(mutex, std::try_to_lock);
+        const std::vector<T>* items = lock ? contents.load() : nullptr;
+        if (!items) return false;
+        if (!spilled) {
+            std::string raw;
+            EncodePageItems(*items, raw);
+            if (!cache->Spill(raw, spillOffset)) return false;
+            spillLength = raw.size();
+            spilled = true;
         }
-        view.DisplayFooter();
+        contents.store(nullptr, std::memory_order_release);
+        cache->Release(bytes);
+        cache->Retire(items);
+        return true;
     }
 
 private:
-    Model model;
-    View view;
+    PageCache* cache;
+    mutable std::atomic<const std::vector<T>*> contents;
+    mutable std::mutex mutex; // serializes eviction against faults
+    size_t bytes = 0;
+    bool spilled = false;
+    uint64_t spillOffset = 0;
+    size_t spillLength = 0;
 
-    void AddClassFlow() {
-        std::string name = view.PromptNonEmptyString("Enter new class name: ");
-        if (model.AddClass(name)) {
-            std::cout << "\nClass \"" << name << "\" added successfully.\n\n";
-        } else {
-            std::cout << "\nClass \"" << name << "\" already exists.\n\n";
+    const std::vector<T>& Fault() const {
+        const std::vector<T>* items;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            items = contents.load();
+            if (items) return *items; // another reader faulted it first
+            std::string raw;
+            auto loaded = new std::vector<T>();
+            if (!cache->Unspill(spillOffset, spillLength, raw) || !DecodePageItems(raw, *loaded)) {
+                delete loaded;
+                throw std::runtime_error("roster spill file is unreadable");
+            }
+            contents.store(items = loaded, std::memory_order_release);
         }
-        view.Pause();
+        cache->CountFault();
+        cache->Charge(bytes);
+        return *items;
     }
+};
 
-    void AddStudentFlow() {
-        std::string name = view.PromptNonEmptyString("Enter new student name: ");
-        if (model.AddStudent(name)) {
-            std::cout << "\nStudent \"" << name << "\" added successfully.\n\n";
-        } else {
-            std::cout << "\nStudent \"" << name << "\" already exists.\n\n";
+// Append-only list split into fixed-size pages. Roster versions share every
+// page they have in common, so publishing a new version copies the page table
+// and the tail page rather than the whole list. With a PageCache attached,
+// full pages count against its memory budget and may be spilled to disk.
+template <typename T>
+class PagedList {
+public:
+    static constexpr size_t kPageSize = 256;
+
+    class const_iterator {
+    public:
+        const_iterator(const PagedList* list, size_t index) : list(list), index(index) {}
+        const T& operator*() const { return (*list)[index]; }
+        const T* operator->() const { return &(*list)[index]; }
+        const_iterator& operator++() { ++index; return *this; }
+        bool operator==(const const_iterator& other) const { return index == other.index; }
+        bool operator!=(const const_iterator& other) const { return index != other.index; }
+    private:
+        const PagedList* list;
+        size_t index;
+    };
+
+    size_t size() const { return count; }
+    bool empty() const { return count == 0; }
+    const T& operator[](size_t i) const { return pages[i / kPageSize]->Items()[i % kPageSize]; }
+    const_iterator begin() const { return const_iterator(this, 0); }
+    const_iterator end() const { return const_iterator(this, count); }
+
+    // Pages created from now on are budgeted by cache (null for none)
+    void SetCache(PageCache* pageCache) { cache = pageCache; }
+
+    void push_back(const T& value) {
+        // Pages are immutable and may be shared with older versions, so the
+        // tail is rebuilt rather than written in place
+        std::vector<T> items;
+        items.reserve(kPageSize);
+        if (count % kPageSize != 0) {
+            items = pages.back()->Items();
+            pages.pop_back();
         }
-        view.Pause();
+        items.push_back(value);
+        bool full = items.size() == kPageSize;
+        pages.push_back(ListPage<T>::Make(std::move(items), cache, full));
+        ++count;
     }
 
-    void ViewClassesFlow() {
-        auto classes = model.GetClasses();
-        if (classes.empty()) {
-            std::cout << "\nNo classes available.\n\n";
-        } else {
-            std::vector<std::pair<std::string, std::vector<std::string>>> cards;
-            for (const auto& c : classes) {
-                cards.emplace_back(c, std::vector<std::string>{"Manage and track your class activities."});
+    // Remove item i. Pages before it stay shared; its page and every later
+    // one are rebuilt with the items shifted down.
+    void erase(size_t i) {
+        size_t first = i / kPageSize;
+        std::vector<T> items;
+        items.reserve(kPageSize);
+        std::vector<std::shared_ptr<const ListPage<T>>> rebuilt;
+        for (size_t j = first * kPageSize; j < count; ++j) {
+            if (j == i) continue;
+            items.push_back((*this)[j]);
+            if (items.size() == kPageSize) {
+                rebuilt.push_back(ListPage<T>::Make(std::move(items), cache, true));
+                items.clear();
+                items.reserve(kPageSize);
             }
-            std::cout << "\n--- Classes ---\n";
-            view.DisplayCardsGrid(cards);
         }
-        view.Pause();
+        if (!items.empty()) rebuilt.push_back(ListPage<T>::Make(std::move(items), cache, false));
+        pages.resize(first);
+        pages.insert(pages.end(), rebuilt.begin(), rebuilt.end());
+        --count;
     }
 
-    void ViewStudentsFlow() {
-        auto students = model.GetStudents();
-        if (students.empty()) {
-            std::cout << "\nNo students enrolled.\n\n";
-        } else {
-            std::vector<std::pair<std::string, std::vector<std::string>>> cards;
-            for (const auto& s : students) {
-                cards.emplace_back(s, std::vector<std::string>{"Active participant in your classes."});
-            }
-            std::cout << "\n--- Students ---\n";
-            view.DisplayCardsGrid(cards);
+    // Remove item i by moving the last item into its place. Only i's page and
+    // the tail page are rebuilt, so this is O(kPageSize) however long the
+    // list is, but the order of the remaining items changes.
+    void swap_erase(size_t i) {
+        size_t last = count - 1;
+        if (i != last) {
+            std::vector<T> items = pages[i / kPageSize]->Items();
+            items[i % kPageSize] = (*this)[last];
+            bool full = items.size() == kPageSize;
+            pages[i / kPageSize] = ListPage<T>::Make(std::move(items), cache, full);
         }
-        view.Pause();
+        std::vector<T> tail = pages.back()->Items();
+        tail.pop_back();
+        pages.pop_back();
+        if (!tail.empty()) pages.push_back(ListPage<T>::Make(std::move(tail), cache, false));
+        --count;
     }
+
+private:
+    std::vector<std::shared_ptr<const ListPage<T>>> pages;
+    size_t count = 0;
+    PageCache* cache = nullptr;
 };
 
-int main() {
-    Controller app;
-    app.Run();
-    return 0;
+// A student enrolled in a class, by position in the roster lists
+struct Enrollment {
+    uint32_t classId;
+    uint32_t studentId;
+};
+
+inline size_t PageItemBytes(const std::vector<Enrollment>& items) {
+    return items.capacity() * sizeof(Enrollment);
 }
+
+inline void EncodePageItems(const std::vector<Enrollment>& items, std::string& out) {
+    out.append(reinterpret_cast<const char*>(items.data()), items.size() * sizeof(Enrollment));
+}
+
+inline bool DecodePageItems(const std::string& in, std::vector<Enrollment>& items) {
+    if (in.size() % sizeof(Enrollment) != 0) return false;
+    items.resize(in.size() / sizeof(Enrollment));
+    if (!items.empty()) std::memcpy(items.data(), in.data(), in.size());
+    return true;
+}
+
+// One immutable version of the roster. Writers build a new version and swap it
+// in; readers keep using whichever version they pinned.
+struct RosterVersion {
+    uint64_t version = 0;
+    PagedList<std::string> classes;
+    PagedList<std::string> students;
+    PagedList<Enrollment> enrollments;
+};
+
+// A single roster change, queued for the persistence thread
+struct Mutation {
+    enum class Kind { AddClass, AddStudent, Enroll, Barrier, SetAttributes, AddAssessment, SetGrades,
+                      AddSession, SetAttendance, SetSchedule, SetRoom, SetAvailability, Drop, SetCapacity,
+                      JoinWaitlist, LeaveWaitlist, AddPrerequisite, RemovePrerequisite, Complete, AddUnit,
+                      PlaceClass };
+
+    Kind kind;
+    uint64_t ticket;    // position in the persistence queue
+    std::string first;  // class or student name
+    std::string second; // student name for Enroll, Drop and the waitlists, class name
+                        // for the prerequisite records and Complete (first is the
+                        // student there), the parent unit for AddUnit and the unit
+                        // for PlaceClass (empty for the root), encoded
+                        // attributes for SetAttributes, a count for SetCapacity,
+                        // tab-separated fields for AddAssessment, SetGrades, AddSession,
+                        // SetAttendance and SetSchedule, seats for SetRoom, meetings
+                        // for SetAvailability
+};
+
+// Roster collections touched by a batch of changes. Only dirty collections are
+// written back, so adding a class never rewrites the student file.
+enum DirtyFlags : unsigned {
+    kDirtyNone = 0,
+    kDirtyClasses = 1u << 0,
+    kDirtyStudents = 1u << 1,
+    kDirtyEnrollments = 1u << 2,
+    kDirtyAttributes = 1u << 3,
+    kDirtyGrades = 1u << 4,
+    kDirtyAttendance = 1u << 5,
+    kDirtySchedules = 1u << 6,
+    kDirtySeats = 1u << 7,
+    kDirtyPrerequisites = 1u << 8,
+    kDirtyOrganization = 1u << 9,
+    kDirtyAll = kDirtyClasses | kDirtyStudents | kDirtyEnrollments | kDirtyAttributes | kDirtyGrades
+              | kDirtyAttendance | kDirtySchedules | kDirtySeats | kDirtyPrerequisites | kDirtyOrganization
+};
+
+inline unsigned DirtyFlagsFor(Mutation::Kind kind) {
+    switch (kind) {
+        case Mutation::Kind::AddClass: return kDirtyClasses;
+        case Mutation::Kind::AddStudent: return kDirtyStudents;
+        case Mutation::Kind::Enroll: return kDirtyEnrollments;
+        case Mutation::Kind::SetAttributes: return kDirtyAttributes;
+        case Mutation::Kind::AddAssessment:
+        case Mutation::Kind::SetGrades: return kDirtyGrades;
+        case Mutation::Kind::AddSession:
+        case Mutation::Kind::SetAttendance: return kDirtyAttendance;
+        case Mutation::Kind::SetSchedule:
+        case Mutation::Kind::SetRoom:
+        case Mutation::Kind::SetAvailability: return kDirtySchedules;
+        // A dropped student's grade and attendance rows leave with them
+        case Mutation::Kind::Drop: return kDirtyEnrollments | kDirtyGrades | kDirtyAttendance;
+        case Mutation::Kind::SetCapacity:
+        case Mutation::Kind::JoinWaitlist:
+        case Mutation::Kind::LeaveWaitlist: return kDirtySeats;
+        case Mutation::Kind::AddPrerequisite:
+        case Mutation::Kind::RemovePrerequisite:
+        case Mutation::Kind::Complete: return kDirtyPrerequisites;
+        case Mutation::Kind::AddUnit:
+        case Mutation::Kind::PlaceClass: return kDirtyOrganization;
+        case Mutation::Kind::Barrier: break;
+    }
+    return kDirtyNone;
+}
+
+// Lock-free multi-producer single-consumer queue. Producers link new nodes
+// with a single exchange on head; the one consumer follows next pointers
+// from tail, turning each popped node into the new stub.
+template <typename T>
+class MpscQueue {
+public:
+    MpscQueue() : head(new Node()), tail(head.load()) {}
+
+    ~MpscQueue() {
+        while (tail) {
+            Node* next = tail->next.load();
+            delete tail;
+            tail = next;
+        }
+    }
+
+    MpscQueue(const MpscQueue&) = delete;
+    MpscQueue& operator=(const MpscQueue&) = delete;
+
+    void Push(T value) {
+        Node* node = new Node();
+        node->value = std::move(value);
+        Node* previous = head.exchange(node, std::memory_order_acq_rel);
+        previous->next.store(node, std::memory_order_release);
+    }
+
+    // Consumer only. Returns false when empty or when a push is half-linked;
+    // the half-linked node shows up on a later call.
+    bool TryPop(T& out) {
+        Node* next = tail->next.load(std::memory_order_acquire);
+        if (!next) return false;
+        out = std::move(next->value);
+        delete tail;
+        tail = next;
+        return true;
+    }
+
+private:
+    struct Node {
+        T value;
+        std::atomic<Node*> next{nullptr};
+    };
+
+    std::atomic<Node*> head;
+    Node* tail; // consumer-owned
+};
+
+// Bloom filter over strings, probing k bits by double hashing a 64-bit FNV-1a
+// hash. No false negatives; about 1% false positives at 10 bits per key.
+class BloomFilter {
+public:
+    BloomFilter() = default;
+
+    explicit BloomFilter(size_t expectedKeys, size_t bitsPerKey = 10) {
+        size_t bitCount = std::max<size_t>(64, expectedKeys * bitsPerKey);
+        words.assign((bitCount + 63) / 64, 0);
+        hashCount = std::max<size_t>(1, std::min<size_t>(12, bitsPerKey * 69 / 100));
+    }
+
+    void Add(const std::string& key) {
+        uint64_t h = Hash(key), delta = (h >> 17) | (h << 47);
+        const uint64_t bitCount = words.size() * 64;
+        for (size_t i = 0; i < hashCount; ++i, h += delta) {
+            uint64_t bit = h % bitCount;
+            words[bit / 64] |= uint64_t(1) << (bit % 64);
+        }
+    }
+
+    bool MayContain(const std::string& key) const {
+        if (words.empty()) return true;
+        uint64_t h = Hash(key), delta = (h >> 17) | (h << 47);
+        const uint64_t bitCount = words.size() * 64;
+        for (size_t i = 0; i < hashCount; ++i, h += delta) {
+            uint64_t bit = h % bitCount;
+            if (!(words[bit / 64] & (uint64_t(1) << (bit % 64)))) return false;
+        }
+        return true;
+    }
+
+    size_t BitCount() const { return words.size() * 64; }
+    size_t HashCount() const { return hashCount; }
+
+    // Expected false-positive rate once keys entries have been added
+    double EstimatedFalsePositiveRate(size_t keys) const {
+        if (words.empty()) return 1.0;
+        double k = static_cast<double>(hashCount);
+        return std::pow(1.0 - std::exp(-k * keys / BitCount()), k);
+    }
+
+    // Raw form for persisting: hash count, word count, then the words
+    std::string Encode() const {
+        std::string out(16 + words.size() * 8, '\0');
+        uint64_t header[2] = {hashCount, words.size()};
+        std::memcpy(&out[0], header, 16);
+        if (!words.empty()) std::memcpy(&out[16], words.data(), words.size() * 8);
+        return out;
+    }
+
+    bool Decode(const std::string& in) {
+        uint64_t header[2];
+        if (in.size() < 16) return false;
+        std::memcpy(header, in.data(), 16);
+        if (header[0] == 0 || in.size() != 16 + header[1] * 8) return false;
+        hashCount = static_cast<size_t>(header[0]);
+        words.assign(header[1], 0);
+        if (!words.empty()) std::memcpy(words.data(), in.data() + 16, words.size() * 8);
+        return true;
+    }
+
+    static uint64_t Hash(const std::string& key) {
+        uint64_t h = 14695981039346656037ull;
+        for (unsigned char c : key) {
+            h ^= c;
+            h *= 1099511628211ull;
+        }
+        return h;
+    }
+
+private:
+    std::vector<uint64_t> words;
+    size_t hashCount = 0;
+};
+
+// Ordered map from a roster name to its position in the roster, backing the
+// Model's duplicate checks and ordered listings. Implementations allow any
+// number of concurrent readers alongside the Model's single writer.
+class NameIndex {
+public:
+    using Visitor = std::function<bool(const std::string& name, uint32_t id)>;
+
+    virtual ~NameIndex() = default;
+
+    virtual bool Find(const std::string& name, uint32_t& id) const = 0;
+    // False (and nothing inserted) if the index cannot hold name
+    virtual bool Insert(const std::string& name, uint32_t id) = 0;
+    // Visit names >= from in ascending order until visit returns false
+    virtual void Scan(const std::string& from, const Visitor& visit) const = 0;
+    virtual size_t Size() const = 0;
+    virtual void Clear() = 0;
+};
+
+// Default index: a std::map behind a reader-writer lock
+class MemoryNameIndex : public NameIndex {
+public:
+    bool Find(const std::string& name, uint32_t& id) const override {
+        std::shared_lock<std::shared_mutex> lock(mutex);
+        auto it = names.find(name);
+        if (it == names.end()) return false;
+        id = it->second;
+        return true;
+    }
+
+    bool Insert(const std::string& name, uint32_t id) override {
+        std::unique_lock<std::shared_mutex> lock(mutex);
+        names.emplace(name, id);
+        return true;
+    }
+
+    // Holds the read lock while visiting, so visit must not call back in
+    void Scan(const std::string& from, const Visitor& visit) const override {
+        std::shared_lock<std::shared_mutex> lock(mutex);
+        for (auto it = names.lower_bound(from); it != names.end(); ++it) {
+            if (!visit(it->first, it->second)) break;
+        }
+    }
+
+    size_t Size() const override {
+        std::shared_lock<std::shared_mutex> lock(mutex);
+        return names.size();
+    }
+
+    void Clear() override {
+        std::unique_lock<std::shared_mutex> lock(mutex);
+        names.clear();
+    }
+
+private:
+    mutable std::shared_mutex mutex;
+    std::map<std::string, uint32_t> names;
+};
+
+// One sorted, immutable LSM run file of [u32 length][name][u32 id] records in
+// name order. Only a Bloom filter and every kSparseEvery-th key stay in memory;
+// lookups read a single block of records from disk.
+class LsmRun {
+public:
+    static constexpr size_t kSparseEvery = 64;
+
+    using Source = std::function<bool(std::string& name, uint32_t& id)>;
+
+    // Write the sorted entries produced by next into a new run file
+    static std::shared_ptr<LsmRun> Build(const std::string& path, int level, size_t expectedKeys, const Source& next) {
+        std::shared_ptr<LsmRun> run(new LsmRun(path, level, expectedKeys));
+        std::FILE* out = std::fopen(path.c_str(), "wb");
+        if (!out) return nullptr;
+        std::string name;
+        uint32_t id = 0;
+        uint64_t offset = 0;
+        bool ok = true;
+        while (ok && next(name, id)) {
+            if (run->count % kSparseEvery == 0) run->sparse.emplace_back(name, offset);
+            run->bloom.Add(name);
+            ok = WriteRecord(out, name, id);
+            offset += 8 + name.size();
+            ++run->count;
+        }
+        ok = SyncFile(out) && ok;
+        ok = std::fclose(out) == 0 && ok;
+        if (!ok) {
+            std::remove(path.c_str());
+            return nullptr;
+        }
+        run->file = std::fopen(path.c_str(), "rb");
+        return run->file ? run : nullptr;
+    }
+
+    // Reopen an existing run, rebuilding its Bloom filter and sparse index
+    static std::shared_ptr<LsmRun> Open(const std::string& path, int level, size_t count) {
+        std::shared_ptr<LsmRun> run(new LsmRun(path, level, count));
+        run->file = std::fopen(path.c_str(), "rb");
+        if (!run->file) return nullptr;
+        std::string name;
+        uint32_t id = 0;
+        uint64_t offset = 0;
+        while (ReadRecord(run->file, name, id)) {
+            if (run->count % kSparseEvery == 0) run->sparse.emplace_back(name, offset);
+            run->bloom.Add(name);
+            offset += 8 + name.size();
+            ++run->count;
+        }
+        return run->count == count ? run : nullptr;
+    }
+
+    ~LsmRun() {
+        if (file) std::fclose(file);
+        if (obsolete) std::remove(path.c_str());
+    }
+
+    bool Find(const std::string& name, uint32_t& id) const {
+        if (sparse.empty() || name < sparse.front().first || !bloom.MayContain(name)) return false;
+        std::lock_guard<std::mutex> lock(fileMutex);
+        std::fseek(file, static_cast<long>(BlockFor(name)), SEEK_SET);
+        std::string key;
+        uint32_t value = 0;
+        for (size_t i = 0; i < kSparseEvery && ReadRecord(file, key, value); ++i) {
+            if (key == name) {
+                id = value;
+                return true;
+            }
+            if (key > name) break;
+        }
+        return false;
+    }
+
+    // Sequential reader over the run starting at the first name >= from
+    class Cursor {
+    public:
+        Cursor(const LsmRun& run, const std::string& from) : in(std::fopen(run.path.c_str(), "rb")) {
+            if (!in) return;
+            std::fseek(in, static_cast<long>(run.BlockFor(from)), SEEK_SET);
+            do Next(); while (valid && name < from);
+        }
+        ~Cursor() { if (in) std::fclose(in); }
+        Cursor(const Cursor&) = delete;
+        Cursor& operator=(const Cursor&) = delete;
+
+        bool Valid() const { return valid; }
+        const std::string& Name() const { return name; }
+        uint32_t Id() const { return id; }
+        void Next() { valid = in && ReadRecord(in, name, id); }
+
+    private:
+        std::FILE* in;
+        bool valid = false;
+        std::string name;
+        uint32_t id = 0;
+    };
+
+    int Level() const { return level; }
+    size_t Count() const { return count; }
+    const std::string& Path() const { return path; }
+    void MarkObsolete() { obsolete = true; }
+
+private:
+    LsmRun(const std::string& path, int level, size_t expectedKeys)
+        : path(path), level(level), bloom(expectedKeys) {}
+
+    // Offset of the block that would hold name
+    uint64_t BlockFor(const std::string& name) const {
+        auto it = std::upper_bound(sparse.begin(), sparse.end(), name,
+            [](const std::string& key, const std::pair<std::string, uint64_t>& entry) { return key < entry.first; });
+        return it == sparse.begin() ? 0 : std::prev(it)->second;
+    }
+
+    static bool WriteRecord(std::FILE* out, const std::string& name, uint32_t id) {
+        uint32_t length = static_cast<uint32_t>(name.size());
+        return std::fwrite(&length, sizeof(length), 1, out) == 1
+            && std::fwrite(name.data(), 1, name.size(), out) == name.size()
+            && std::fwrite(&id, sizeof(id), 1, out) == 1;
+    }
+
+    static bool ReadRecord(std::FILE* in, std::string& name, uint32_t& id) {
+        uint32_t length = 0;
+        if (std::fread(&length, sizeof(length), 1, in) != 1 || length > (1u << 20)) return false;
+        name.resize(length);
+        return std::fread(&name[0], 1, length, in) == length && std::fread(&id, sizeof(id), 1, in) == 1;
+    }
+
+    std::string path;
+    int level;
+    size_t count = 0;
+    BloomFilter bloom;
+    std::vector<std::pair<std::string, uint64_t>> sparse; // first name of each block and its offset
+    mutable std::mutex fileMutex;
+    std::FILE* file = nullptr;
+    std::atomic<bool> obsolete{false};
+};
+
+// Out-of-core name index built as a log-structured merge tree. Inserts go to
+// a write-ahead log and an in-memory memtable; a full memtable is written out
+// as a level-0 run. A background thread compacts level 0 into level 1 and
+// each deeper level into the next once it outgrows kLevelRatio times the one
+// above, keeping a single sorted run per level from 1 down. Memory use is the
+// memtable plus a Bloom filter and sparse index per run.
+class LsmNameIndex : public NameIndex {
+public:
+    static constexpr size_t kLevel0Trigger = 4;
+    static constexpr size_t kLevelRatio = 10;
+
+    explicit LsmNameIndex(const std::string& dir, size_t memtableLimit = 4096)
+        : dir(dir), memtableLimit(memtableLimit) {
+        std::filesystem::create_directories(dir);
+        LoadManifest();
+        ReplayLog();
+        log = std::fopen(LogPath().c_str(), "ab");
+        compactor = std::thread(&LsmNameIndex::CompactLoop, this);
+    }
+
+    ~LsmNameIndex() override {
+        {
+            std::lock_guard<std::mutex> lock(compactMutex);
+            stopping = true;
+        }
+        compactWake.notify_one();
+        compactor.join();
+        if (log) std::fclose(log);
+    }
+
+    bool Find(const std::string& name, uint32_t& id) const override {
+        std::vector<std::shared_ptr<LsmRun>> runs;
+        {
+            std::shared_lock<std::shared_mutex> lock(stateMutex);
+            if (FindIn(memtable, name, id) || (flushing && FindIn(*flushing, name, id))) return true;
+            runs = AllRuns();
+        }
+        for (const auto& run : runs) {
+            if (run->Find(name, id)) return true;
+        }
+        return false;
+    }
+
+    // Called only by the Model's writer
+    bool Insert(const std::string& name, uint32_t id) override {
+        if (log) {
+            std::fprintf(log, "%u\t%s\n", id, name.c_str());
+            std::fflush(log);
+        }
+        size_t buffered;
+        {
+            std::unique_lock<std::shared_mutex> lock(stateMutex);
+            memtable.emplace(name, id);
+            buffered = memtable.size();
+        }
+        ++count;
+        if (buffered >= memtableLimit) FlushMemtable();
+        return true;
+    }
+
+    void Scan(const std::string& from, const Visitor& visit) const override {
+        // Buffered entries are copied (the memtable is small); runs are streamed
+        std::vector<std::pair<std::string, uint32_t>> buffered;
+        std::vector<std::shared_ptr<LsmRun>> runs;
+        {
+            std::shared_lock<std::shared_mutex> lock(stateMutex);
+            buffered.assign(memtable.lower_bound(from), memtable.end());
+            if (flushing) buffered.insert(buffered.end(), flushing->lower_bound(from), flushing->end());
+            runs = AllRuns();
+        }
+        std::sort(buffered.begin(), buffered.end());
+
+        std::vector<std::unique_ptr<LsmRun::Cursor>> cursors;
+        for (const auto& run : runs) cursors.emplace_back(new LsmRun::Cursor(*run, from));
+        size_t next = 0;
+        std::string last;
+        bool any = false;
+        for (;;) {
+            // Smallest head among the buffer and every run cursor
+            const std::string* best = next < buffered.size() ? &buffered[next].first : nullptr;
+            uint32_t bestId = best ? buffered[next].second : 0;
+            LsmRun::Cursor* bestCursor = nullptr;
+            for (auto& c : cursors) {
+                if (c->Valid() && (!best || c->Name() < *best)) {
+                    best = &c->Name();
+                    bestId = c->Id();
+                    bestCursor = c.get();
+                }
+            }
+            if (!best) return;
+            std::string name = *best;
+            if (bestCursor) bestCursor->Next(); else ++next;
+            if (any && name == last) continue;
+            if (!visit(name, bestId)) return;
+            last = std::move(name);
+            any = true;
+        }
+    }
+
+    size_t Size() const override { return count.load(); }
+
+    void Clear() override {
+        std::vector<std::shared_ptr<LsmRun>> dropped;
+        {
+            std::unique_lock<std::shared_mutex> lock(stateMutex);
+            dropped = AllRuns();
+            memtable.clear();
+            level0.clear();
+            deeper.clear();
+            ++generation;
+        }
+        count = 0;
+        if (log) std::fclose(log);
+        log = std::fopen(LogPath().c_str(), "wb");
+        WriteManifest();
+        for (auto& run : dropped) run->MarkObsolete();
+    }
+
+private:
+    using Memtable = std::map<std::string, uint32_t>;
+
+    std::string dir;
+    size_t memtableLimit;
+    std::FILE* log = nullptr;
+    std::atomic<size_t> count{0};
+
+    mutable std::shared_mutex stateMutex;       // guards the tree shape below
+    Memtable memtable;
+    std::shared_ptr<const Memtable> flushing;   // memtable being written out
+    std::vector<std::shared_ptr<LsmRun>> level0; // oldest first, may overlap
+    std::vector<std::shared_ptr<LsmRun>> deeper; // deeper[i] is level i + 1, may be null
+    uint64_t nextFileNumber = 1;
+    uint64_t generation = 0;                    // bumped by Clear to void in-flight compactions
+
+    std::mutex manifestMutex;
+    std::mutex compactMutex;
+    std::condition_variable compactWake;
+    bool stopping = false;
+    std::thread compactor;
+
+    std::string LogPath() const { return dir + "/wal.log"; }
+    std::string ManifestPath() const { return dir + "/MANIFEST"; }
+
+    static bool FindIn(const Memtable& table, const std::string& name, uint32_t& id) {
+        auto it = table.find(name);
+        if (it == table.end()) return false;
+        id = it->second;
+        return true;
+    }
+
+    // Newest runs first. Caller holds stateMutex.
+    std::vector<std::shared_ptr<LsmRun>> AllRuns() const {
+        std::vector<std::shared_ptr<LsmRun>> runs(level0.rbegin(), level0.rend());
+        for (const auto& run : deeper) {
+            if (run) runs.push_back(run);
+        }
+        return runs;
+    }
+
+    std::string NewRunPath() {
+        std::unique_lock<std::shared_mutex> lock(stateMutex);
+        return dir + "/run-" + std::to_string(nextFileNumber++) + ".lsm";
+    }
+
+    void FlushMemtable() {
+        std::shared_ptr<const Memtable> frozen;
+        {
+            std::unique_lock<std::shared_mutex> lock(stateMutex);
+            flushing = std::make_shared<const Memtable>(std::move(memtable));
+            memtable.clear();
+            frozen = flushing;
+        }
+        auto it = frozen->begin();
+        auto run = LsmRun::Build(NewRunPath(), 0, frozen->size(), [&](std::string& name, uint32_t& id) {
+            if (it == frozen->end()) return false;
+            name = it->first;
+            id = it->second;
+            ++it;
+            return true;
+        });
+        if (!run) {
+            // Keep serving from the frozen table; it stays in the log for the next start
+            std::cerr << "Warning: could not write LSM run in " << dir << ".\n";
+            std::unique_lock<std::shared_mutex> lock(stateMutex);
+            memtable.insert(frozen->begin(), frozen->end());
+            flushing.reset();
+            return;
+        }
+        {
+            std::unique_lock<std::shared_mutex> lock(stateMutex);
+            level0.push_back(run);
+            flushing.reset();
+        }
+        WriteManifest();
+        // Everything logged so far is now in a run
+        if (log) std::fclose(log);
+        log = std::fopen(LogPath().c_str(), "wb");
+        {
+            std::lock_guard<std::mutex> lock(compactMutex);
+        }
+        compactWake.notify_one();
+    }
+
+    void WriteManifest() {
+        std::lock_guard<std::mutex> guard(manifestMutex);
+        std::ostringstream body;
+        {
+            std::shared_lock<std::shared_mutex> lock(stateMutex);
+            body << "next " << nextFileNumber << '\n';
+            for (const auto& run : AllRuns()) {
+                body << "run " << run->Level() << ' ' << std::filesystem::path(run->Path()).filename().string()
+                     << ' ' << run->Count() << '\n';
+            }
+        }
+        if (!WriteSnapshotFile(ManifestPath(), body.str())) {
+            std::cerr << "Warning: could not save " << ManifestPath() << ".\n";
+        }
+    }
+
+    void LoadManifest() {
+        std::string body;
+        if (!RecoverSnapshotFile(ManifestPath(), body)) return;
+        std::istringstream in(body);
+        std::string kind;
+        while (in >> kind) {
+            if (kind == "next") {
+                in >> nextFileNumber;
+            } else if (kind == "run") {
+                int level = 0;
+                std::string file;
+                size_t keys = 0;
+                in >> level >> file >> keys;
+                auto run = LsmRun::Open(dir + "/" + file, level, keys);
+                if (!run) {
+                    std::cerr << "Warning: LSM run " << file << " is missing or damaged; index will be rebuilt.\n";
+                    continue;
+                }
+                count += run->Count();
+                if (level == 0) {
+                    level0.insert(level0.begin(), run); // manifest lists newest first
+                } else {
+                    if (deeper.size() < static_cast<size_t>(level)) deeper.resize(level);
+                    deeper[level - 1] = run;
+                }
+            }
+        }
+    }
+
+    // Re-apply inserts that never made it into a run
+    void ReplayLog() {
+        std::ifstream in(LogPath());
+        std::string line;
+        while (std::getline(in, line)) {
+            size_t tab = line.find('\t');
+            if (tab == std::string::npos) continue;
+            uint32_t id = static_cast<uint32_t>(std::strtoul(line.c_str(), nullptr, 10));
+            std::string name = line.substr(tab + 1);
+            uint32_t ignored = 0;
+            if (Find(name, ignored)) continue;
+            memtable.emplace(name, id);
+            ++count;
+        }
+    }
+
+    size_t LevelCapacity(size_t level) const {
+        size_t capacity = memtableLimit * kLevel0Trigger;
+        for (size_t i = 1; i < level; ++i) capacity *= kLevelRatio;
+        return capacity * kLevelRatio;
+    }
+
+    void CompactLoop() {
+        for (;;) {
+            {
+                std::unique_lock<std::mutex> lock(compactMutex);
+                compactWake.wait(lock, [&] { return stopping || NeedsCompaction(); });
+                if (stopping) return;
+            }
+            if (!CompactOnce()) {
+                std::unique_lock<std::mutex> lock(compactMutex);
+                compactWake.wait_for(lock, std::chrono::seconds(5), [&] { return stopping; });
+            }
+        }
+    }
+
+    bool NeedsCompaction() const {
+        std::shared_lock<std::shared_mutex> lock(stateMutex);
+        if (level0.size() >= kLevel0Trigger) return true;
+        for (size_t i = 0; i < deeper.size(); ++i) {
+            if (deeper[i] && deeper[i]->Count() > LevelCapacity(i + 1)) return true;
+        }
+        return false;
+    }
+
+    // Merge one level into the next; returns false if nothing could be done
+    bool CompactOnce() {
+        std::vector<std::shared_ptr<LsmRun>> inputs;
+        size_t target = 0;
+        uint64_t startGeneration;
+        {
+            std::shared_lock<std::shared_mutex> lock(stateMutex);
+            startGeneration = generation;
+            if (level0.size() >= kLevel0Trigger) {
+                inputs = level0;
+                target = 1;
+            } else {
+                for (size_t i = 0; i < deeper.size() && !target; ++i) {
+                    if (deeper[i] && deeper[i]->Count() > LevelCapacity(i + 1)) {
+                        inputs.push_back(deeper[i]);
+                        target = i + 2;
+                    }
+                }
+            }
+            if (!target) return false;
+            if (deeper.size() >= target && deeper[target - 1]) inputs.push_back(deeper[target - 1]);
+        }
+
+        size_t keys = 0;
+        std::vector<std::unique_ptr<LsmRun::Cursor>> cursors;
+        for (const auto& run : inputs) {
+            keys += run->Count();
+            cursors.emplace_back(new LsmRun::Cursor(*run, ""));
+        }
+        auto merged = LsmRun::Build(NewRunPath(), static_cast<int>(target), keys, [&](std::string& name, uint32_t& id) {
+            LsmRun::Cursor* best = nullptr;
+            for (auto& c : cursors) {
+                if (c->Valid() && (!best || c->Name() < best->Name())) best = c.get();
+            }
+            if (!best) return false;
+            name = best->Name();
+            id = best->Id();
+            for (auto& c : cursors) {
+                if (c->Valid() && c->Name() == name) c->Next();
+            }
+            return true;
+        });
+        if (!merged) return false;
+
+        {
+            std::unique_lock<std::shared_mutex> lock(stateMutex);
+            if (generation != startGeneration) {
+                merged->MarkObsolete();
+                return true;
+            }
+            auto isInput = [&](const std::shared_ptr<LsmRun>& run) {
+                return std::find(inputs.begin(), inputs.end(), run) != inputs.end();
+            };
+            level0.erase(std::remove_if(level0.begin(), level0.end(), isInput), level0.end());
+            for (auto& run : deeper) {
+                if (run && isInput(run)) run.reset();
+            }
+            if (deeper.size() < target) deeper.resize(target);
+            deeper[target - 1] = merged;
+        }
+        WriteManifest();
+        for (auto& run : inputs) run->MarkObsolete();
+        return true;
+    }
+};
+
+// Decoded B+tree page. Leaves hold (name, id) pairs and link to their right
+// sibling; internal nodes hold separator names and one more child page than
+// separators.
+struct BTreeNode {
+    bool leaf = true;
+    uint32_t next = 0;            // right sibling leaf, 0 for none
+    std::vector<std::string> keys;
+    std::vector<uint32_t> values; // ids in a leaf, child pages in an internal node
+
+    size_t EncodedSize() const {
+        size_t size = 1 + 4 + 4 + (leaf ? 0 : 4);
+        for (const auto& k : keys) size += 2 + k.size() + 4;
+        return size;
+    }
+};
+
+// Fixed-size page cache in front of a page file, with clock eviction. Fetched
+// pages stay pinned (never evicted) until their PageRef goes away; dirty pages
+// are written back on eviction or FlushAll.
+class BufferPool {
+public:
+    static constexpr size_t kPageSize = 4096;
+
+    class PageRef {
+    public:
+        PageRef(BufferPool* pool, size_t frame) : pool(pool), frame(frame) {}
+        PageRef(PageRef&& other) noexcept : pool(other.pool), frame(other.frame) { other.pool = nullptr; }
+        PageRef(const PageRef&) = delete;
+        PageRef& operator=(const PageRef&) = delete;
+        PageRef& operator=(PageRef&& other) noexcept {
+            if (this != &other) {
+                if (pool) pool->Unpin(frame);
+                pool = other.pool;
+                frame = other.frame;
+                other.pool = nullptr;
+            }
+            return *this;
+        }
+        ~PageRef() { if (pool) pool->Unpin(frame); }
+
+        BTreeNode& operator*() const { return pool->frames[frame].node; }
+        BTreeNode* operator->() const { return &pool->frames[frame].node; }
+        uint32_t PageId() const { return pool->frames[frame].pageId; }
+        void MarkDirty() const { pool->frames[frame].dirty = true; }
+
+    private:
+        BufferPool* pool;
+        size_t frame;
+    };
+
+    BufferPool(std::FILE* file, size_t frameCount) : file(file), frames(frameCount) {}
+
+    PageRef Fetch(uint32_t pageId) {
+        std::lock_guard<std::mutex> lock(mutex);
+        auto it = table.find(pageId);
+        if (it != table.end()) {
+            ++frames[it->second].pins;
+            frames[it->second].referenced = true;
+            return PageRef(this, it->second);
+        }
+        ++misses;
+        size_t frame = Victim();
+        ReadPage(pageId, frames[frame].node);
+        Install(frame, pageId);
+        return PageRef(this, frame);
+    }
+
+    // A fresh, empty page appended to the file
+    PageRef Allocate(uint32_t pageId, bool leaf) {
+        std::lock_guard<std::mutex> lock(mutex);
+        size_t frame = Victim();
+        frames[frame].node = BTreeNode();
+        frames[frame].node.leaf = leaf;
+        Install(frame, pageId);
+        frames[frame].dirty = true;
+        return PageRef(this, frame);
+    }
+
+    bool FlushAll() {
+        std::lock_guard<std::mutex> lock(mutex);
+        bool ok = true;
+        for (auto& f : frames) {
+            if (f.used && f.dirty) {
+                ok = WritePage(f.pageId, f.node) && ok;
+                f.dirty = false;
+            }
+        }
+        return ok;
+    }
+
+    // Forget every cached page without writing it back
+    void Discard() {
+        std::lock_guard<std::mutex> lock(mutex);
+        for (auto& f : frames) f = Frame();
+        table.clear();
+    }
+
+    size_t Misses() const { return misses.load(); }
+
+private:
+    struct Frame {
+        BTreeNode node;
+        uint32_t pageId = 0;
+        int pins = 0;
+        bool used = false;
+        bool dirty = false;
+        bool referenced = false;
+    };
+
+    std::FILE* file;
+    std::vector<Frame> frames;
+    std::unordered_map<uint32_t, size_t> table;
+    size_t hand = 0;
+    std::atomic<size_t> misses{0};
+    std::mutex mutex; // guards frames, table and file position
+
+    void Install(size_t frame, uint32_t pageId) {
+        Frame& f = frames[frame];
+        f.pageId = pageId;
+        f.pins = 1;
+        f.used = true;
+        f.dirty = false;
+        f.referenced = true;
+        table[pageId] = frame;
+    }
+
+    void Unpin(size_t frame) {
+        std::lock_guard<std::mutex> lock(mutex);
+        --frames[frame].pins;
+    }
+
+    // Clock sweep: skip pinned frames, give referenced ones a second chance
+    size_t Victim() {
+        for (size_t step = 0; step < 3 * frames.size(); ++step) {
+            size_t frame = hand;
+            hand = (hand + 1) % frames.size();
+            Frame& f = frames[frame];
+            if (!f.used) return frame;
+            if (f.pins > 0) continue;
+            if (f.referenced) {
+                f.referenced = false;
+                continue;
+            }
+            if (f.dirty) WritePage(f.pageId, f.node);
+            table.erase(f.pageId);
+            f = Frame();
+            return frame;
+        }
+        throw std::runtime_error("buffer pool exhausted: every frame is pinned");
+    }
+
+    bool WritePage(uint32_t pageId, const BTreeNode& node) {
+        std::vector<unsigned char> page(kPageSize, 0);
+        unsigned char* p = page.data();
+        auto put32 = [&](uint32_t v) { std::memcpy(p, &v, 4); p += 4; };
+        *p++ = node.leaf ? 1 : 0;
+        put32(static_cast<uint32_t>(node.keys.size()));
+        put32(node.next);
+        if (!node.leaf) put32(node.values[0]);
+        for (size_t i = 0; i < node.keys.size(); ++i) {
+            uint16_t length = static_cast<uint16_t>(node.keys[i].size());
+            std::memcpy(p, &length, 2);
+            p += 2;
+            std::memcpy(p, node.keys[i].data(), length);
+            p += length;
+            put32(node.values[node.leaf ? i : i + 1]);
+        }
+        return std::fseek(file, static_cast<long>(pageId) * kPageSize, SEEK_SET) == 0
+            && std::fwrite(page.data(), 1, kPageSize, file) == kPageSize;
+    }
+
+    void ReadPage(uint32_t pageId, BTreeNode& node) {
+        std::vector<unsigned char> page(kPageSize, 0);
+        std::fseek(file, static_cast<long>(pageId) * kPageSize, SEEK_SET);
+        if (std::fread(page.data(), 1, kPageSize, file) != kPageSize) {
+            throw std::runtime_error("short read from B+tree page " + std::to_string(pageId));
+        }
+        const unsigned char* p = page.data();
+        auto get32 = [&]() { uint32_t v; std::memcpy(&v, p, 4); p += 4; return v; };
+        node = BTreeNode();
+        node.leaf = *p++ != 0;
+        uint32_t count = get32();
+        node.next = get32();
+        if (!node.leaf) node.values.push_back(get32());
+        for (uint32_t i = 0; i < count; ++i) {
+            uint16_t length;
+            std::memcpy(&length, p, 2);
+            p += 2;
+            node.keys.emplace_back(reinterpret_cast<const char*>(p), length);
+            p += length;
+            node.values.push_back(get32());
+        }
+    }
+};
+
+// Disk-resident B+tree name index: 4 KB pages in one file behind a small
+// BufferPool, so ordered scans and lookups cost a predictable number of page
+// reads however large the roster is. Page 0 is a header; the tree is marked
+// dirty there before the first change and clean after a full write-back, and
+// an index left dirty by a crash is rebuilt from the roster.
+class BTreeNameIndex : public NameIndex {
+public:
+    static constexpr size_t kMaxKeySize = 1000; // guarantees a split always fits
+
+    explicit BTreeNameIndex(const std::string& path, size_t poolFrames = 64) : path(path), poolFrames(poolFrames) {
+        std::filesystem::path parent = std::filesystem::path(path).parent_path();
+        if (!parent.empty()) std::filesystem::create_directories(parent);
+        file = std::fopen(path.c_str(), "r+b");
+        if (!file) file = std::fopen(path.c_str(), "w+b");
+        if (!file) throw std::runtime_error("cannot open " + path);
+        pool.reset(new BufferPool(file, poolFrames));
+        if (!ReadHeader() || !header.clean) Reset();
+    }
+
+    ~BTreeNameIndex() override {
+        std::unique_lock<std::shared_mutex> lock(treeMutex);
+        if (pool->FlushAll()) {
+            header.clean = 1;
+            WriteHeader();
+        }
+        std::fclose(file);
+    }
+
+    bool Find(const std::string& name, uint32_t& id) const override {
+        std::shared_lock<std::shared_mutex> lock(treeMutex);
+        BufferPool::PageRef node = FindLeaf(name);
+        auto it = std::lower_bound(node->keys.begin(), node->keys.end(), name);
+        if (it == node->keys.end() || *it != name) return false;
+        id = node->values[it - node->keys.begin()];
+        return true;
+    }
+
+    // A name already in the tree keeps its id, as in MemoryNameIndex, and is
+    // not counted again. Names over kMaxKeySize are refused.
+    bool Insert(const std::string& name, uint32_t id) override {
+        if (name.size() > kMaxKeySize) return false;
+        std::unique_lock<std::shared_mutex> lock(treeMutex);
+        MarkUnclean();
+        std::string splitKey;
+        uint32_t splitPage = 0;
+        InsertOutcome outcome = InsertInto(header.root, name, id, splitKey, splitPage);
+        if (outcome == InsertOutcome::Exists) return true;
+        if (outcome == InsertOutcome::Split) {
+            // Root split: grow the tree by one level
+            uint32_t oldRoot = header.root;
+            BufferPool::PageRef root = pool->Allocate(header.pageCount++, false);
+            root->values = {oldRoot, splitPage};
+            root->keys = {splitKey};
+            header.root = root.PageId();
+        }
+        ++header.keyCount;
+        return true;
+    }
+
+    // Holds the read lock while visiting, so visit must not call back in
+    void Scan(const std::string& from, const Visitor& visit) const override {
+        std::shared_lock<std::shared_mutex> lock(treeMutex);
+        BufferPool::PageRef leaf = FindLeaf(from);
+        size_t i = std::lower_bound(leaf->keys.begin(), leaf->keys.end(), from) - leaf->keys.begin();
+        for (;;) {
+            for (; i < leaf->keys.size(); ++i) {
+                if (!visit(leaf->keys[i], leaf->values[i])) return;
+            }
+            if (leaf->next == 0) return;
+            leaf = pool->Fetch(leaf->next);
+            i = 0;
+        }
+    }
+
+    size_t Size() const override {
+        std::shared_lock<std::shared_mutex> lock(treeMutex);
+        return header.keyCount;
+    }
+
+    void Clear() override {
+        std::unique_lock<std::shared_mutex> lock(treeMutex);
+        Reset();
+    }
+
+    size_t PageReads() const { return pool->Misses(); }
+
+private:
+    struct Header {
+        char magic[4] = {'V', 'C', 'B', 'T'};
+        uint32_t root = 1;
+        uint32_t pageCount = 2;
+        uint64_t keyCount = 0;
+        uint32_t clean = 1;
+    };
+
+    std::string path;
+    size_t poolFrames;
+    std::FILE* file = nullptr;
+    std::unique_ptr<BufferPool> pool;
+    mutable std::shared_mutex treeMutex; // readers share; the Model's writer is exclusive
+    Header header;
+
+    bool ReadHeader() {
+        Header h;
+        std::fseek(file, 0, SEEK_SET);
+        if (std::fread(&h, sizeof(h), 1, file) != 1 || std::memcmp(h.magic, "VCBT", 4) != 0) return false;
+        header = h;
+        return true;
+    }
+
+    void WriteHeader() {
+        std::fseek(file, 0, SEEK_SET);
+        std::fwrite(&header, sizeof(header), 1, file);
+        SyncFile(file);
+    }
+
+    void MarkUnclean() {
+        if (!header.clean) return;
+        header.clean = 0;
+        WriteHeader();
+    }
+
+    // Start over with an empty root leaf
+    void Reset() {
+        pool->Discard();
+        file = std::freopen(path.c_str(), "w+b", file);
+        if (!file) throw std::runtime_error("cannot reset " + path);
+        header = Header();
+        header.clean = 0;
+        std::vector<char> zeros(BufferPool::kPageSize, 0);
+        std::fwrite(zeros.data(), 1, zeros.size(), file);
+        pool.reset(new BufferPool(file, poolFrames));
+        pool->Allocate(header.root, true);
+        WriteHeader();
+    }
+
+    BufferPool::PageRef FindLeaf(const std::string& name) const {
+        BufferPool::PageRef node = pool->Fetch(header.root);
+        while (!node->leaf) {
+            size_t child = std::upper_bound(node->keys.begin(), node->keys.end(), name) - node->keys.begin();
+            node = pool->Fetch(node->values[child]);
+        }
+        return node;
+    }
+
+    enum class InsertOutcome { Exists, Inserted, Split };
+
+    // Insert below pageId. Split comes with the separator and new right page;
+    // Exists means the name was already there and nothing changed.
+    InsertOutcome InsertInto(uint32_t pageId, const std::string& name, uint32_t id, std::string& splitKey, uint32_t& splitPage) {
+        BufferPool::PageRef node = pool->Fetch(pageId);
+        if (node->leaf) {
+            auto it = std::lower_bound(node->keys.begin(), node->keys.end(), name);
+            size_t pos = it - node->keys.begin();
+            if (it != node->keys.end() && *it == name) return InsertOutcome::Exists;
+            node->keys.insert(it, name);
+            node->values.insert(node->values.begin() + pos, id);
+        } else {
+            size_t child = std::upper_bound(node->keys.begin(), node->keys.end(), name) - node->keys.begin();
+            std::string childKey;
+            uint32_t childPage = 0;
+            InsertOutcome below = InsertInto(node->values[child], name, id, childKey, childPage);
+            if (below != InsertOutcome::Split) return below;
+            node->keys.insert(node->keys.begin() + child, childKey);
+            node->values.insert(node->values.begin() + child + 1, childPage);
+        }
+        node.MarkDirty();
+        if (node->EncodedSize() <= BufferPool::kPageSize) return InsertOutcome::Inserted;
+        Split(node, splitKey, splitPage);
+        return InsertOutcome::Split;
+    }
+
+    // Move the upper half (by bytes) of an overfull node into a new page
+    void Split(const BufferPool::PageRef& node, std::string& splitKey, uint32_t& splitPage) {
+        size_t total = node->EncodedSize(), running = 0, mid = 0;
+        while (mid < node->keys.size() - 1 && running < total / 2) running += 6 + node->keys[mid++].size();
+        mid = std::max<size_t>(mid, 1);
+
+        BufferPool::PageRef right = pool->Allocate(header.pageCount++, node->leaf);
+        if (node->leaf) {
+            right->keys.assign(node->keys.begin() + mid, node->keys.end());
+            right->values.assign(node->values.begin() + mid, node->values.end());
+            right->next = node->next;
+            node->next = right.PageId();
+            splitKey = right->keys.front();
+        } else {
+            // The middle separator moves up instead of staying in either half
+            splitKey = node->keys[mid];
+            right->keys.assign(node->keys.begin() + mid + 1, node->keys.end());
+            right->values.assign(node->values.begin() + mid + 1, node->values.end());
+        }
+        node->keys.resize(mid);
+        node->values.resize(node->leaf ? mid : mid + 1);
+        splitPage = right.PageId();
+    }
+};
+
+// Memory-resident Bloom filter in front of a disk-backed index. Most names a
+// teacher adds are new, and the filter answers "definitely not present" for
+// them without touching the index. The filter grows with the roster, is saved
+// next to the index on shutdown and rebuilt from the index if it is missing
+// or out of date.
+class BloomFilteredIndex : public NameIndex {
+public:
+    struct Stats {
+        uint64_t lookups = 0;
+        uint64_t skipped = 0;        // answered by the filter alone
+        uint64_t falsePositives = 0; // filter said maybe, index said no
+        size_t keys = 0;
+        size_t bits = 0;
+        double estimatedRate = 0;
+
+        // Share of absent names the filter failed to rule out
+        double ObservedRate() const {
+            uint64_t absent = skipped + falsePositives;
+            return absent ? static_cast<double>(falsePositives) / absent : 0.0;
+        }
+    };
+
+    BloomFilteredIndex(std::unique_ptr<NameIndex> inner, const std::string& path)
+        : inner(std::move(inner)), path(path) {
+        std::string body;
+        uint64_t savedKeys = 0;
+        if (RecoverSnapshotFile(path, body) && body.size() >= 8) {
+            std::memcpy(&savedKeys, body.data(), 8);
+            if (savedKeys == this->inner->Size() && filter.Decode(body.substr(8))) {
+                keys = savedKeys;
+                return;
+            }
+        }
+        Rebuild();
+    }
+
+    ~BloomFilteredIndex() override {
+        std::string body(8, '\0');
+        uint64_t savedKeys = keys;
+        std::memcpy(&body[0], &savedKeys, 8);
+        body += filter.Encode();
+        if (!WriteSnapshotFile(path, body)) std::cerr << "Warning: could not save " << path << ".\n";
+    }
+
+    bool Find(const std::string& name, uint32_t& id) const override {
+        lookups.fetch_add(1, std::memory_order_relaxed);
+        {
+            std::shared_lock<std::shared_mutex> lock(filterMutex);
+            if (!filter.MayContain(name)) {
+                skipped.fetch_add(1, std::memory_order_relaxed);
+                return false;
+            }
+        }
+        if (inner->Find(name, id)) return true;
+        falsePositives.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+
+    bool Insert(const std::string& name, uint32_t id) override {
+        if (!inner->Insert(name, id)) return false;
+        bool full;
+        {
+            std::unique_lock<std::shared_mutex> lock(filterMutex);
+            filter.Add(name);
+            full = ++keys > filter.BitCount() / kBitsPerKey;
+        }
+        if (full) Rebuild();
+        return true;
+    }
+
+    void Scan(const std::string& from, const Visitor& visit) const override { inner->Scan(from, visit); }
+    size_t Size() const override { return inner->Size(); }
+
+    void Clear() override {
+        inner->Clear();
+        Rebuild();
+    }
+
+    Stats GetStats() const {
+        Stats stats;
+        stats.lookups = lookups.load();
+        stats.skipped = skipped.load();
+        stats.falsePositives = falsePositives.load();
+        std::shared_lock<std::shared_mutex> lock(filterMutex);
+        stats.keys = keys;
+        stats.bits = filter.BitCount();
+        stats.estimatedRate = filter.EstimatedFalsePositiveRate(keys);
+        return stats;
+    }
+
+private:
+    static constexpr size_t kBitsPerKey = 10;
+    static constexpr size_t kMinCapacity = 1024;
+
+    std::unique_ptr<NameIndex> inner;
+    std::string path;
+    mutable std::shared_mutex filterMutex; // guards filter and keys
+    BloomFilter filter;
+    size_t keys = 0;
+    mutable std::atomic<uint64_t> lookups{0}, skipped{0}, falsePositives{0};
+
+    // Size a new filter for twice the current roster and refill it from the index
+    void Rebuild() {
+        size_t present = inner->Size();
+        BloomFilter fresh(std::max(kMinCapacity, present * 2), kBitsPerKey);
+        inner->Scan("", [&](const std::string& name, uint32_t) {
+            fresh.Add(name);
+            return true;
+        });
+        std::unique_lock<std::shared_mutex> lock(filterMutex);
+        filter = std::move(fresh);
+        keys = present;
+    }
+};
+
+// Days since 1970-01-01 for a civil date, and back (proleptic Gregorian)
+inline int32_t DaysFromCivil(int year, unsigned month, unsigned day) {
+    year -= month <= 2;
+    const int era = (year >= 0 ? year : year - 399) / 400;
+    const unsigned yoe = static_cast<unsigned>(year - era * 400);
+    const unsigned doy = (153 * (month + (month > 2 ? -3 : 9)) + 2) / 5 + day - 1;
+    const unsigned doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+    return era * 146097 + static_cast<int32_t>(doe) - 719468;
+}
+
+inline std::string FormatDate(int32_t days) {
+    days += 719468;
+    const int era = (days >= 0 ? days : days - 146096) / 146097;
+    const unsigned doe = static_cast<unsigned>(days - era * 146097);
+    const unsigned yoe = (doe - doe / 1460 + doe / 36524 - doe / 146096) / 365;
+    const unsigned doy = doe - (365 * yoe + yoe / 4 - yoe / 100);
+    const unsigned mp = (5 * doy + 2) / 153;
+    const unsigned day = doy - (153 * mp + 2) / 5 + 1;
+    const unsigned month = mp < 10 ? mp + 3 : mp - 9;
+    const int year = static_cast<int>(yoe) + era * 400 + (month <= 2);
+    char buffer[32];
+    std::snprintf(buffer, sizeof(buffer), "%04d-%02u-%02u", year, month, day);
+    return buffer;
+}
+
+// Length of a month, counting Gregorian leap years
+inline unsigned DaysInMonth(int year, unsigned month) {
+    static const unsigned kDays[] = {31, 28, 31, 30, 31, 30, 31, 31, 30, 31, 30, 31};
+    bool leap = year % 4 == 0 && (year % 100 != 0 || year % 400 == 0);
+    return month == 2 && leap ? 29 : kDays[month - 1];
+}
+
+// Parse "YYYY-MM-DD"; returns false if malformed or not a real date
+inline bool ParseDate(const std::string& text, int32_t& days) {
+    int year = 0;
+    unsigned month = 0, day = 0;
+    char dash1 = 0, dash2 = 0;
+    std::istringstream in(text);
+    if (!(in >> year >> dash1 >> month >> dash2 >> day) || dash1 != '-' || dash2 != '-') return false;
+    if (month < 1 || month > 12 || day < 1 || day > DaysInMonth(year, month)) return false;
+    days = DaysFromCivil(year, month, day);
+    return true;
+}
+
+// Today's date (UTC) in days since 1970-01-01
+inline int32_t Today() {
+    using namespace std::chrono;
+    return static_cast<int32_t>(duration_cast<hours>(system_clock::now().time_since_epoch()).count() / 24);
+}
+
+// Milliseconds since the epoch
+inline int64_t NowMs() {
+    using namespace std::chrono;
+    return duration_cast<milliseconds>(system_clock::now().time_since_epoch()).count();
+}
+
+// "YYYY-MM-DD HH:MM:SS" (UTC) for milliseconds since the epoch
+inline std::string FormatTimestamp(int64_t ms) {
+    int64_t seconds = ms >= 0 ? ms / 1000 : (ms - 999) / 1000;
+    int64_t day = seconds >= 0 ? seconds / 86400 : (seconds - 86399) / 86400;
+    int64_t rest = seconds - day * 86400;
+    char buffer[16];
+    std::snprintf(buffer, sizeof(buffer), " %02d:%02d:%02d", static_cast<int>(rest / 3600),
+                  static_cast<int>(rest / 60 % 60), static_cast<int>(rest % 60));
+    return FormatDate(static_cast<int32_t>(day)) + buffer;
+}
+
+// First and last day of the calendar month containing days
+inline void MonthBounds(int32_t days, int32_t& first, int32_t& last) {
+    std::string date = FormatDate(days);
+    int year = std::atoi(date.c_str());
+    unsigned month = static_cast<unsigned>(std::atoi(date.c_str() + date.size() - 5));
+    first = DaysFromCivil(year, month, 1);
+    last = (month == 12 ? DaysFromCivil(year + 1, 1, 1) : DaysFromCivil(year, month + 1, 1)) - 1;
+}
+
+// Column of small unsigned values packed `bits` to a lane, 64 / bits lanes per
+// word. Widths are powers of two so lanes never straddle words, which lets
+// equality scans compare a whole word of lanes at once (SWAR).
+class PackedColumn {
+public:
+    explicit PackedColumn(unsigned bits) : bits(bits) {}
+
+    size_t size() const { return count; }
+    unsigned Bits() const { return bits; }
+    uint32_t MaxValue() const { return bits >= 32 ? 0xFFFFFFFFu : (1u << bits) - 1; }
+
+    uint32_t Get(size_t i) const {
+        return static_cast<uint32_t>((words[i / Lanes()] >> ((i % Lanes()) * bits)) & LaneMask());
+    }
+
+    void Set(size_t i, uint32_t value) {
+        uint64_t& word = words[i / Lanes()];
+        unsigned shift = static_cast<unsigned>((i % Lanes()) * bits);
+        word = (word & ~(LaneMask() << shift)) | ((uint64_t(value) & LaneMask()) << shift);
+    }
+
+    void Resize(size_t n) {
+        count = n;
+        words.resize((n + Lanes() - 1) / Lanes(), 0);
+    }
+
+    // Re-pack into wider lanes once values outgrow the current width
+    void Widen(unsigned newBits) {
+        PackedColumn wider(newBits);
+        wider.Resize(count);
+        for (size_t i = 0; i < count; ++i) wider.Set(i, Get(i));
+        *this = std::move(wider);
+    }
+
+    // Rows in [begin, end) whose value equals value, appended to out.
+    // begin must be a multiple of 64 so every word starts on a row boundary.
+    void SelectEqual(uint32_t value, size_t begin, size_t end, std::vector<uint32_t>& out) const {
+        const size_t lanes = Lanes();
+        for (size_t w = begin / lanes; w * lanes < end; ++w) {
+            uint64_t hits = EqualLanes(words[w], value);
+            while (hits) {
+                size_t row = w * lanes + static_cast<size_t>(CountTrailingZeros(hits)) / bits;
+                if (row >= end) break;
+                if (row >= begin) out.push_back(static_cast<uint32_t>(row));
+                hits &= hits - 1;
+            }
+        }
+    }
+
+    size_t CountEqual(uint32_t value) const {
+        size_t total = 0;
+        for (size_t w = 0; w < words.size(); ++w) {
+            uint64_t hits = EqualLanes(words[w], value);
+            size_t used = std::min(Lanes(), count - w * Lanes());
+            if (used < Lanes()) hits &= (uint64_t(1) << (used * bits)) - 1;
+            total += static_cast<size_t>(PopCount(hits));
+        }
+        return total;
+    }
+
+    static int PopCount(uint64_t x) {
+#if defined(__GNUC__) || defined(__clang__)
+        return __builtin_popcountll(x);
+#else
+        int n = 0;
+        for (; x; x &= x - 1) ++n;
+        return n;
+#endif
+    }
+
+    static int CountTrailingZeros(uint64_t x) {
+#if defined(__GNUC__) || defined(__clang__)
+        return __builtin_ctzll(x);
+#else
+        int n = 0;
+        for (; !(x & 1); x >>= 1) ++n;
+        return n;
+#endif
+    }
+
+private:
+    unsigned bits;
+    size_t count = 0;
+    std::vector<uint64_t> words;
+
+    size_t Lanes() const { return 64 / bits; }
+    uint64_t LaneMask() const { return bits == 64 ? ~uint64_t(0) : (uint64_t(1) << bits) - 1; }
+
+    // Every lane's value repeated across a word
+    uint64_t Broadcast(uint32_t value) const {
+        uint64_t pattern = 0;
+        for (size_t lane = 0; lane < Lanes(); ++lane) pattern |= uint64_t(value) << (lane * bits);
+        return pattern;
+    }
+
+    // Top bit of each lane set where the lane equals value. Adding the
+    // low-bit mask carries into a lane's top bit exactly when its low bits
+    // are nonzero, and never across lanes.
+    uint64_t EqualLanes(uint64_t word, uint32_t value) const {
+        uint64_t x = word ^ Broadcast(value);
+        uint64_t high = Broadcast(uint32_t(1) << (bits - 1));
+        uint64_t low = ~high;
+        uint64_t nonzero = (((x & low) + low) | x) & high;
+        return ~nonzero & high;
+    }
+};
+
+enum class StudentStatus : uint8_t { Active, OnLeave, Graduated, Withdrawn };
+
+inline const char* StatusName(StudentStatus status) {
+    switch (status) {
+        case StudentStatus::Active: return "Active";
+        case StudentStatus::OnLeave: return "On leave";
+        case StudentStatus::Graduated: return "Graduated";
+        case StudentStatus::Withdrawn: return "Withdrawn";
+    }
+    return "Unknown";
+}
+
+inline bool ParseStatus(std::string text, StudentStatus& status) {
+    std::transform(text.begin(), text.end(), text.begin(), [](unsigned char c) { return std::tolower(c); });
+    if (text == "active") status = StudentStatus::Active;
+    else if (text == "on leave" || text == "onleave" || text == "leave") status = StudentStatus::OnLeave;
+    else if (text == "graduated") status = StudentStatus::Graduated;
+    else if (text == "withdrawn") status = StudentStatus::Withdrawn;
+    else return false;
+    return true;
+}
+
+// One student's attributes, as passed in and out of the columnar store
+struct StudentAttributes {
+    uint8_t gradeLevel = 0;                    // 0 = unknown, otherwise 1-12
+    std::string cohort;                        // e.g. "2026"; empty = none
+    StudentStatus status = StudentStatus::Active;
+    int32_t enrollmentDay = 0;                 // days since 1970-01-01; 0 = unknown
+    float gpa = std::numeric_limits<float>::quiet_NaN(); // NaN = no GPA yet
+
+    bool IsDefault() const {
+        return gradeLevel == 0 && cohort.empty() && status == StudentStatus::Active && enrollmentDay == 0
+            && std::isnan(gpa);
+    }
+
+    // Tab-separated form used by the roster stores
+    std::string Encode() const {
+        std::ostringstream out;
+        out << int(gradeLevel) << '\t' << cohort << '\t' << int(status) << '\t' << enrollmentDay << '\t' << gpa;
+        return out.str();
+    }
+
+    bool Decode(const std::string& text) {
+        std::vector<std::string> fields;
+        std::stringstream in(text);
+        std::string field;
+        while (std::getline(in, field, '\t')) fields.push_back(field);
+        if (fields.size() != 5) return false;
+        try {
+            gradeLevel = static_cast<uint8_t>(std::min(12, std::max(0, std::stoi(fields[0]))));
+            cohort = fields[1];
+            status = static_cast<StudentStatus>(std::stoi(fields[2]) & 3);
+            enrollmentDay = std::stoi(fields[3]);
+            gpa = fields[4] == "nan" ? std::numeric_limits<float>::quiet_NaN() : std::stof(fields[4]);
+        } catch (const std::exception&) {
+            return false;
+        }
+        return true;
+    }
+};
+
+// Attribute columns a query can filter, group, aggregate or sort on
+enum class StudentColumn { Name, GradeLevel, Cohort, Status, EnrollmentDate, Gpa };
+
+inline const char* ColumnName(StudentColumn column) {
+    switch (column) {
+        case StudentColumn::Name: return "name";
+        case StudentColumn::GradeLevel: return "grade";
+        case StudentColumn::Cohort: return "cohort";
+        case StudentColumn::Status: return "status";
+        case StudentColumn::EnrollmentDate: return "enrolled";
+        case StudentColumn::Gpa: return "gpa";
+    }
+    return "?";
+}
+
+inline bool ParseColumn(const std::string& text, StudentColumn& column) {
+    for (StudentColumn c : {StudentColumn::Name, StudentColumn::GradeLevel, StudentColumn::Cohort,
+                            StudentColumn::Status, StudentColumn::EnrollmentDate, StudentColumn::Gpa}) {
+        if (text == ColumnName(c)) {
+            column = c;
+            return true;
+        }
+    }
+    return false;
+}
+
+// One "column op value" condition. Values are held in the column's own
+// encoding: status and cohort as codes, dates as days, GPA as a float.
+// Students with no GPA or date never match a condition on that column.
+struct StudentPredicate {
+    enum class Op { Eq, Ne, Lt, Le, Gt, Ge };
+
+    StudentColumn column = StudentColumn::Gpa;
+    Op op = Op::Eq;
+    double number = 0;     // grade, status code, day or GPA
+    std::string text;      // cohort name
+};
+
+// Parse "gpa>3.0", "status = active", "cohort=2026", "enrolled>=2025-09-01"
+inline bool ParsePredicate(const std::string& text, StudentPredicate& predicate) {
+    size_t opStart = text.find_first_of("=!<>");
+    if (opStart == std::string::npos || opStart == 0) return false;
+    size_t opEnd = text.find_first_not_of("=!<>", opStart);
+    if (opEnd == std::string::npos) return false;
+    auto trim = [](std::string s) {
+        s.erase(s.find_last_not_of(" \t") + 1);
+        s.erase(0, s.find_first_not_of(" \t"));
+        return s;
+    };
+    std::string name = trim(text.substr(0, opStart)), op = text.substr(opStart, opEnd - opStart);
+    std::string value = trim(text.substr(opEnd));
+    using Op = StudentPredicate::Op;
+    if (op == "=" || op == "==") predicate.op = Op::Eq;
+    else if (op == "!=") predicate.op = Op::Ne;
+    else if (op == "<") predicate.op = Op::Lt;
+    else if (op == "<=") predicate.op = Op::Le;
+    else if (op == ">") predicate.op = Op::Gt;
+    else if (op == ">=") predicate.op = Op::Ge;
+    else return false;
+    if (!ParseColumn(name, predicate.column) || predicate.column == StudentColumn::Name || value.empty()) return false;
+
+    switch (predicate.column) {
+        case StudentColumn::Cohort:
+            predicate.text = value;
+            return predicate.op == Op::Eq || predicate.op == Op::Ne;
+        case StudentColumn::Status: {
+            StudentStatus status;
+            if (!ParseStatus(value, status)) return false;
+            predicate.number = static_cast<double>(status);
+            return predicate.op == Op::Eq || predicate.op == Op::Ne;
+        }
+        case StudentColumn::EnrollmentDate: {
+            int32_t day;
+            if (!ParseDate(value, day)) return false;
+            predicate.number = day;
+            return true;
+        }
+        case StudentColumn::GradeLevel: {
+            char* end = nullptr;
+            long grade = std::strtol(value.c_str(), &end, 10);
+            predicate.number = static_cast<double>(grade);
+            return *end == '\0' && grade >= 0 && grade <= 15;
+        }
+        default: {
+            char* end = nullptr;
+            predicate.number = std::strtod(value.c_str(), &end);
+            return *end == '\0';
+        }
+    }
+}
+
+// Secondary index over one attribute column, mapping column values to the
+// student IDs holding them. Keys are the column's own encoding as a double:
+// grade, status code, cohort code, day number or GPA. Missing values (no grade
+// level, GPA or enrollment date) are not indexed, matching the query engine,
+// where they fail every condition.
+class AttributeIndex {
+public:
+    enum class Type { Hash, Sorted, Bitmap };
+
+    virtual ~AttributeIndex() = default;
+
+    virtual Type GetType() const = 0;
+    virtual void Insert(double key, uint32_t row) = 0;
+    virtual void Erase(double key, uint32_t row) = 0;
+
+    // Append the rows whose key passes "key op value" to rows, ascending.
+    // Returns false if this kind of index cannot answer op.
+    virtual bool Lookup(StudentPredicate::Op op, double value, std::vector<uint32_t>& rows) const = 0;
+
+    // Rows Lookup would return, possibly estimated; SIZE_MAX if op is unsupported
+    virtual size_t Estimate(StudentPredicate::Op op, double value) const = 0;
+
+    uint64_t Lookups() const { return lookups.load(std::memory_order_relaxed); }
+
+protected:
+    mutable std::atomic<uint64_t> lookups{0};
+};
+
+inline const char* IndexTypeName(AttributeIndex::Type type) {
+    switch (type) {
+        case AttributeIndex::Type::Hash: return "hash";
+        case AttributeIndex::Type::Sorted: return "sorted";
+        case AttributeIndex::Type::Bitmap: return "bitmap";
+    }
+    return "?";
+}
+
+inline bool ParseIndexType(const std::string& text, AttributeIndex::Type& type) {
+    for (auto t : {AttributeIndex::Type::Hash, AttributeIndex::Type::Sorted, AttributeIndex::Type::Bitmap}) {
+        if (text == IndexTypeName(t)) {
+            type = t;
+            return true;
+        }
+    }
+    return false;
+}
+
+// Equality only: an unordered row list per distinct key. Each row remembers
+// its slot in its list, so an update is a swap-remove plus an append, O(1)
+// however many students share the key; lookups sort the rows they return.
+class HashAttributeIndex : public AttributeIndex {
+public:
+    Type GetType() const override { return Type::Hash; }
+
+    void Insert(double key, uint32_t row) override {
+        auto& rows = buckets[key];
+        if (slots.size() <= row) slots.resize(row + 1, 0);
+        slots[row] = static_cast<uint32_t>(rows.size());
+        rows.push_back(row);
+    }
+
+    void Erase(double key, uint32_t row) override {
+        auto bucket = buckets.find(key);
+        if (bucket == buckets.end() || row >= slots.size()) return;
+        auto& rows = bucket->second;
+        uint32_t slot = slots[row];
+        if (slot >= rows.size() || rows[slot] != row) return;
+        rows[slot] = rows.back();
+        slots[rows[slot]] = slot;
+        rows.pop_back();
+        if (rows.empty()) buckets.erase(bucket);
+    }
+
+    bool Lookup(StudentPredicate::Op op, double value, std::vector<uint32_t>& rows) const override {
+        if (op != StudentPredicate::Op::Eq) return false;
+        ++lookups;
+        auto bucket = buckets.find(value);
+        if (bucket == buckets.end()) return true;
+        size_t start = rows.size();
+        rows.insert(rows.end(), bucket->second.begin(), bucket->second.end());
+        std::sort(rows.begin() + start, rows.end());
+        return true;
+    }
+
+    size_t Estimate(StudentPredicate::Op op, double value) const override {
+        if (op != StudentPredicate::Op::Eq) return SIZE_MAX;
+        auto bucket = buckets.find(value);
+        return bucket == buckets.end() ? 0 : bucket->second.size();
+    }
+
+private:
+    std::unordered_map<double, std::vector<uint32_t>> buckets;
+    std::vector<uint32_t> slots; // position of each row in its bucket
+};
+
+// Ordered (key, row) pairs for equality and range conditions
+class SortedAttributeIndex : public AttributeIndex {
+public:
+    Type GetType() const override { return Type::Sorted; }
+
+    void Insert(double key, uint32_t row) override { entries.emplace(key, row); }
+    void Erase(double key, uint32_t row) override { entries.erase({key, row}); }
+
+    bool Lookup(StudentPredicate::Op op, double value, std::vector<uint32_t>& rows) const override {
+        if (op == StudentPredicate::Op::Ne) return false;
+        ++lookups;
+        auto range = Range(op, value);
+        size_t start = rows.size();
+        for (auto it = range.first; it != range.second; ++it) rows.push_back(it->second);
+        std::sort(rows.begin() + start, rows.end());
+        return true;
+    }
+
+    // Equality is counted; a range is assumed to keep a third of the rows
+    size_t Estimate(StudentPredicate::Op op, double value) const override {
+        if (op == StudentPredicate::Op::Ne) return SIZE_MAX;
+        if (op != StudentPredicate::Op::Eq) return entries.size() / 3;
+        auto range = Range(op, value);
+        return static_cast<size_t>(std::distance(range.first, range.second));
+    }
+
+private:
+    using Entries = std::set<std::pair<double, uint32_t>>;
+    Entries entries;
+
+    std::pair<Entries::const_iterator, Entries::const_iterator> Range(StudentPredicate::Op op, double value) const {
+        const uint32_t kFirst = 0, kLast = std::numeric_limits<uint32_t>::max();
+        auto below = entries.lower_bound({value, kFirst});  // first key >= value
+        auto above = entries.upper_bound({value, kLast});   // first key > value
+        switch (op) {
+            case StudentPredicate::Op::Eq: return {below, above};
+            case StudentPredicate::Op::Lt: return {entries.begin(), below};
+            case StudentPredicate::Op::Le: return {entries.begin(), above};
+            case StudentPredicate::Op::Gt: return {above, entries.end()};
+            case StudentPredicate::Op::Ge: return {below, entries.end()};
+            case StudentPredicate::Op::Ne: break;
+        }
+        return {entries.end(), entries.end()};
+    }
+};
+
+// One bitmap over student IDs per distinct key, for low-cardinality columns.
+// Any condition is answered by OR-ing the bitmaps of the keys that pass it.
+class BitmapAttributeIndex : public AttributeIndex {
+public:
+    Type GetType() const override { return Type::Bitmap; }
+
+    void Insert(double key, uint32_t row) override {
+        Bitmap& bitmap = bitmaps[key];
+        if (bitmap.words.size() <= row / 64) bitmap.words.resize(row / 64 + 1, 0);
+        bitmap.words[row / 64] |= uint64_t(1) << (row % 64);
+        ++bitmap.count;
+    }
+
+    void Erase(double key, uint32_t row) override {
+        auto it = bitmaps.find(key);
+        if (it == bitmaps.end() || it->second.words.size() <= row / 64) return;
+        uint64_t& word = it->second.words[row / 64];
+        uint64_t bit = uint64_t(1) << (row % 64);
+        if (!(word & bit)) return;
+        word &= ~bit;
+        if (--it->second.count == 0) bitmaps.erase(it);
+    }
+
+    bool Lookup(StudentPredicate::Op op, double value, std::vector<uint32_t>& rows) const override {
+        ++lookups;
+        std::vector<uint64_t> merged;
+        for (const auto& entry : bitmaps) {
+            if (!Passes(op, entry.first, value)) continue;
+            const auto& words = entry.second.words;
+            if (merged.size() < words.size()) merged.resize(words.size(), 0);
+            for (size_t w = 0; w < words.size(); ++w) merged[w] |= words[w];
+        }
+        for (size_t w = 0; w < merged.size(); ++w) {
+            for (uint64_t bits = merged[w]; bits; bits &= bits - 1) {
+                rows.push_back(static_cast<uint32_t>(w * 64 + PackedColumn::CountTrailingZeros(bits)));
+            }
+        }
+        return true;
+    }
+
+    size_t Estimate(StudentPredicate::Op op, double value) const override {
+        size_t total = 0;
+        for (const auto& entry : bitmaps) {
+            if (Passes(op, entry.first, value)) total += entry.second.count;
+        }
+        return total;
+    }
+
+private:
+    struct Bitmap {
+        std::vector<uint64_t> words;
+        size_t count = 0;
+    };
+    std::map<double, Bitmap> bitmaps;
+
+    static bool Passes(StudentPredicate::Op op, double key, double value) {
+        switch (op) {
+            case StudentPredicate::Op::Eq: return key == value;
+            case StudentPredicate::Op::Ne: return key != value;
+            case StudentPredicate::Op::Lt: return key < value;
+            case StudentPredicate::Op::Le: return key <= value;
+            case StudentPredicate::Op::Gt: return key > value;
+            case StudentPredicate::Op::Ge: return key >= value;
+        }
+        return false;
+    }
+};
+
+// Per-student attributes stored column by column (structure of arrays),
+// indexed by student ID. Low-cardinality columns are bit-packed: grade level
+// in 4 bits, status in 2, cohort as a dictionary code starting at 8 bits and
+// widened as the dictionary grows. Dates and GPAs are plain arrays. A scan
+// reads only the columns it filters or aggregates on.
+//
+// Secondary indexes declared with AddIndex are kept in step with the columns
+// by EnsureRows and Set, under the same lock, so a reader never sees an index
+// that disagrees with the data.
+//
+// Mutations happen under the unique lock and scans under the shared lock;
+// use Read() to hold it for a multi-step operation.
+class StudentAttributeStore {
+public:
+    StudentAttributeStore() : gradeLevels(4), statuses(2), cohortCodes(8) {
+        cohortNames.push_back(""); // code 0: no cohort
+    }
+
+    template <typename F>
+    auto Read(F fn) const -> decltype(fn(*this)) {
+        std::shared_lock<std::shared_mutex> lock(mutex);
+        return fn(*this);
+    }
+
+    // Grow every column so student IDs below rows have a (default) row
+    void EnsureRows(size_t rows) {
+        std::unique_lock<std::shared_mutex> lock(mutex);
+        if (rows <= gradeLevels.size()) return;
+        gradeLevels.Resize(rows);
+        statuses.Resize(rows);
+        cohortCodes.Resize(rows);
+        size_t first = enrollmentDays.size();
+        enrollmentDays.resize(rows, 0);
+        gpas.resize(rows, std::numeric_limits<float>::quiet_NaN());
+        for (auto& index : indexes) {
+            for (size_t row = first; row < rows; ++row) IndexRow(index, static_cast<uint32_t>(row), true);
+        }
+    }
+
+    void Set(uint32_t id, const StudentAttributes& attributes) {
+        std::unique_lock<std::shared_mutex> lock(mutex);
+        if (id >= gradeLevels.size()) return;
+        for (auto& index : indexes) IndexRow(index, id, false);
+        gradeLevels.Set(id, attributes.gradeLevel);
+        statuses.Set(id, static_cast<uint32_t>(attributes.status));
+        cohortCodes.Set(id, CohortCode(attributes.cohort));
+        enrollmentDays[id] = attributes.enrollmentDay;
+        gpas[id] = attributes.gpa;
+        for (auto& index : indexes) IndexRow(index, id, true);
+    }
+
+    // Declare a secondary index on column, built from the current rows.
+    // Returns false if that column already has an index of that type.
+    bool AddIndex(StudentColumn column, AttributeIndex::Type type) {
+        std::unique_lock<std::shared_mutex> lock(mutex);
+        if (column == StudentColumn::Name || FindIndex(column, type)) return false;
+        Declared declared{column, nullptr};
+        switch (type) {
+            case AttributeIndex::Type::Hash: declared.index.reset(new HashAttributeIndex()); break;
+            case AttributeIndex::Type::Sorted: declared.index.reset(new SortedAttributeIndex()); break;
+            case AttributeIndex::Type::Bitmap: declared.index.reset(new BitmapAttributeIndex()); break;
+        }
+        for (size_t row = 0; row < gradeLevels.size(); ++row) IndexRow(declared, static_cast<uint32_t>(row), true);
+        indexes.push_back(std::move(declared));
+        return true;
+    }
+
+    // The declared index able to answer "column op value" with the fewest
+    // rows, or null if none can. Unlocked, for use inside Read().
+    const AttributeIndex* BestIndex(StudentColumn column, StudentPredicate::Op op, double value, size_t& estimate) const {
+        const AttributeIndex* best = nullptr;
+        estimate = SIZE_MAX;
+        for (const auto& declared : indexes) {
+            if (declared.column != column) continue;
+            size_t rows = declared.index->Estimate(op, value);
+            if (rows < estimate) {
+                estimate = rows;
+                best = declared.index.get();
+            }
+        }
+        return best;
+    }
+
+    // Declared indexes as (column, type, lookups served)
+    std::vector<std::tuple<StudentColumn, AttributeIndex::Type, uint64_t>> ListIndexes() const {
+        std::shared_lock<std::shared_mutex> lock(mutex);
+        std::vector<std::tuple<StudentColumn, AttributeIndex::Type, uint64_t>> list;
+        for (const auto& declared : indexes) {
+            list.emplace_back(declared.column, declared.index->GetType(), declared.index->Lookups());
+        }
+        return list;
+    }
+
+    StudentAttributes Get(uint32_t id) const {
+        std::shared_lock<std::shared_mutex> lock(mutex);
+        return GetLocked(id);
+    }
+
+    // Unlocked accessors, for use inside Read()
+    size_t Rows() const { return gradeLevels.size(); }
+    StudentAttributes GetLocked(uint32_t id) const {
+        StudentAttributes attributes;
+        if (id >= gradeLevels.size()) return attributes;
+        attributes.gradeLevel = static_cast<uint8_t>(gradeLevels.Get(id));
+        attributes.status = static_cast<StudentStatus>(statuses.Get(id));
+        attributes.cohort = cohortNames[cohortCodes.Get(id)];
+        attributes.enrollmentDay = enrollmentDays[id];
+        attributes.gpa = gpas[id];
+        return attributes;
+    }
+    const PackedColumn& GradeLevels() const { return gradeLevels; }
+    const PackedColumn& Statuses() const { return statuses; }
+    const PackedColumn& CohortCodes() const { return cohortCodes; }
+    const std::vector<int32_t>& EnrollmentDays() const { return enrollmentDays; }
+    const std::vector<float>& Gpas() const { return gpas; }
+    const std::vector<std::string>& CohortNames() const { return cohortNames; }
+
+    // Students per status, counted a packed word at a time
+    std::vector<size_t> CountByStatus() const {
+        std::shared_lock<std::shared_mutex> lock(mutex);
+        std::vector<size_t> counts(4);
+        for (uint32_t status = 0; status < 4; ++status) counts[status] = statuses.CountEqual(status);
+        return counts;
+    }
+
+    // Mean GPA over students with one, and how many that is
+    double AverageGpa(size_t& graded) const {
+        std::shared_lock<std::shared_mutex> lock(mutex);
+        double sum = 0;
+        graded = 0;
+        for (float gpa : gpas) {
+            bool known = !std::isnan(gpa);
+            sum += known ? gpa : 0.0f;
+            graded += known;
+        }
+        return graded ? sum / graded : 0.0;
+    }
+
+    // Dictionary code for a cohort name, or -1 if no student has it
+    int FindCohort(const std::string& cohort) const {
+        auto it = cohortLookup.find(cohort);
+        return cohort.empty() ? 0 : (it == cohortLookup.end() ? -1 : static_cast<int>(it->second));
+    }
+
+private:
+    struct Declared {
+        StudentColumn column;
+        std::unique_ptr<AttributeIndex> index;
+    };
+
+    mutable std::shared_mutex mutex;
+    PackedColumn gradeLevels;
+    PackedColumn statuses;
+    PackedColumn cohortCodes;
+    std::vector<int32_t> enrollmentDays;
+    std::vector<float> gpas;
+    std::vector<std::string> cohortNames;
+    std::unordered_map<std::string, uint32_t> cohortLookup;
+    std::vector<Declared> indexes;
+
+    const AttributeIndex* FindIndex(StudentColumn column, AttributeIndex::Type type) const {
+        for (const auto& declared : indexes) {
+            if (declared.column == column && declared.index->GetType() == type) return declared.index.get();
+        }
+        return nullptr;
+    }
+
+    // Add or remove a row's current value in one index
+    void IndexRow(Declared& declared, uint32_t row, bool insert) {
+        double key;
+        switch (declared.column) {
+            case StudentColumn::GradeLevel:
+                if (gradeLevels.Get(row) == 0) return;
+                key = gradeLevels.Get(row);
+                break;
+            case StudentColumn::Status: key = statuses.Get(row); break;
+            case StudentColumn::Cohort: key = cohortCodes.Get(row); break;
+            case StudentColumn::EnrollmentDate:
+                if (enrollmentDays[row] == 0) return;
+                key = enrollmentDays[row];
+                break;
+            case StudentColumn::Gpa:
+                if (std::isnan(gpas[row])) return;
+                key = gpas[row];
+                break;
+            default: return;
+        }
+        if (insert) declared.index->Insert(key, row);
+        else declared.index->Erase(key, row);
+    }
+
+    uint32_t CohortCode(const std::string& cohort) {
+        if (cohort.empty()) return 0;
+        auto it = cohortLookup.find(cohort);
+        if (it != cohortLookup.end()) return it->second;
+        uint32_t code = static_cast<uint32_t>(cohortNames.size());
+        if (code > cohortCodes.MaxValue()) cohortCodes.Widen(cohortCodes.Bits() * 2);
+        cohortNames.push_back(cohort);
+        cohortLookup.emplace(cohort, code);
+        return code;
+    }
+};
+
+// A roster query: rows matching every condition in where, either listed
+// (project, with orderBy over a column) or folded into one row per groupBy
+// value (aggregate over aggregateColumn, with orderBy over the group key or
+// the aggregate). limit 0 means no limit.
+struct StudentQuery {
+    enum class Aggregate { Count, Average, Min, Max, Sum };
+
+    std::vector<StudentPredicate> where;
+    std::vector<StudentColumn> project = {StudentColumn::Name, StudentColumn::GradeLevel, StudentColumn::Cohort,
+                                          StudentColumn::Status, StudentColumn::EnrollmentDate, StudentColumn::Gpa};
+    bool grouped = false;
+    StudentColumn groupBy = StudentColumn::Status;    // GradeLevel, Cohort or Status; ignored unless grouped
+    Aggregate aggregate = Aggregate::Count;
+    StudentColumn aggregateColumn = StudentColumn::Gpa;
+    bool orderByAggregate = false;                   // grouped: sort on the aggregate instead of the key
+    StudentColumn orderBy = StudentColumn::Name;     // projected rows: sort column
+    bool descending = false;
+    size_t limit = 0;
+};
+
+// Query output, already formatted for display
+struct QueryResult {
+    std::vector<std::string> header;
+    std::vector<std::vector<std::string>> rows;
+    size_t matched = 0;   // rows that passed the filter
+    unsigned threads = 1; // workers the scan was split across
+    std::string index;    // secondary index used, e.g. "hash(cohort)"; empty for a full scan
+};
+
+// Vectorized execution of a StudentQuery over the attribute columns.
+//
+// Rows are processed in batches of kBatchRows. Each batch starts with a
+// selection vector of the row IDs passing the first condition and every
+// further condition narrows it in place, so a column is only read for rows
+// still alive. Packed columns are unpacked a batch at a time into a flat
+// array, and each comparison is a branch-free loop over that array that the
+// compiler can vectorize; equality on a packed column skips the unpacking and
+// tests a word of lanes at once. Large tables are split across cores by batch,
+// with per-worker group accumulators merged at the end.
+//
+// When a declared secondary index can answer one of the conditions and keeps
+// few enough rows, its row list seeds the selection vectors instead, batches
+// without a candidate are skipped, and the remaining conditions gather only
+// the candidates' values.
+class StudentQueryEngine {
+public:
+    static constexpr size_t kBatchRows = 4096;       // a multiple of 64, so batches start on packed-word boundaries
+    static constexpr size_t kParallelRows = 1 << 16; // below this a single thread wins
+
+    // Run query over the first rows of columns; names supplies the name column.
+    // Caller holds the store's shared lock (StudentAttributeStore::Read).
+    static QueryResult Run(const StudentAttributeStore& columns, const PagedList<std::string>& names,
+                           const StudentQuery& query, unsigned maxThreads = 0) {
+        const size_t rows = std::min(columns.Rows(), names.size());
+        const size_t batches = (rows + kBatchRows - 1) / kBatchRows;
+        unsigned threads = 1;
+        if (rows >= kParallelRows) {
+            threads = maxThreads ? maxThreads : std::max(1u, std::thread::hardware_concurrency());
+            threads = static_cast<unsigned>(std::min<size_t>(threads, batches));
+        }
+
+        // Conditions that can never match (an unknown cohort) empty the result
+        std::vector<Condition> conditions;
+        bool impossible = false;
+        for (const auto& predicate : query.where) conditions.push_back(Compile(columns, predicate, impossible));
+
+        // Start from a secondary index when one narrows the rows enough to beat a scan
+        std::vector<uint32_t> candidates;
+        bool seeded = false;
+        std::string usedIndex;
+        if (!impossible) seeded = SeedFromIndex(columns, rows, conditions, candidates, usedIndex);
+
+        const size_t groups = query.grouped ? GroupCount(columns, query.groupBy) : 1;
+        std::vector<Partial> partials(threads, Partial(groups));
+        auto work = [&](unsigned worker) {
+            if (impossible) return;
+            Partial& partial = partials[worker];
+            std::vector<uint32_t> selection;
+            std::vector<uint32_t> scratch(kBatchRows);
+            selection.reserve(kBatchRows);
+            // Contiguous ranges of batches per worker keep projected rows in ID order
+            size_t first = batches * worker / threads, last = batches * (worker + 1) / threads;
+            for (size_t batch = first; batch < last; ++batch) {
+                size_t begin = batch * kBatchRows, end = std::min(rows, begin + kBatchRows);
+                if (seeded) {
+                    auto from = std::lower_bound(candidates.begin(), candidates.end(), begin);
+                    auto to = std::lower_bound(from, candidates.end(), end);
+                    if (from == to) continue;
+                    selection.assign(from, to);
+                }
+                Filter(columns, conditions, begin, end, selection, scratch, seeded);
+                partial.matched += selection.size();
+                if (query.grouped) Accumulate(columns, query, selection, scratch, partial);
+                else partial.selected.insert(partial.selected.end(), selection.begin(), selection.end());
+            }
+        };
+        if (threads == 1) {
+            work(0);
+        } else {
+            std::vector<std::thread> pool;
+            for (unsigned worker = 0; worker < threads; ++worker) pool.emplace_back(work, worker);
+            for (auto& t : pool) t.join();
+        }
+
+        Partial total(groups);
+        for (auto& partial : partials) total.Merge(std::move(partial));
+        QueryResult result = query.grouped ? GroupRows(columns, query, total) : ProjectRows(columns, names, query, total);
+        result.matched = total.matched;
+        result.threads = threads;
+        result.index = usedIndex;
+        return result;
+    }
+
+    // Display form of one cell
+    static std::string FormatCell(const StudentAttributeStore& columns, const PagedList<std::string>& names,
+                                  StudentColumn column, uint32_t row) {
+        switch (column) {
+            case StudentColumn::Name: return names[row];
+            case StudentColumn::GradeLevel: return FormatKey(columns, column, columns.GradeLevels().Get(row));
+            case StudentColumn::Cohort: return FormatKey(columns, column, columns.CohortCodes().Get(row));
+            case StudentColumn::Status: return FormatKey(columns, column, columns.Statuses().Get(row));
+            case StudentColumn::EnrollmentDate: {
+                int32_t day = columns.EnrollmentDays()[row];
+                return day ? FormatDate(day) : "-";
+            }
+            case StudentColumn::Gpa: return FormatNumber(columns.Gpas()[row]);
+        }
+        return "";
+    }
+
+private:
+    // A predicate bound to this store: cohort names resolved to codes
+    struct Condition {
+        StudentColumn column;
+        StudentPredicate::Op op;
+        double number;
+    };
+
+    // Per-group running totals
+    struct Accumulator {
+        size_t rows = 0;
+        size_t valued = 0; // rows with a known aggregate value
+        double sum = 0;
+        double min = std::numeric_limits<double>::infinity();
+        double max = -std::numeric_limits<double>::infinity();
+    };
+
+    struct Partial {
+        explicit Partial(size_t groups) : groups(groups) {}
+        std::vector<Accumulator> groups;
+        std::vector<uint32_t> selected;
+        size_t matched = 0;
+
+        void Merge(Partial&& other) {
+            for (size_t g = 0; g < groups.size(); ++g) {
+                Accumulator& into = groups[g];
+                const Accumulator& from = other.groups[g];
+                into.rows += from.rows;
+                into.valued += from.valued;
+                into.sum += from.sum;
+                into.min = std::min(into.min, from.min);
+                into.max = std::max(into.max, from.max);
+            }
+            selected.insert(selected.end(), other.selected.begin(), other.selected.end());
+            matched += other.matched;
+        }
+    };
+
+    static Condition Compile(const StudentAttributeStore& columns, const StudentPredicate& predicate, bool& impossible) {
+        Condition condition{predicate.column, predicate.op, predicate.number};
+        if (predicate.column == StudentColumn::Cohort) {
+            int code = columns.FindCohort(predicate.text);
+            if (code < 0) {
+                // Nobody has this cohort: "=" matches nothing, "!=" everything
+                if (predicate.op == StudentPredicate::Op::Eq) impossible = true;
+                code = -1;
+            }
+            condition.number = code;
+        }
+        // GPAs are stored as floats; compare against the float the column would hold
+        if (predicate.column == StudentColumn::Gpa) condition.number = static_cast<float>(predicate.number);
+        return condition;
+    }
+
+    // Replace the condition with the most selective index by that index's rows.
+    // Indexes are skipped when they would return more than a quarter of the
+    // table, where scanning the packed columns is cheaper than the lookup.
+    static bool SeedFromIndex(const StudentAttributeStore& columns, size_t rows, std::vector<Condition>& conditions,
+                              std::vector<uint32_t>& candidates, std::string& used) {
+        const AttributeIndex* best = nullptr;
+        size_t bestCondition = 0, bestEstimate = rows / 4 + 1;
+        for (size_t c = 0; c < conditions.size(); ++c) {
+            if (conditions[c].number < 0 && conditions[c].column == StudentColumn::Cohort) continue;
+            size_t estimate;
+            const AttributeIndex* index = columns.BestIndex(conditions[c].column, conditions[c].op, conditions[c].number, estimate);
+            if (index && estimate < bestEstimate) {
+                best = index;
+                bestCondition = c;
+                bestEstimate = estimate;
+            }
+        }
+        if (!best || !best->Lookup(conditions[bestCondition].op, conditions[bestCondition].number, candidates)) return false;
+        used = std::string(IndexTypeName(best->GetType())) + "(" + ColumnName(conditions[bestCondition].column) + ")";
+        conditions.erase(conditions.begin() + bestCondition);
+        return true;
+    }
+
+    static size_t GroupCount(const StudentAttributeStore& columns, StudentColumn column) {
+        switch (column) {
+            case StudentColumn::GradeLevel: return 16;
+            case StudentColumn::Status: return 4;
+            case StudentColumn::Cohort: return columns.CohortNames().size();
+            default: return 1;
+        }
+    }
+
+    // Unpack rows [begin, end) of a packed column into out
+    static void Unpack(const PackedColumn& column, size_t begin, size_t end, std::vector<uint32_t>& out) {
+        for (size_t i = begin; i < end; ++i) out[i - begin] = column.Get(i);
+    }
+
+    // Keep the rows that pass the comparison. With first set, the candidates
+    // are all of [begin, end) and values[i] belongs to row begin + i; otherwise
+    // the selection is narrowed in place and value(row) gathers each value.
+    template <typename T, typename Compare>
+    static void SelectRange(const T* values, size_t begin, size_t end, std::vector<uint32_t>& selection, Compare keep) {
+        size_t n = 0;
+        selection.resize(end - begin);
+        for (size_t i = begin; i < end; ++i) {
+            selection[n] = static_cast<uint32_t>(i);
+            n += keep(values[i - begin]);
+        }
+        selection.resize(n);
+    }
+
+    template <typename Gather, typename Compare>
+    static void Refine(std::vector<uint32_t>& selection, Gather value, Compare keep) {
+        size_t n = 0;
+        for (size_t k = 0; k < selection.size(); ++k) {
+            uint32_t row = selection[k];
+            selection[n] = row;
+            n += keep(value(row));
+        }
+        selection.resize(n);
+    }
+
+    // Apply "v op value" through either path; a missing value (NaN GPA, day 0,
+    // grade level 0) fails every comparison
+    template <typename T, typename Apply>
+    static void WithComparison(StudentPredicate::Op op, T value, bool hasMissing, T missing, Apply apply) {
+        auto known = [=](T v) { return !hasMissing || !(v == missing || v != v); };
+        switch (op) {
+            case StudentPredicate::Op::Eq: apply([=](T v) { return v == value && known(v); }); break;
+            case StudentPredicate::Op::Ne: apply([=](T v) { return v != value && known(v); }); break;
+            case StudentPredicate::Op::Lt: apply([=](T v) { return v < value && known(v); }); break;
+            case StudentPredicate::Op::Le: apply([=](T v) { return v <= value && known(v); }); break;
+            case StudentPredicate::Op::Gt: apply([=](T v) { return v > value && known(v); }); break;
+            case StudentPredicate::Op::Ge: apply([=](T v) { return v >= value && known(v); }); break;
+        }
+    }
+
+    // Contiguous values of a flat column over rows [begin, end), or gathered by row
+    template <typename T>
+    static void FilterArray(const std::vector<T>& column, const Condition& condition, T missing, bool first,
+                            size_t begin, size_t end, std::vector<uint32_t>& selection) {
+        WithComparison<T>(condition.op, static_cast<T>(condition.number), true, missing, [&](auto keep) {
+            if (first) SelectRange(column.data() + begin, begin, end, selection, keep);
+            else Refine(selection, [&](uint32_t row) { return column[row]; }, keep);
+        });
+    }
+
+    // Build the selection vector for rows [begin, end). When seeded, selection
+    // already holds the candidate rows (from an index) and every condition
+    // narrows it; otherwise the first condition fills it.
+    static void Filter(const StudentAttributeStore& columns, const std::vector<Condition>& conditions,
+                       size_t begin, size_t end, std::vector<uint32_t>& selection, std::vector<uint32_t>& scratch,
+                       bool seeded) {
+        if (!seeded) selection.clear();
+        if (conditions.empty()) {
+            if (!seeded) {
+                for (size_t i = begin; i < end; ++i) selection.push_back(static_cast<uint32_t>(i));
+            }
+            return;
+        }
+        for (size_t c = 0; c < conditions.size(); ++c) {
+            const Condition& condition = conditions[c];
+            bool first = c == 0 && !seeded;
+            if (!first && selection.empty()) return;
+            switch (condition.column) {
+                case StudentColumn::GradeLevel:
+                case StudentColumn::Cohort:
+                case StudentColumn::Status: {
+                    const PackedColumn& packed = condition.column == StudentColumn::GradeLevel ? columns.GradeLevels()
+                        : condition.column == StudentColumn::Cohort ? columns.CohortCodes() : columns.Statuses();
+                    if (condition.number < 0) { // unknown cohort under "!=": every row passes
+                        if (first) Filter(columns, {}, begin, end, selection, scratch, false);
+                        break;
+                    }
+                    // Grade level 0 means none and fails every condition, like a missing GPA
+                    uint32_t value = static_cast<uint32_t>(condition.number);
+                    bool hasMissing = condition.column == StudentColumn::GradeLevel;
+                    if (first && condition.op == StudentPredicate::Op::Eq && !(hasMissing && value == 0)) {
+                        packed.SelectEqual(value, begin, end, selection);
+                        break;
+                    }
+                    WithComparison<uint32_t>(condition.op, value, hasMissing, 0, [&](auto keep) {
+                        if (first) {
+                            Unpack(packed, begin, end, scratch);
+                            SelectRange(scratch.data(), begin, end, selection, keep);
+                        } else {
+                            Refine(selection, [&](uint32_t row) { return packed.Get(row); }, keep);
+                        }
+                    });
+                    break;
+                }
+                case StudentColumn::EnrollmentDate:
+                    FilterArray<int32_t>(columns.EnrollmentDays(), condition, 0, first, begin, end, selection);
+                    break;
+                case StudentColumn::Gpa:
+                    FilterArray<float>(columns.Gpas(), condition, std::numeric_limits<float>::quiet_NaN(),
+                                       first, begin, end, selection);
+                    break;
+                case StudentColumn::Name:
+                    break;
+            }
+        }
+    }
+
+    static double AggregateValue(const StudentAttributeStore& columns, StudentColumn column, uint32_t row, bool& known) {
+        switch (column) {
+            case StudentColumn::Gpa: {
+                float gpa = columns.Gpas()[row];
+                known = !std::isnan(gpa);
+                return gpa;
+            }
+            case StudentColumn::GradeLevel: {
+                uint32_t grade = columns.GradeLevels().Get(row);
+                known = grade != 0;
+                return grade;
+            }
+            case StudentColumn::EnrollmentDate: {
+                int32_t day = columns.EnrollmentDays()[row];
+                known = day != 0;
+                return day;
+            }
+            default:
+                known = false;
+                return 0;
+        }
+    }
+
+    static void Accumulate(const StudentAttributeStore& columns, const StudentQuery& query,
+                           const std::vector<uint32_t>& selection, std::vector<uint32_t>& keys, Partial& partial) {
+        const PackedColumn& packed = query.groupBy == StudentColumn::GradeLevel ? columns.GradeLevels()
+            : query.groupBy == StudentColumn::Cohort ? columns.CohortCodes() : columns.Statuses();
+        for (size_t k = 0; k < selection.size(); ++k) keys[k] = packed.Get(selection[k]);
+        const bool wantsValue = query.aggregate != StudentQuery::Aggregate::Count;
+        for (size_t k = 0; k < selection.size(); ++k) {
+            Accumulator& group = partial.groups[keys[k] < partial.groups.size() ? keys[k] : 0];
+            ++group.rows;
+            if (!wantsValue) continue;
+            bool known;
+            double value = AggregateValue(columns, query.aggregateColumn, selection[k], known);
+            if (!known) continue;
+            ++group.valued;
+            group.sum += value;
+            group.min = std::min(group.min, value);
+            group.max = std::max(group.max, value);
+        }
+    }
+
+    static std::string FormatNumber(double value) {
+        if (std::isnan(value)) return "-";
+        std::ostringstream out;
+        out << std::fixed << std::setprecision(2) << value;
+        return out.str();
+    }
+
+    static std::string FormatKey(const StudentAttributeStore& columns, StudentColumn column, uint32_t key) {
+        switch (column) {
+            case StudentColumn::GradeLevel: return key ? std::to_string(key) : "-";
+            case StudentColumn::Cohort: return key ? columns.CohortNames()[key] : "-";
+            case StudentColumn::Status: return StatusName(static_cast<StudentStatus>(key));
+            default: return std::to_string(key);
+        }
+    }
+
+    static QueryResult GroupRows(const StudentAttributeStore& columns, const StudentQuery& query, const Partial& total) {
+        using Aggregate = StudentQuery::Aggregate;
+        struct Row { uint32_t key; double value; };
+        std::vector<Row> rows;
+        for (size_t g = 0; g < total.groups.size(); ++g) {
+            const Accumulator& group = total.groups[g];
+            if (group.rows == 0) continue;
+            double value = std::numeric_limits<double>::quiet_NaN();
+            switch (query.aggregate) {
+                case Aggregate::Count: value = static_cast<double>(group.rows); break;
+                case Aggregate::Sum: value = group.sum; break;
+                case Aggregate::Average: if (group.valued) value = group.sum / group.valued; break;
+                case Aggregate::Min: if (group.valued) value = group.min; break;
+                case Aggregate::Max: if (group.valued) value = group.max; break;
+            }
+            rows.push_back({static_cast<uint32_t>(g), value});
+        }
+
+        auto less = [&](const Row& a, const Row& b) {
+            if (query.orderByAggregate) {
+                // Groups with no value sort last either way
+                if (std::isnan(a.value) != std::isnan(b.value)) return std::isnan(b.value);
+                if (a.value != b.value) return query.descending ? a.value > b.value : a.value < b.value;
+                return a.key < b.key;
+            }
+            if (query.groupBy != StudentColumn::Cohort) return query.descending ? a.key > b.key : a.key < b.key;
+            const std::string& ka = columns.CohortNames()[a.key];
+            const std::string& kb = columns.CohortNames()[b.key];
+            return query.descending ? ka > kb : ka < kb;
+        };
+        std::sort(rows.begin(), rows.end(), less);
+        if (query.limit && rows.size() > query.limit) rows.resize(query.limit);
+
+        static const char* aggregateNames[] = {"count", "avg", "min", "max", "sum"};
+        QueryResult result;
+        result.header = {ColumnName(query.groupBy)};
+        result.header.push_back(query.aggregate == Aggregate::Count ? std::string("count")
+            : std::string(aggregateNames[static_cast<int>(query.aggregate)]) + "(" + ColumnName(query.aggregateColumn) + ")");
+        for (const Row& row : rows) {
+            std::string value = query.aggregate == Aggregate::Count ? std::to_string(static_cast<size_t>(row.value))
+                : query.aggregateColumn == StudentColumn::EnrollmentDate && !std::isnan(row.value)
+                    && query.aggregate != Aggregate::Sum ? FormatDate(static_cast<int32_t>(std::lround(row.value)))
+                : FormatNumber(row.value);
+            result.rows.push_back({FormatKey(columns, query.groupBy, row.key), value});
+        }
+        return result;
+    }
+
+    static QueryResult ProjectRows(const StudentAttributeStore& columns, const PagedList<std::string>& names,
+                                   const StudentQuery& query, Partial& total) {
+        std::vector<uint32_t>& selected = total.selected;
+        auto sortKey = [&](uint32_t row) -> double {
+            switch (query.orderBy) {
+                case StudentColumn::GradeLevel: return columns.GradeLevels().Get(row);
+                case StudentColumn::Status: return columns.Statuses().Get(row);
+                case StudentColumn::EnrollmentDate: return columns.EnrollmentDays()[row];
+                case StudentColumn::Gpa: {
+                    float gpa = columns.Gpas()[row];
+                    return std::isnan(gpa) ? -1.0 : gpa;
+                }
+                default: return 0;
+            }
+        };
+        auto less = [&](uint32_t a, uint32_t b) {
+            if (query.orderBy == StudentColumn::Name || query.orderBy == StudentColumn::Cohort) {
+                const std::string& ka = query.orderBy == StudentColumn::Name ? names[a] : columns.CohortNames()[columns.CohortCodes().Get(a)];
+                const std::string& kb = query.orderBy == StudentColumn::Name ? names[b] : columns.CohortNames()[columns.CohortCodes().Get(b)];
+                if (ka != kb) return query.descending ? ka > kb : ka < kb;
+                return a < b;
+            }
+            double ka = sortKey(a), kb = sortKey(b);
+            if (ka != kb) return query.descending ? ka > kb : ka < kb;
+            return a < b;
+        };
+        // Only the first limit rows need to be in order
+        if (query.limit && query.limit < selected.size()) {
+            std::partial_sort(selected.begin(), selected.begin() + query.limit, selected.end(), less);
+            selected.resize(query.limit);
+        } else {
+            std::sort(selected.begin(), selected.end(), less);
+        }
+
+        QueryResult result;
+        for (StudentColumn column : query.project) result.header.push_back(ColumnName(column));
+        for (uint32_t row : selected) {
+            std::vector<std::string> cells;
+            for (StudentColumn column : query.project) cells.push_back(FormatCell(columns, names, column, row));
+            result.rows.push_back(std::move(cells));
+        }
+        return result;
+    }
+};
+
+// Summary of one score column; fields are NaN when nothing is graded
+struct ColumnStats {
+    size_t count = 0;
+    float mean = std::numeric_limits<float>::quiet_NaN();
+    float variance = std::numeric_limits<float>::quiet_NaN();
+    float min = std::numeric_limits<float>::quiet_NaN();
+    float max = std::numeric_limits<float>::quiet_NaN();
+    uint32_t histogram[10] = {}; // tenths of the maximum points; a full score lands in the top bin
+};
+
+// Statistics over a score column in which NaN marks "not graded". Sums, mins
+// and maxes run four lanes at a time with SSE2 where available (every x86-64
+// target), masking ungraded lanes out instead of branching on them; the
+// scalar loops finish the tail and cover other targets. Variance is computed
+// in a second pass around the mean, which stays accurate in float.
+inline ColumnStats ComputeColumnStats(const float* scores, size_t n, float maxPoints) {
+    ColumnStats stats;
+    float sum = 0, count = 0;
+    float low = std::numeric_limits<float>::infinity(), high = -low;
+    size_t i = 0;
+#if VCLASS_SSE2
+    __m128 sum4 = _mm_setzero_ps(), count4 = _mm_setzero_ps();
+    __m128 low4 = _mm_set1_ps(low), high4 = _mm_set1_ps(high), ones = _mm_set1_ps(1.0f);
+    for (; i + 4 <= n; i += 4) {
+        __m128 v = _mm_loadu_ps(scores + i);
+        __m128 graded = _mm_cmpord_ps(v, v);
+        sum4 = _mm_add_ps(sum4, _mm_and_ps(graded, v));
+        count4 = _mm_add_ps(count4, _mm_and_ps(graded, ones));
+        low4 = _mm_min_ps(low4, _mm_or_ps(_mm_and_ps(graded, v), _mm_andnot_ps(graded, low4)));
+        high4 = _mm_max_ps(high4, _mm_or_ps(_mm_and_ps(graded, v), _mm_andnot_ps(graded, high4)));
+    }
+    float lanes[4][4];
+    _mm_storeu_ps(lanes[0], sum4);
+    _mm_storeu_ps(lanes[1], count4);
+    _mm_storeu_ps(lanes[2], low4);
+    _mm_storeu_ps(lanes[3], high4);
+    for (int lane = 0; lane < 4; ++lane) {
+        sum += lanes[0][lane];
+        count += lanes[1][lane];
+        low = std::min(low, lanes[2][lane]);
+        high = std::max(high, lanes[3][lane]);
+    }
+#endif
+    for (; i < n; ++i) {
+        float v = scores[i];
+        if (v != v) continue;
+        sum += v;
+        count += 1;
+        low = std::min(low, v);
+        high = std::max(high, v);
+    }
+    if (count == 0) return stats;
+    stats.count = static_cast<size_t>(count);
+    stats.mean = sum / count;
+    stats.min = low;
+    stats.max = high;
+
+    float squares = 0;
+    i = 0;
+#if VCLASS_SSE2
+    __m128 squares4 = _mm_setzero_ps(), mean4 = _mm_set1_ps(stats.mean);
+    for (; i + 4 <= n; i += 4) {
+        __m128 v = _mm_loadu_ps(scores + i);
+        __m128 d = _mm_sub_ps(v, mean4);
+        squares4 = _mm_add_ps(squares4, _mm_and_ps(_mm_cmpord_ps(v, v), _mm_mul_ps(d, d)));
+    }
+    _mm_storeu_ps(lanes[0], squares4);
+    squares = lanes[0][0] + lanes[0][1] + lanes[0][2] + lanes[0][3];
+#endif
+    for (; i < n; ++i) {
+        float d = scores[i] - stats.mean;
+        if (d == d) squares += d * d;
+    }
+    stats.variance = squares / count;
+
+    // Bins are computed four at a time; ungraded scores go to an eleventh,
+    // discarded bin so the counting loop has no branch
+    const float binScale = maxPoints > 0 ? 10.0f / maxPoints : 0.0f;
+    uint32_t bins[11] = {};
+    i = 0;
+#if VCLASS_SSE2
+    int32_t lanesBin[4];
+    const __m128 scale4 = _mm_set1_ps(binScale), zero = _mm_setzero_ps(), nine = _mm_set1_ps(9.0f);
+    const __m128i discard = _mm_set1_epi32(10);
+    for (; i + 4 <= n; i += 4) {
+        __m128 v = _mm_loadu_ps(scores + i);
+        __m128 graded = _mm_cmpord_ps(v, v);
+        __m128i bin = _mm_cvttps_epi32(_mm_min_ps(nine, _mm_max_ps(zero, _mm_mul_ps(_mm_and_ps(graded, v), scale4))));
+        __m128i keep = _mm_castps_si128(graded);
+        bin = _mm_or_si128(_mm_and_si128(keep, bin), _mm_andnot_si128(keep, discard));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(lanesBin), bin);
+        ++bins[lanesBin[0]];
+        ++bins[lanesBin[1]];
+        ++bins[lanesBin[2]];
+        ++bins[lanesBin[3]];
+    }
+#endif
+    for (; i < n; ++i) {
+        float v = scores[i];
+        if (v != v) continue;
+        int bin = static_cast<int>(v * binScale);
+        ++bins[bin < 0 ? 0 : (bin > 9 ? 9 : bin)];
+    }
+    std::copy(bins, bins + 10, stats.histogram);
+    return stats;
+}
+
+enum class CurveKind { AddPoints, ScaleToMean, SquareRoot };
+
+// Curve a score column in place, clamped to [0, maxPoints]; ungraded scores
+// stay NaN. AddPoints adds param points, ScaleToMean scales so the current
+// mean becomes param, SquareRoot maps x to sqrt(x * maxPoints).
+inline void ApplyCurve(float* scores, size_t n, CurveKind kind, float param, float maxPoints, float currentMean) {
+    float scale = 1.0f, offset = 0.0f;
+    if (kind == CurveKind::AddPoints) offset = param;
+    if (kind == CurveKind::ScaleToMean) scale = currentMean > 0 ? param / currentMean : 1.0f;
+    size_t i = 0;
+#if VCLASS_SSE2
+    // min/max return their second operand when either is NaN, so the clamp
+    // bounds go first to let NaN pass through
+    const __m128 scale4 = _mm_set1_ps(scale), offset4 = _mm_set1_ps(offset);
+    const __m128 zero = _mm_setzero_ps(), top = _mm_set1_ps(maxPoints);
+    for (; i + 4 <= n; i += 4) {
+        __m128 v = _mm_loadu_ps(scores + i);
+        v = kind == CurveKind::SquareRoot ? _mm_sqrt_ps(_mm_mul_ps(_mm_max_ps(zero, v), top))
+                                          : _mm_add_ps(_mm_mul_ps(v, scale4), offset4);
+        _mm_storeu_ps(scores + i, _mm_min_ps(top, _mm_max_ps(zero, v)));
+    }
+#endif
+    for (; i < n; ++i) {
+        float v = scores[i];
+        if (v != v) continue;
+        v = kind == CurveKind::SquareRoot ? std::sqrt(std::max(0.0f, v) * maxPoints) : v * scale + offset;
+        scores[i] = std::min(maxPoints, std::max(0.0f, v));
+    }
+}
+
+// Shortest text that reads back as the same float
+inline std::string FormatFloat(float value) {
+    char buffer[32];
+    std::snprintf(buffer, sizeof(buffer), "%.9g", value);
+    return buffer;
+}
+
+// KLL quantile sketch (Karnin, Lang & Liberty). Values sit in a stack of
+// compactors; an item at level h stands for 2^h inputs. When a level fills
+// up it is sorted and every other item (from a random start) is promoted,
+// halving its size. Capacities shrink geometrically below the top level, so
+// the sketch keeps O(k log(n / k)) values, rank error is about 1.7 / k, and
+// two sketches merge by concatenating levels and compacting again. Small
+// inputs (fewer than k values) are kept exactly.
+class KllSketch {
+public:
+    explicit KllSketch(uint32_t k = 200) : k(k), levels(1) {}
+
+    void Update(float value) {
+        if (value != value) return;
+        levels[0].push_back(value);
+        ++count;
+        min = std::min(min, value);
+        max = std::max(max, value);
+        Compress();
+    }
+
+    void Merge(const KllSketch& other) {
+        if (other.count == 0) return;
+        if (levels.size() < other.levels.size()) levels.resize(other.levels.size());
+        for (size_t h = 0; h < other.levels.size(); ++h) {
+            levels[h].insert(levels[h].end(), other.levels[h].begin(), other.levels[h].end());
+        }
+        count += other.count;
+        min = std::min(min, other.min);
+        max = std::max(max, other.max);
+        Compress();
+    }
+
+    // Value at rank q (0 = min, 1 = max); NaN if empty
+    float Quantile(double q) const {
+        if (count == 0) return std::numeric_limits<float>::quiet_NaN();
+        if (q <= 0) return min;
+        if (q >= 1) return max;
+        std::vector<std::pair<float, uint64_t>> weighted;
+        for (size_t h = 0; h < levels.size(); ++h) {
+            for (float value : levels[h]) weighted.emplace_back(value, uint64_t(1) << h);
+        }
+        std::sort(weighted.begin(), weighted.end());
+        uint64_t total = 0;
+        for (const auto& item : weighted) total += item.second;
+        const double target = q * total;
+        uint64_t seen = 0;
+        for (const auto& item : weighted) {
+            seen += item.second;
+            if (seen >= target) return item.first;
+        }
+        return max;
+    }
+
+    uint64_t Count() const { return count; }
+    size_t Retained() const {
+        size_t retained = 0;
+        for (const auto& level : levels) retained += level.size();
+        return retained;
+    }
+
+private:
+    uint32_t k;
+    std::vector<std::vector<float>> levels;
+    uint64_t count = 0;
+    float min = std::numeric_limits<float>::infinity();
+    float max = -std::numeric_limits<float>::infinity();
+    uint64_t coin = 0x2545F4914F6CDD1Dull; // xorshift state for the promotion offset
+
+    // Level h holds about k * (2/3)^(depth - 1 - h) items, never fewer than 2
+    size_t Capacity(size_t level) const {
+        double capacity = k * std::pow(2.0 / 3.0, static_cast<double>(levels.size() - 1 - level));
+        return std::max<size_t>(2, static_cast<size_t>(std::ceil(capacity)));
+    }
+
+    void Compress() {
+        for (size_t h = 0; h < levels.size(); ++h) {
+            if (levels[h].size() <= Capacity(h)) continue;
+            if (h + 1 == levels.size()) levels.emplace_back();
+            std::vector<float>& level = levels[h];
+            std::sort(level.begin(), level.end());
+            // With an odd count the smallest item stays behind at this level
+            size_t keep = level.size() % 2;
+            coin ^= coin << 13;
+            coin ^= coin >> 7;
+            coin ^= coin << 17;
+            for (size_t i = keep + (coin & 1); i < level.size(); i += 2) levels[h + 1].push_back(level[i]);
+            level.resize(keep);
+        }
+    }
+};
+
+// Split a line on tabs, keeping empty fields
+inline std::vector<std::string> SplitFields(const std::string& line) {
+    std::vector<std::string> fields;
+    size_t start = 0;
+    for (size_t tab; (tab = line.find('\t', start)) != std::string::npos; start = tab + 1) {
+        fields.push_back(line.substr(start, tab - start));
+    }
+    fields.push_back(line.substr(start));
+    return fields;
+}
+
+// Per-class gradebook. Each class keeps its members (enrolled student IDs) in
+// row order and, per assessment, a contiguous float column of scores in the
+// same order, so per-assessment statistics stream over one small array.
+// NaN means "not graded". Mutations take the unique lock; use Read() to hold
+// the shared lock across a multi-step read.
+//
+// Every assessment and every class also carries a KLL sketch of its scores
+// as percentages of the maximum, so percentiles over many classes come from
+// merging small sketches. A new score is added to both; overwriting or
+// curving scores rebuilds the assessment's sketch from its column and the
+// class sketch from its assessments, since sketches cannot forget values.
+class Gradebook {
+public:
+    struct Assessment {
+        std::string name;
+        float maxPoints = 100;
+        std::vector<float> scores; // by member row
+        KllSketch sketch;          // percentages
+    };
+
+    struct ClassBook {
+        std::vector<uint32_t> members; // student ID per row
+        std::unordered_map<uint32_t, uint32_t> rowOf;
+        std::vector<Assessment> assessments;
+        KllSketch sketch;              // every score in the class, as percentages
+
+        int FindAssessment(const std::string& name) const {
+            for (size_t a = 0; a < assessments.size(); ++a) {
+                if (assessments[a].name == name) return static_cast<int>(a);
+            }
+            return -1;
+        }
+    };
+
+    template <typename F>
+    auto Read(F fn) const -> decltype(fn(*this)) {
+        std::shared_lock<std::shared_mutex> lock(mutex);
+        return fn(*this);
+    }
+
+    // Give a student a row in a class's columns; no-op if already a member
+    void AddMember(uint32_t classId, uint32_t studentId) {
+        std::unique_lock<std::shared_mutex> lock(mutex);
+        RowFor(Book(classId), studentId);
+    }
+
+    // New assessment; returns its index, or -1 if the class already has one by that name
+    int AddAssessment(uint32_t classId, const std::string& name, float maxPoints) {
+        std::unique_lock<std::shared_mutex> lock(mutex);
+        ClassBook& book = Book(classId);
+        if (book.FindAssessment(name) >= 0) return -1;
+        book.assessments.push_back({name, maxPoints, std::vector<float>(book.members.size(), kUngraded), KllSketch()});
+        return static_cast<int>(book.assessments.size() - 1);
+    }
+
+    // Store a score (NaN clears it) and report the one it replaced
+    bool SetScore(uint32_t classId, const std::string& assessment, uint32_t studentId, float score, float& previous) {
+        std::unique_lock<std::shared_mutex> lock(mutex);
+        ClassBook& book = Book(classId);
+        int a = book.FindAssessment(assessment);
+        if (a < 0) return false;
+        Assessment& column = book.assessments[a];
+        float& slot = column.scores[RowFor(book, studentId)];
+        previous = slot;
+        slot = score;
+        if (std::isnan(previous)) {
+            float percent = score * 100.0f / column.maxPoints;
+            column.sketch.Update(percent);
+            book.sketch.Update(percent);
+        } else if (!(previous == score)) {
+            RebuildSketches(book, column);
+        }
+        return true;
+    }
+
+    // An assessment's column around a curve, by member row
+    struct CurveChange {
+        std::vector<uint32_t> members;
+        std::vector<float> before, after;
+        float maxPoints = 0;
+    };
+
+    bool Curve(uint32_t classId, const std::string& assessment, CurveKind kind, float param, CurveChange& change) {
+        std::unique_lock<std::shared_mutex> lock(mutex);
+        ClassBook& book = Book(classId);
+        int a = book.FindAssessment(assessment);
+        if (a < 0) return false;
+        Assessment& column = book.assessments[a];
+        change.members = book.members;
+        change.before = column.scores;
+        change.maxPoints = column.maxPoints;
+        float mean = ComputeColumnStats(column.scores.data(), column.scores.size(), column.maxPoints).mean;
+        ApplyCurve(column.scores.data(), column.scores.size(), kind, param, column.maxPoints, mean);
+        change.after = column.scores;
+        RebuildSketches(book, column);
+        return true;
+    }
+
+    // Maximum points of an assessment; false if the class has no such assessment
+    bool MaxPoints(uint32_t classId, const std::string& assessment, float& maxPoints) const {
+        std::shared_lock<std::shared_mutex> lock(mutex);
+        if (classId >= books.size()) return false;
+        int a = books[classId].FindAssessment(assessment);
+        if (a < 0) return false;
+        maxPoints = books[classId].assessments[a].maxPoints;
+        return true;
+    }
+
+    bool IsMember(uint32_t classId, uint32_t studentId) const {
+        std::shared_lock<std::shared_mutex> lock(mutex);
+        return classId < books.size() && books[classId].rowOf.count(studentId) > 0;
+    }
+
+    // Take a student's row out of a class's columns, later rows moving up.
+    // Returns the (score, maxPoints) of each grade they held.
+    std::vector<std::pair<float, float>> RemoveMember(uint32_t classId, uint32_t studentId) {
+        std::unique_lock<std::shared_mutex> lock(mutex);
+        std::vector<std::pair<float, float>> removed;
+        if (classId >= books.size()) return removed;
+        ClassBook& book = books[classId];
+        auto found = book.rowOf.find(studentId);
+        if (found == book.rowOf.end()) return removed;
+        uint32_t row = found->second;
+        book.members.erase(book.members.begin() + row);
+        book.rowOf.erase(found);
+        for (uint32_t r = row; r < book.members.size(); ++r) book.rowOf[book.members[r]] = r;
+        for (auto& column : book.assessments) {
+            float score = column.scores[row];
+            column.scores.erase(column.scores.begin() + row);
+            if (std::isnan(score)) continue;
+            removed.emplace_back(score, column.maxPoints);
+            RebuildSketches(book, column);
+        }
+        return removed;
+    }
+
+    // Unlocked accessors, for use inside Read()
+    size_t Classes() const { return books.size(); }
+    const ClassBook* Class(uint32_t classId) const { return classId < books.size() ? &books[classId] : nullptr; }
+
+    static constexpr float kUngraded = std::numeric_limits<float>::quiet_NaN();
+
+private:
+    mutable std::shared_mutex mutex;
+    std::vector<ClassBook> books; // by class ID
+
+    ClassBook& Book(uint32_t classId) {
+        if (classId >= books.size()) books.resize(classId + 1);
+        return books[classId];
+    }
+
+    static void RebuildSketches(ClassBook& book, Assessment& changed) {
+        changed.sketch = KllSketch();
+        for (float score : changed.scores) changed.sketch.Update(score * 100.0f / changed.maxPoints);
+        book.sketch = KllSketch();
+        for (const auto& assessment : book.assessments) book.sketch.Merge(assessment.sketch);
+    }
+
+    uint32_t RowFor(ClassBook& book, uint32_t studentId) {
+        auto found = book.rowOf.find(studentId);
+        if (found != book.rowOf.end()) return found->second;
+        uint32_t row = static_cast<uint32_t>(book.members.size());
+        book.members.push_back(studentId);
+        book.rowOf.emplace(studentId, row);
+        for (auto& column : book.assessments) column.scores.push_back(kUngraded);
+        return row;
+    }
+};
+
+// Attendance per class. Sessions are kept in the order they were held, each
+// as a bitmap over the class's member rows (bit set = present). Rows are
+// appended in enrollment order and a session remembers how many members the
+// class had, so a student is only counted for sessions held after they
+// enrolled. A year of daily sessions costs about 23 bytes per student per
+// class.
+//
+// Analytics work a word (64 students or 64 sessions) at a time: rates are
+// popcounts, streaks and runs jump between set and clear bits with
+// count-trailing-zeros, and "absent at least N times" keeps a bit-sliced
+// counter per student so one pass over the sessions counts 64 students per
+// operation. Mutations take the unique lock; use Read() for a multi-step read.
+class AttendanceBook {
+public:
+    struct Session {
+        int32_t day = 0;                // days since 1970-01-01
+        uint32_t members = 0;           // rows eligible for this session
+        std::vector<uint64_t> present;  // by row
+    };
+
+    struct ClassSessions {
+        std::vector<uint32_t> members;  // student ID per row
+        std::unordered_map<uint32_t, uint32_t> rowOf;
+        std::vector<Session> sessions;
+    };
+
+    struct StudentSummary {
+        uint32_t sessions = 0;          // sessions held since the student enrolled
+        uint32_t attended = 0;
+        uint32_t currentStreak = 0;     // consecutive sessions attended, up to the latest
+        uint32_t longestAbsence = 0;    // longest run of consecutive missed sessions
+    };
+
+    template <typename F>
+    auto Read(F fn) const -> decltype(fn(*this)) {
+        std::shared_lock<std::shared_mutex> lock(mutex);
+        return fn(*this);
+    }
+
+    void AddMember(uint32_t classId, uint32_t studentId) {
+        std::unique_lock<std::shared_mutex> lock(mutex);
+        ClassSessions& book = Book(classId);
+        if (book.rowOf.emplace(studentId, static_cast<uint32_t>(book.members.size())).second) {
+            book.members.push_back(studentId);
+        }
+    }
+
+    // Start a session with every current member absent; returns its index
+    uint32_t AddSession(uint32_t classId, int32_t day) {
+        std::unique_lock<std::shared_mutex> lock(mutex);
+        ClassSessions& book = Book(classId);
+        Session session;
+        session.day = day;
+        session.members = static_cast<uint32_t>(book.members.size());
+        session.present.assign((session.members + 63) / 64, 0);
+        book.sessions.push_back(std::move(session));
+        return static_cast<uint32_t>(book.sessions.size() - 1);
+    }
+
+    // Install a session at a known index (replaying a saved roster). A session
+    // already at that index is overwritten, so replaying it twice is harmless.
+    void RestoreSession(uint32_t classId, uint32_t index, int32_t day, uint32_t members,
+                        const std::vector<uint64_t>& present) {
+        std::unique_lock<std::shared_mutex> lock(mutex);
+        ClassSessions& book = Book(classId);
+        if (index > book.sessions.size()) return;
+        if (index == book.sessions.size()) book.sessions.emplace_back();
+        Session& session = book.sessions[index];
+        session.day = day;
+        session.members = members;
+        session.present = present;
+        session.present.resize((members + 63) / 64, 0);
+        if (members % 64 && !session.present.empty()) session.present.back() &= (uint64_t(1) << (members % 64)) - 1;
+    }
+
+    // Latest session held on day, or -1
+    int FindSession(uint32_t classId, int32_t day) const {
+        std::shared_lock<std::shared_mutex> lock(mutex);
+        if (classId >= books.size()) return -1;
+        const auto& sessions = books[classId].sessions;
+        for (size_t s = sessions.size(); s-- > 0;) {
+            if (sessions[s].day == day) return static_cast<int>(s);
+        }
+        return -1;
+    }
+
+    // Mark a student present or absent. Returns the previous mark (0 or 1),
+    // or -1 if the session does not exist or predates the student's enrollment.
+    int SetPresent(uint32_t classId, uint32_t session, uint32_t studentId, bool present) {
+        std::unique_lock<std::shared_mutex> lock(mutex);
+        return SetPresentLocked(classId, session, studentId, present);
+    }
+
+    // Take a student's row out of a class: their bit leaves every session
+    // they were eligible for and later rows move down one. present and
+    // recorded receive the marks removed, for the class totals.
+    void RemoveMember(uint32_t classId, uint32_t studentId, int64_t& present, int64_t& recorded) {
+        std::unique_lock<std::shared_mutex> lock(mutex);
+        present = recorded = 0;
+        if (classId >= books.size()) return;
+        ClassSessions& book = books[classId];
+        auto found = book.rowOf.find(studentId);
+        if (found == book.rowOf.end()) return;
+        const uint32_t row = found->second;
+        book.members.erase(book.members.begin() + row);
+        book.rowOf.erase(found);
+        for (uint32_t r = row; r < book.members.size(); ++r) book.rowOf[book.members[r]] = r;
+        for (Session& session : book.sessions) {
+            if (session.members <= row) continue;
+            std::vector<uint64_t>& bits = session.present;
+            size_t w = row / 64;
+            uint64_t below = (uint64_t(1) << (row % 64)) - 1;
+            present += (bits[w] >> (row % 64)) & 1;
+            ++recorded;
+            // Shift everything above the row down one bit, carrying across words
+            bits[w] = (bits[w] & below) | ((bits[w] >> 1) & ~below);
+            for (size_t i = w + 1; i < bits.size(); ++i) {
+                bits[i - 1] |= bits[i] << 63;
+                bits[i] >>= 1;
+            }
+            --session.members;
+            bits.resize((session.members + 63) / 64);
+        }
+    }
+
+    // Mark many students present at one session under a single lock; previous
+    // receives each one's earlier mark as SetPresent would return it
+    void MarkPresent(uint32_t classId, uint32_t session, const std::vector<uint32_t>& studentIds, std::vector<int>& previous) {
+        std::unique_lock<std::shared_mutex> lock(mutex);
+        previous.resize(studentIds.size());
+        for (size_t i = 0; i < studentIds.size(); ++i) previous[i] = SetPresentLocked(classId, session, studentIds[i], true);
+    }
+
+    // Unlocked accessors and analytics, for use inside Read()
+    size_t Classes() const { return books.size(); }
+    const ClassSessions* Class(uint32_t classId) const { return classId < books.size() ? &books[classId] : nullptr; }
+
+    static uint32_t Attended(const Session& session) {
+        uint32_t total = 0;
+        for (uint64_t word : session.present) total += static_cast<uint32_t>(PackedColumn::PopCount(word));
+        return total;
+    }
+
+    StudentSummary Summarize(uint32_t classId, uint32_t studentId) const {
+        StudentSummary summary;
+        const ClassSessions* book = Class(classId);
+        if (!book) return summary;
+        auto found = book->rowOf.find(studentId);
+        if (found == book->rowOf.end()) return summary;
+        const uint32_t row = found->second;
+
+        // Member counts only grow, so the sessions a row is eligible for are a suffix
+        auto first = std::upper_bound(book->sessions.begin(), book->sessions.end(), row,
+                                      [](uint32_t r, const Session& s) { return r < s.members; });
+        // Gather the row's marks into its own bitset, one bit per eligible session
+        std::vector<uint64_t> marks;
+        uint32_t n = 0;
+        for (auto s = first; s != book->sessions.end(); ++s, ++n) {
+            if (n % 64 == 0) marks.push_back(0);
+            marks.back() |= ((s->present[row / 64] >> (row % 64)) & 1) << (n % 64);
+        }
+        summary.sessions = n;
+        for (uint64_t word : marks) summary.attended += static_cast<uint32_t>(PackedColumn::PopCount(word));
+        if (n == 0) return summary;
+
+        // Current streak: the run of set bits ending at bit n - 1
+        uint32_t end = n;
+        summary.currentStreak = end - FindPrevious(marks, end, false);
+        // Longest absence: hop run to run, clear bits being absences
+        for (uint32_t pos = 0; pos < n;) {
+            uint32_t absentFrom = FindNext(marks, pos, n, false);
+            if (absentFrom >= n) break;
+            uint32_t absentTo = FindNext(marks, absentFrom, n, true);
+            summary.longestAbsence = std::max(summary.longestAbsence, absentTo - absentFrom);
+            pos = absentTo;
+        }
+        return summary;
+    }
+
+    // Students who missed at least minAbsences of the class's sessions held in
+    // [fromDay, toDay]
+    std::vector<uint32_t> FrequentAbsentees(uint32_t classId, int32_t fromDay, int32_t toDay, uint32_t minAbsences) const {
+        std::vector<uint32_t> students;
+        const ClassSessions* book = Class(classId);
+        if (!book || minAbsences == 0) return students;
+        const size_t words = (book->members.size() + 63) / 64;
+        // Bit-sliced saturating counters: slice b holds bit b of each row's count
+        unsigned slices = 1;
+        while ((1u << slices) <= minAbsences) ++slices;
+        std::vector<uint64_t> counter(words * slices, 0), reached(words, 0);
+        for (const Session& session : book->sessions) {
+            if (session.day < fromDay || session.day > toDay) continue;
+            for (size_t w = 0; w < session.present.size(); ++w) {
+                uint64_t eligible = (w + 1) * 64 <= session.members ? ~uint64_t(0)
+                                  : (uint64_t(1) << (session.members % 64)) - 1;
+                uint64_t carry = ~session.present[w] & eligible;
+                for (unsigned b = 0; b < slices && carry; ++b) {
+                    uint64_t& slice = counter[w * slices + b];
+                    uint64_t next = slice & carry;
+                    slice ^= carry;
+                    carry = next;
+                }
+                reached[w] |= carry; // overflowed every slice: well past the threshold
+            }
+        }
+        for (size_t w = 0; w < words; ++w) {
+            // Compare each row's count with minAbsences, 64 rows at a time, from the top bit down
+            uint64_t greater = reached[w], equal = ~reached[w];
+            for (unsigned b = slices; b-- > 0;) {
+                uint64_t slice = counter[w * slices + b];
+                uint64_t want = ((minAbsences >> b) & 1) ? ~uint64_t(0) : 0;
+                greater |= equal & slice & ~want;
+                equal &= ~(slice ^ want);
+            }
+            for (uint64_t hits = greater | equal; hits; hits &= hits - 1) {
+                size_t row = w * 64 + PackedColumn::CountTrailingZeros(hits);
+                if (row < book->members.size()) students.push_back(book->members[row]);
+            }
+        }
+        return students;
+    }
+
+    // A session bitmap as hex, four rows to a digit (row 0 is the low bit of
+    // the first digit), and back; bits past members are dropped
+    static std::string EncodeBitmap(const std::vector<uint64_t>& words, uint32_t members) {
+        static const char digits[] = "0123456789abcdef";
+        std::string hex((members + 3) / 4, '0');
+        for (size_t d = 0; d < hex.size(); ++d) hex[d] = digits[(words[d / 16] >> (d % 16 * 4)) & 0xF];
+        return hex;
+    }
+    static std::vector<uint64_t> DecodeBitmap(const std::string& hex, uint32_t members) {
+        std::vector<uint64_t> words((members + 63) / 64, 0);
+        size_t digits = std::min(hex.size(), static_cast<size_t>((members + 3) / 4));
+        for (size_t d = 0; d < digits; ++d) {
+            char c = static_cast<char>(std::tolower(static_cast<unsigned char>(hex[d])));
+            uint64_t nibble = std::isdigit(static_cast<unsigned char>(c)) ? c - '0' : (c >= 'a' && c <= 'f') ? c - 'a' + 10 : 0;
+            words[d / 16] |= nibble << (d % 16 * 4);
+        }
+        return words;
+    }
+
+    // Bytes held by session bitmaps
+    size_t MemoryBytes() const {
+        size_t bytes = 0;
+        for (const auto& book : books) {
+            for (const auto& session : book.sessions) bytes += session.present.capacity() * sizeof(uint64_t);
+        }
+        return bytes;
+    }
+
+private:
+    mutable std::shared_mutex mutex;
+    std::vector<ClassSessions> books; // by class ID
+
+    ClassSessions& Book(uint32_t classId) {
+        if (classId >= books.size()) books.resize(classId + 1);
+        return books[classId];
+    }
+
+    int SetPresentLocked(uint32_t classId, uint32_t session, uint32_t studentId, bool present) {
+        if (classId >= books.size() || session >= books[classId].sessions.size()) return -1;
+        ClassSessions& book = books[classId];
+        auto row = book.rowOf.find(studentId);
+        Session& target = book.sessions[session];
+        if (row == book.rowOf.end() || row->second >= target.members) return -1;
+        uint64_t& word = target.present[row->second / 64];
+        uint64_t bit = uint64_t(1) << (row->second % 64);
+        int previous = (word & bit) ? 1 : 0;
+        word = present ? (word | bit) : (word & ~bit);
+        return previous;
+    }
+
+    // First index in [pos, n) whose bit equals value, or n
+    static uint32_t FindNext(const std::vector<uint64_t>& bits, uint32_t pos, uint32_t n, bool value) {
+        while (pos < n) {
+            uint64_t word = bits[pos / 64];
+            if (!value) word = ~word;
+            word &= ~uint64_t(0) << (pos % 64);
+            if (word) return std::min(n, static_cast<uint32_t>((pos / 64) * 64 + PackedColumn::CountTrailingZeros(word)));
+            pos = (pos / 64 + 1) * 64;
+        }
+        return n;
+    }
+
+    // One past the last index below end whose bit equals value, or 0
+    static uint32_t FindPrevious(const std::vector<uint64_t>& bits, uint32_t end, bool value) {
+        while (end > 0) {
+            uint32_t w = (end - 1) / 64;
+            uint64_t word = bits[w];
+            if (!value) word = ~word;
+            unsigned used = end - w * 64; // bits of this word below end
+            if (used < 64) word &= (uint64_t(1) << used) - 1;
+            if (word) return w * 64 + 64 - static_cast<uint32_t>(CountLeadingZeros(word));
+            end = w * 64;
+        }
+        return 0;
+    }
+
+    static int CountLeadingZeros(uint64_t x) {
+#if defined(__GNUC__) || defined(__clang__)
+        return __builtin_clzll(x);
+#else
+        int n = 0;
+        for (uint64_t bit = uint64_t(1) << 63; !(x & bit); bit >>= 1) ++n;
+        return n;
+#endif
+    }
+};
+
+// A weekly class meeting as minutes since Monday 00:00, [start, end)
+struct Meeting {
+    int start = 0;
+    int end = 0;
+};
+
+inline const char* const kWeekdays[] = {"Mon", "Tue", "Wed", "Thu", "Fri", "Sat", "Sun"};
+
+// "Mon 09:00-10:30, Wed 09:00-10:30"
+inline std::string FormatMeetings(const std::vector<Meeting>& meetings) {
+    std::string text;
+    char buffer[32];
+    for (const Meeting& meeting : meetings) {
+        int day = meeting.start / 1440, from = meeting.start % 1440, to = meeting.end - day * 1440;
+        std::snprintf(buffer, sizeof(buffer), "%s %02d:%02d-%02d:%02d", kWeekdays[day], from / 60, from % 60, to / 60, to % 60);
+        if (!text.empty()) text += ", ";
+        text += buffer;
+    }
+    return text;
+}
+
+// Do two of a class's meetings overlap? when is the later of the first pair
+inline bool MeetingsOverlap(std::vector<Meeting> meetings, Meeting& when) {
+    std::sort(meetings.begin(), meetings.end(), [](const Meeting& a, const Meeting& b) { return a.start < b.start; });
+    for (size_t i = 1; i < meetings.size(); ++i) {
+        if (meetings[i].start < meetings[i - 1].end) {
+            when = meetings[i];
+            return true;
+        }
+    }
+    return false;
+}
+
+// Parse comma-separated "Day HH:MM-HH:MM" meetings, sorted by start; false
+// if one is malformed or two overlap
+inline bool ParseMeetings(const std::string& text, std::vector<Meeting>& meetings) {
+    meetings.clear();
+    std::stringstream list(text);
+    std::string item;
+    while (std::getline(list, item, ',')) {
+        if (item.find_first_not_of(" \t") == std::string::npos) continue;
+        char day[8] = {};
+        unsigned h1, m1, h2, m2;
+        int used = 0;
+        if (std::sscanf(item.c_str(), " %7s %u:%u-%u:%u %n", day, &h1, &m1, &h2, &m2, &used) != 5
+            || item[used] != '\0' || h1 > 23 || h2 > 24 || m1 > 59 || m2 > 59) {
+            return false;
+        }
+        int weekday = -1;
+        for (int d = 0; d < 7; ++d) {
+            if (std::equal(day, day + 3, kWeekdays[d], [](char a, char b) { return std::tolower(a) == std::tolower(b); })) weekday = d;
+        }
+        int from = static_cast<int>(h1 * 60 + m1), to = static_cast<int>(h2 * 60 + m2);
+        if (weekday < 0 || from >= to || to > 1440) return false;
+        meetings.push_back({weekday * 1440 + from, weekday * 1440 + to});
+    }
+    std::sort(meetings.begin(), meetings.end(), [](const Meeting& a, const Meeting& b) { return a.start < b.start; });
+    Meeting when;
+    return !MeetingsOverlap(meetings, when);
+}
+
+// When and where a class meets, and who teaches it
+struct ClassSchedule {
+    std::string teacher;
+    std::string room;
+    std::vector<Meeting> meetings;
+
+    // "teacher<TAB>room<TAB>meetings"
+    std::string Encode() const { return teacher + '\t' + room + '\t' + FormatMeetings(meetings); }
+    bool Decode(const std::string& text) {
+        std::vector<std::string> fields = SplitFields(text);
+        if (fields.size() != 3 || !ParseMeetings(fields[2], meetings)) return false;
+        teacher = fields[0];
+        room = fields[1];
+        return true;
+    }
+};
+
+// Class schedules by class ID, plus the rooms and teacher hours a timetable
+// solver may plan with. Mutations take the unique lock; use Read() for a
+// multi-step read.
+class ScheduleBook {
+public:
+    template <typename F>
+    auto Read(F fn) const -> decltype(fn(*this)) {
+        std::shared_lock<std::shared_mutex> lock(mutex);
+        return fn(*this);
+    }
+
+    void Set(uint32_t classId, const ClassSchedule& schedule) {
+        std::unique_lock<std::shared_mutex> lock(mutex);
+        if (classId >= schedules.size()) schedules.resize(classId + 1);
+        schedules[classId] = schedule;
+    }
+
+    ClassSchedule Get(uint32_t classId) const {
+        std::shared_lock<std::shared_mutex> lock(mutex);
+        return classId < schedules.size() ? schedules[classId] : ClassSchedule();
+    }
+
+    // Seats in a room; 0 removes it
+    void SetRoom(const std::string& room, uint32_t seats) {
+        std::unique_lock<std::shared_mutex> lock(mutex);
+        if (seats == 0) rooms.erase(room);
+        else rooms[room] = seats;
+    }
+
+    // Weekly hours a teacher can teach; none means any time
+    void SetAvailability(const std::string& teacher, const std::vector<Meeting>& hours) {
+        std::unique_lock<std::shared_mutex> lock(mutex);
+        if (hours.empty()) availability.erase(teacher);
+        else availability[teacher] = hours;
+    }
+
+    // Unlocked accessors, for use inside Read()
+    size_t Classes() const { return schedules.size(); }
+    const ClassSchedule* Class(uint32_t classId) const { return classId < schedules.size() ? &schedules[classId] : nullptr; }
+    const std::map<std::string, uint32_t>& Rooms() const { return rooms; }
+    const std::map<std::string, std::vector<Meeting>>& Availability() const { return availability; }
+
+private:
+    mutable std::shared_mutex mutex;
+    std::vector<ClassSchedule> schedules;
+    std::map<std::string, uint32_t> rooms;                       // seats by name
+    std::map<std::string, std::vector<Meeting>> availability;    // by teacher
+};
+
+// Seats and FIFO waitlists per class; capacity 0 means unlimited. A seat is
+// claimed with a compare-and-swap on the class's taken count, so students
+// enrolling into classes with room never queue here. Once a class is full,
+// students join its waitlist under the class's own mutex. A freed seat is
+// handed straight to the head of the waitlist (HandOff) and only goes back
+// to the pool when nobody is waiting, so while anyone waits the class stays
+// full and a latecomer cannot take a seat ahead of them.
+class SeatBook {
+public:
+    enum class JoinResult { Reserved, Waitlisted, AlreadyWaitlisted };
+
+    struct Seats {
+        uint32_t capacity = 0;
+        uint32_t taken = 0;
+        size_t waiting = 0;
+    };
+
+    void EnsureClasses(size_t count) {
+        std::unique_lock<std::shared_mutex> lock(mutex);
+        while (slots.size() < count) slots.emplace_back(new Slot());
+    }
+
+    // Claim a free seat; false if the class is full
+    bool TryReserve(uint32_t classId) {
+        std::shared_lock<std::shared_mutex> lock(mutex);
+        return classId < slots.size() && Reserve(*slots[classId]);
+    }
+
+    // Count a seat taken without a reservation (an enrollment loaded from disk)
+    void AddTaken(uint32_t classId) {
+        std::shared_lock<std::shared_mutex> lock(mutex);
+        if (classId < slots.size()) slots[classId]->taken.fetch_add(1);
+    }
+
+    // Claim a seat that came free since TryReserve failed, or join the end of
+    // the waitlist. onJoin runs under the class's mutex, so joins are
+    // recorded in queue order.
+    template <typename F>
+    JoinResult Join(uint32_t classId, uint32_t studentId, F onJoin) {
+        std::shared_lock<std::shared_mutex> lock(mutex);
+        Slot& slot = *slots.at(classId);
+        std::lock_guard<std::mutex> queueLock(slot.queueMutex);
+        if (std::find(slot.waitlist.begin(), slot.waitlist.end(), studentId) != slot.waitlist.end()) {
+            return JoinResult::AlreadyWaitlisted;
+        }
+        if (Reserve(slot)) return JoinResult::Reserved;
+        slot.waitlist.push_back(studentId);
+        onJoin();
+        return JoinResult::Waitlisted;
+    }
+
+    // Pass a freed seat to the head of the waitlist (true, with studentId) or
+    // return it to the pool if nobody waits or the class is over a lowered
+    // capacity. onHandOff(studentId) runs under the class's mutex.
+    template <typename F>
+    bool HandOff(uint32_t classId, uint32_t& studentId, F onHandOff) {
+        std::shared_lock<std::shared_mutex> lock(mutex);
+        Slot& slot = *slots.at(classId);
+        std::lock_guard<std::mutex> queueLock(slot.queueMutex);
+        uint32_t capacity = slot.capacity.load();
+        if (slot.waitlist.empty() || (capacity != 0 && slot.taken.load() > capacity)) {
+            slot.taken.fetch_sub(1);
+            return false;
+        }
+        studentId = slot.waitlist.front();
+        slot.waitlist.pop_front();
+        onHandOff(studentId);
+        return true;
+    }
+
+    // Leave the waitlist; false if not on it. onLeave runs under the class's mutex.
+    template <typename F>
+    bool Leave(uint32_t classId, uint32_t studentId, F onLeave) {
+        std::shared_lock<std::shared_mutex> lock(mutex);
+        if (classId >= slots.size()) return false;
+        Slot& slot = *slots[classId];
+        std::lock_guard<std::mutex> queueLock(slot.queueMutex);
+        auto found = std::find(slot.waitlist.begin(), slot.waitlist.end(), studentId);
+        if (found == slot.waitlist.end()) return false;
+        slot.waitlist.erase(found);
+        onLeave();
+        return true;
+    }
+
+    // Change a class's capacity. Seats it opens go to the head of the
+    // waitlist first: they are counted as taken before the new capacity is
+    // published, so TryReserve cannot reach them. Returns the students given
+    // seats, in queue order; onHandOff(studentId) runs for each under the
+    // class's mutex.
+    template <typename F>
+    std::vector<uint32_t> SetCapacity(uint32_t classId, uint32_t capacity, F onHandOff) {
+        std::shared_lock<std::shared_mutex> lock(mutex);
+        Slot& slot = *slots.at(classId);
+        std::lock_guard<std::mutex> queueLock(slot.queueMutex);
+        // Anyone waiting means the class is full, and TryReserve fails on a
+        // full class, so taken holds still until the capacity changes
+        size_t open = slot.waitlist.size();
+        if (capacity != 0) open = std::min<size_t>(open, capacity > slot.taken.load() ? capacity - slot.taken.load() : 0);
+        slot.taken.fetch_add(static_cast<uint32_t>(open));
+        slot.capacity.store(capacity);
+        std::vector<uint32_t> seated(slot.waitlist.begin(), slot.waitlist.begin() + open);
+        slot.waitlist.erase(slot.waitlist.begin(), slot.waitlist.begin() + open);
+        for (uint32_t studentId : seated) onHandOff(studentId);
+        return seated;
+    }
+
+    // Put back a saved capacity or waitlist entry, without handing out seats
+    void RestoreCapacity(uint32_t classId, uint32_t capacity) {
+        EnsureClasses(classId + 1);
+        std::shared_lock<std::shared_mutex> lock(mutex);
+        slots[classId]->capacity.store(capacity);
+    }
+    void RestoreWaiting(uint32_t classId, uint32_t studentId) {
+        EnsureClasses(classId + 1);
+        std::shared_lock<std::shared_mutex> lock(mutex);
+        Slot& slot = *slots[classId];
+        std::lock_guard<std::mutex> queueLock(slot.queueMutex);
+        if (std::find(slot.waitlist.begin(), slot.waitlist.end(), studentId) == slot.waitlist.end()) slot.waitlist.push_back(studentId);
+    }
+
+    Seats Get(uint32_t classId) const {
+        Seats seats;
+        std::shared_lock<std::shared_mutex> lock(mutex);
+        if (classId >= slots.size()) return seats;
+        Slot& slot = *slots[classId];
+        std::lock_guard<std::mutex> queueLock(slot.queueMutex);
+        seats.capacity = slot.capacity.load();
+        seats.taken = slot.taken.load();
+        seats.waiting = slot.waitlist.size();
+        return seats;
+    }
+
+    // Students waiting for a class, first in line first
+    std::vector<uint32_t> Waitlist(uint32_t classId) const {
+        std::shared_lock<std::shared_mutex> lock(mutex);
+        if (classId >= slots.size()) return {};
+        Slot& slot = *slots[classId];
+        std::lock_guard<std::mutex> queueLock(slot.queueMutex);
+        return std::vector<uint32_t>(slot.waitlist.begin(), slot.waitlist.end());
+    }
+
+    size_t Classes() const {
+        std::shared_lock<std::shared_mutex> lock(mutex);
+        return slots.size();
+    }
+
+private:
+    struct Slot {
+        std::atomic<uint32_t> capacity{0};
+        std::atomic<uint32_t> taken{0};
+        std::mutex queueMutex;
+        std::deque<uint32_t> waitlist;
+    };
+
+    mutable std::shared_mutex mutex;        // exclusive only to grow the table
+    std::vector<std::unique_ptr<Slot>> slots; // by class ID
+
+    static bool Reserve(Slot& slot) {
+        uint32_t taken = slot.taken.load();
+        for (;;) {
+            uint32_t capacity = slot.capacity.load();
+            if (capacity != 0 && taken >= capacity) return false;
+            if (slot.taken.compare_exchange_weak(taken, taken + 1)) return true;
+        }
+    }
+};
+
+// Course prerequisites as a DAG over classes, plus the classes each student
+// has completed. Each class keeps its direct prerequisites and their
+// transitive closure as bitsets over class IDs, so "does C depend on P?" is
+// one bit test. That makes refusing an edge that would close a cycle O(1),
+// and lets a completed class stand in for everything beneath it: a student
+// who passed Calculus II is not asked for Calculus I. Each student likewise
+// keeps a "covered" bitset, the classes they passed and everything beneath
+// them, so an eligibility check is direct & ~covered, a word at a time.
+// Adding an edge ORs the new prerequisite's closure into every class above
+// it; removing one recomputes only the classes above it, prerequisites first.
+// Either way the covered sets of students who passed one of those classes
+// are brought up to date. Mutations take the unique lock.
+class PrerequisiteBook {
+public:
+    enum class EdgeResult { Added, Removed, Exists, Missing, Cycle };
+
+    void EnsureClasses(size_t count) {
+        std::unique_lock<std::shared_mutex> lock(mutex);
+        Grow(count);
+    }
+
+    // classId now requires prerequisite
+    EdgeResult AddEdge(uint32_t classId, uint32_t prerequisite) {
+        std::unique_lock<std::shared_mutex> lock(mutex);
+        Grow(std::max(classId, prerequisite) + size_t(1));
+        if (classId == prerequisite || Test(closure[prerequisite], classId)) return EdgeResult::Cycle;
+        if (Test(direct[classId], prerequisite)) return EdgeResult::Exists;
+        Set(direct[classId], prerequisite);
+        std::vector<uint64_t> added = closure[prerequisite], above(words, 0);
+        Set(added, prerequisite);
+        for (size_t c = 0; c < closure.size(); ++c) {
+            if (c != classId && !Test(closure[c], classId)) continue;
+            Set(above, static_cast<uint32_t>(c));
+            for (size_t w = 0; w < words; ++w) closure[c][w] |= added[w];
+        }
+        for (auto& student : completed) {
+            if (!PassedAny(student.second, above)) continue;
+            std::vector<uint64_t>& bits = covered[student.first];
+            for (size_t w = 0; w < words; ++w) bits[w] |= added[w];
+        }
+        return EdgeResult::Added;
+    }
+
+    EdgeResult RemoveEdge(uint32_t classId, uint32_t prerequisite) {
+        std::unique_lock<std::shared_mutex> lock(mutex);
+        if (classId >= direct.size() || prerequisite >= direct.size() || !Test(direct[classId], prerequisite)) {
+            return EdgeResult::Missing;
+        }
+        direct[classId][prerequisite / 64] &= ~(uint64_t(1) << (prerequisite % 64));
+        // The classes above the edge, ordered by closure size: a class's
+        // prerequisites have strictly smaller closures, so they come first
+        std::vector<std::pair<size_t, uint32_t>> affected;
+        std::vector<uint64_t> above(words, 0);
+        for (size_t c = 0; c < closure.size(); ++c) {
+            if (c != classId && !Test(closure[c], classId)) continue;
+            affected.emplace_back(Count(closure[c]), static_cast<uint32_t>(c));
+            Set(above, static_cast<uint32_t>(c));
+        }
+        std::sort(affected.begin(), affected.end());
+        for (const auto& entry : affected) {
+            std::vector<uint64_t>& mine = closure[entry.second];
+            std::fill(mine.begin(), mine.end(), 0);
+            ForEach(direct[entry.second], [&](uint32_t p) {
+                for (size_t w = 0; w < words; ++w) mine[w] |= closure[p][w];
+                Set(mine, p);
+            });
+        }
+        for (const auto& student : completed) {
+            if (PassedAny(student.second, above)) Cover(student.first);
+        }
+        return EdgeResult::Removed;
+    }
+
+    // Record that a student passed a class; false if already recorded
+    bool Complete(uint32_t studentId, uint32_t classId) {
+        std::unique_lock<std::shared_mutex> lock(mutex);
+        Grow(classId + size_t(1));
+        std::vector<uint32_t>& passed = completed[studentId];
+        auto at = std::lower_bound(passed.begin(), passed.end(), classId);
+        if (at != passed.end() && *at == classId) return false;
+        passed.insert(at, classId);
+        std::vector<uint64_t>& bits = covered[studentId];
+        bits.resize(words, 0);
+        for (size_t w = 0; w < words; ++w) bits[w] |= closure[classId][w];
+        Set(bits, classId);
+        return true;
+    }
+
+    // The first direct prerequisite of classId the student has neither
+    // passed nor passed something above, or -1 if they are eligible
+    int64_t Missing(uint32_t classId, uint32_t studentId) const {
+        std::shared_lock<std::shared_mutex> lock(mutex);
+        if (classId >= direct.size()) return -1;
+        auto found = covered.find(studentId);
+        const std::vector<uint64_t>& need = direct[classId];
+        for (size_t w = 0; w < words; ++w) {
+            if (!need[w]) continue; // most words of a class's prerequisites are empty
+            uint64_t missing = need[w] & ~(found == covered.end() ? 0 : found->second[w]);
+            if (missing) return static_cast<int64_t>(w * 64 + PackedColumn::CountTrailingZeros(missing));
+        }
+        return -1;
+    }
+
+    // Direct prerequisites of a class
+    std::vector<uint32_t> Prerequisites(uint32_t classId) const {
+        std::shared_lock<std::shared_mutex> lock(mutex);
+        std::vector<uint32_t> out;
+        if (classId < direct.size()) ForEach(direct[classId], [&](uint32_t p) { out.push_back(p); });
+        return out;
+    }
+
+    // Does classId depend on other, directly or not?
+    bool Requires(uint32_t classId, uint32_t other) const {
+        std::shared_lock<std::shared_mutex> lock(mutex);
+        return classId < closure.size() && other < closure.size() && Test(closure[classId], other);
+    }
+
+    std::vector<uint32_t> Completed(uint32_t studentId) const {
+        std::shared_lock<std::shared_mutex> lock(mutex);
+        auto found = completed.find(studentId);
+        return found == completed.end() ? std::vector<uint32_t>() : found->second;
+    }
+
+    template <typename F>
+    auto Read(F fn) const -> decltype(fn(*this)) {
+        std::shared_lock<std::shared_mutex> lock(mutex);
+        return fn(*this);
+    }
+
+    // Unlocked accessors, for use inside Read()
+    size_t Classes() const { return direct.size(); }
+    template <typename F>
+    void ForEachPrerequisite(uint32_t classId, F fn) const { if (classId < direct.size()) ForEach(direct[classId], fn); }
+    const std::unordered_map<uint32_t, std::vector<uint32_t>>& CompletedByStudent() const { return completed; }
+
+private:
+    mutable std::shared_mutex mutex;
+    size_t words = 0;
+    std::vector<std::vector<uint64_t>> direct, closure;               // by class ID, bit per class ID
+    std::unordered_map<uint32_t, std::vector<uint32_t>> completed;   // sorted class IDs by student ID
+    std::unordered_map<uint32_t, std::vector<uint64_t>> covered;     // by student ID, bit per class ID
+
+    void Grow(size_t count) {
+        if (count <= direct.size()) return;
+        size_t needed = (count + 63) / 64;
+        if (needed > words) {
+            words = std::max(needed, words * 2);
+            for (auto& bits : direct) bits.resize(words, 0);
+            for (auto& bits : closure) bits.resize(words, 0);
+            for (auto& student : covered) student.second.resize(words, 0);
+        }
+        direct.resize(count, std::vector<uint64_t>(words, 0));
+        closure.resize(count, std::vector<uint64_t>(words, 0));
+    }
+
+    // Rebuild a student's covered set from the classes they passed
+    void Cover(uint32_t studentId) {
+        std::vector<uint64_t>& bits = covered[studentId];
+        bits.assign(words, 0);
+        for (uint32_t c : completed[studentId]) {
+            for (size_t w = 0; w < words; ++w) bits[w] |= closure[c][w];
+            Set(bits, c);
+        }
+    }
+
+    static bool PassedAny(const std::vector<uint32_t>& passed, const std::vector<uint64_t>& classes) {
+        for (uint32_t c : passed) {
+            if (Test(classes, c)) return true;
+        }
+        return false;
+    }
+
+    static bool Test(const std::vector<uint64_t>& bits, uint32_t i) { return (bits[i / 64] >> (i % 64)) & 1; }
+    static void Set(std::vector<uint64_t>& bits, uint32_t i) { bits[i / 64] |= uint64_t(1) << (i % 64); }
+
+    static size_t Count(const std::vector<uint64_t>& bits) {
+        size_t total = 0;
+        for (uint64_t word : bits) total += static_cast<size_t>(PackedColumn::PopCount(word));
+        return total;
+    }
+
+    template <typename F>
+    static void ForEach(const std::vector<uint64_t>& bits, F fn) {
+        for (size_t w = 0; w < bits.size(); ++w) {
+            for (uint64_t word = bits[w]; word; word &= word - 1) fn(static_cast<uint32_t>(w * 64 + PackedColumn::CountTrailingZeros(word)));
+        }
+    }
+};
+
+// The organization as a tree of units (a school, its departments, their
+// sub-departments) with each class hanging off one unit; classes nobody has
+// placed sit at the root. Units and classes are numbered in Euler-tour order:
+// every unit owns an interval [enter, exit) of the class tour and [first,
+// last) of the unit tour, so everything beneath it, however deep, is one
+// contiguous run. Listing a subtree is O(subtree) and "is class C under unit
+// U?" is two comparisons. The numbering is rebuilt in O(units + classes) on
+// the first read after the tree changes, so placing many classes in a row
+// costs one rebuild. Mutations take the unique lock.
+class OrganizationTree {
+public:
+    static constexpr uint32_t kRoot = 0;
+
+    enum class Result { Ok, Exists, NoSuchUnit };
+
+    // One unit of a subtree listing; depth counts from the root, whose
+    // children (top-level units such as the school) are at depth 1
+    struct Node {
+        uint32_t unit;
+        uint32_t depth;
+        std::string name;
+        size_t classes;     // in the whole subtree
+        size_t ownClasses;  // placed directly on the unit
+    };
+
+    OrganizationTree() : units(1) {}
+
+    void EnsureClasses(size_t count) {
+        std::unique_lock<std::shared_mutex> lock(mutex);
+        Grow(count);
+    }
+
+    // New unit under parent (kRoot for a top-level unit)
+    Result AddUnit(const std::string& name, uint32_t parent, uint32_t& unit) {
+        std::unique_lock<std::shared_mutex> lock(mutex);
+        if (parent >= units.size()) return Result::NoSuchUnit;
+        if (!byName.emplace(name, static_cast<uint32_t>(units.size())).second) return Result::Exists;
+        unit = static_cast<uint32_t>(units.size());
+        units.push_back({name, parent, {}, {}});
+        units[parent].children.push_back(unit);
+        stale = true;
+        return Result::Ok;
+    }
+
+    // Move a class under unit (kRoot to unplace it)
+    Result Place(uint32_t classId, uint32_t unit) {
+        std::unique_lock<std::shared_mutex> lock(mutex);
+        if (unit >= units.size()) return Result::NoSuchUnit;
+        Grow(classId + size_t(1));
+        uint32_t& from = unitOf[classId];
+        if (from == unit) return Result::Ok;
+        std::vector<uint32_t>& old = units[from].classes;
+        old.erase(std::find(old.begin(), old.end(), classId));
+        units[unit].classes.push_back(classId);
+        from = unit;
+        stale = true;
+        return Result::Ok;
+    }
+
+    bool FindUnit(const std::string& name, uint32_t& unit) const {
+        std::shared_lock<std::shared_mutex> lock(mutex);
+        auto found = byName.find(name);
+        if (found == byName.end()) return false;
+        unit = found->second;
+        return true;
+    }
+
+    // Is classId under unit, directly or through a sub-unit?
+    bool Contains(uint32_t unit, uint32_t classId) const {
+        return Numbered([&] {
+            if (unit >= spans.size() || classId >= position.size()) return false;
+            return position[classId] >= spans[unit].enter && position[classId] < spans[unit].exit;
+        });
+    }
+
+    // Every class under unit, in tour order
+    std::vector<uint32_t> ClassesUnder(uint32_t unit) const {
+        return Numbered([&] {
+            if (unit >= spans.size()) return std::vector<uint32_t>();
+            return std::vector<uint32_t>(tour.begin() + spans[unit].enter, tour.begin() + spans[unit].exit);
+        });
+    }
+
+    // unit and every unit beneath it, each parent before its children
+    std::vector<Node> Chart(uint32_t unit) const {
+        return Numbered([&] {
+            std::vector<Node> nodes;
+            if (unit >= spans.size()) return nodes;
+            for (uint32_t i = spans[unit].first; i < spans[unit].last; ++i) {
+                uint32_t u = unitTour[i];
+                nodes.push_back({u, spans[u].depth, units[u].name, spans[u].exit - spans[u].enter, units[u].classes.size()});
+            }
+            return nodes;
+        });
+    }
+
+    template <typename F>
+    auto Read(F fn) const -> decltype(fn(*this)) {
+        std::shared_lock<std::shared_mutex> lock(mutex);
+        return fn(*this);
+    }
+
+    // Unlocked accessors, for use inside Read(). Units are numbered in the
+    // order they were added, so a parent always precedes its children.
+    size_t Units() const { return units.size(); }
+    const std::string& UnitName(uint32_t unit) const { return units[unit].name; }
+    uint32_t Parent(uint32_t unit) const { return units[unit].parent; }
+    size_t Classes() const { return unitOf.size(); }
+    uint32_t UnitOf(uint32_t classId) const { return unitOf[classId]; }
+
+private:
+    struct Unit {
+        std::string name;
+        uint32_t parent;
+        std::vector<uint32_t> children, classes;
+    };
+
+    // A unit's place in the tours
+    struct Span {
+        uint32_t enter = 0, exit = 0;  // class tour
+        uint32_t first = 0, last = 0;  // unit tour
+        uint32_t depth = 0;
+    };
+
+    mutable std::shared_mutex mutex;
+    std::vector<Unit> units;                                // by unit ID; the root has no name
+    std::vector<uint32_t> unitOf;                           // by class ID
+    std::unordered_map<std::string, uint32_t> byName;
+    mutable bool stale = true;                              // the tours predate the last change
+    mutable std::vector<Span> spans;                        // by unit ID
+    mutable std::vector<uint32_t> tour, unitTour, position; // class IDs, unit IDs, tour index by class ID
+
+    void Grow(size_t count) {
+        while (unitOf.size() < count) {
+            units[kRoot].classes.push_back(static_cast<uint32_t>(unitOf.size()));
+            unitOf.push_back(kRoot);
+            stale = true;
+        }
+    }
+
+    // Run fn under the shared lock with the tours current, renumbering first if needed
+    template <typename F>
+    auto Numbered(F fn) const -> decltype(fn()) {
+        for (;;) {
+            {
+                std::shared_lock<std::shared_mutex> lock(mutex);
+                if (!stale) return fn();
+            }
+            std::unique_lock<std::shared_mutex> lock(mutex);
+            if (stale) Renumber();
+        }
+    }
+
+    // Depth-first walk from the root, with an explicit stack of (unit, next child)
+    void Renumber() const {
+        spans.assign(units.size(), Span());
+        tour.clear();
+        unitTour.clear();
+        position.assign(unitOf.size(), 0);
+        auto open = [&](uint32_t u, uint32_t depth) {
+            spans[u].enter = static_cast<uint32_t>(tour.size());
+            spans[u].first = static_cast<uint32_t>(unitTour.size());
+            spans[u].depth = depth;
+            unitTour.push_back(u);
+            for (uint32_t c : units[u].classes) {
+                position[c] = static_cast<uint32_t>(tour.size());
+                tour.push_back(c);
+            }
+        };
+        std::vector<std::pair<uint32_t, size_t>> stack = {{kRoot, 0}};
+        open(kRoot, 0);
+        while (!stack.empty()) {
+            uint32_t u = stack.back().first;
+            if (stack.back().second < units[u].children.size()) {
+                uint32_t child = units[u].children[stack.back().second++];
+                open(child, static_cast<uint32_t>(stack.size()));
+                stack.emplace_back(child, 0);
+            } else {
+                spans[u].exit = static_cast<uint32_t>(tour.size());
+                spans[u].last = static_cast<uint32_t>(unitTour.size());
+                stack.pop_back();
+            }
+        }
+        stale = false;
+    }
+};
+
+// Tables kept beside the versioned roster. They are updated in place under
+// their own locks rather than copied into every version, and are loaded and
+// saved by the RosterStore along with it.
+struct RosterTables {
+    StudentAttributeStore attributes;
+    Gradebook grades;
+    AttendanceBook attendance;
+    ScheduleBook schedules;
+    SeatBook seats;
+    PrerequisiteBook prerequisites;
+    OrganizationTree organization;
+};
+
+// A version's enrollments as they are saved: by class, and within a class in
+// the order the students joined it, which is the order of the class's
+// attendance rows. The in-memory list is unordered (drops move the last
+// enrollment into the gap), so loading rebuilds attendance rows from this.
+// Call inside attendance.Read().
+inline std::vector<Enrollment> SavedEnrollmentOrder(const RosterVersion& data, const AttendanceBook& attendance) {
+    std::vector<std::pair<uint64_t, Enrollment>> keyed;
+    keyed.reserve(data.enrollments.size());
+    for (const auto& e : data.enrollments) {
+        uint32_t position = UINT32_MAX;
+        if (const AttendanceBook::ClassSessions* book = attendance.Class(e.classId)) {
+            auto row = book->rowOf.find(e.studentId);
+            if (row != book->rowOf.end()) position = row->second;
+        }
+        keyed.emplace_back((uint64_t(e.classId) << 32) | position, e);
+    }
+    std::stable_sort(keyed.begin(), keyed.end(),
+                     [](const std::pair<uint64_t, Enrollment>& a, const std::pair<uint64_t, Enrollment>& b) { return a.first < b.first; });
+    std::vector<Enrollment> ordered;
+    ordered.reserve(keyed.size());
+    for (const auto& entry : keyed) ordered.push_back(entry.second);
+    return ordered;
+}
+
+// Where the Model keeps its roster between runs. Load runs once at startup;
+// Save runs on the persistence thread with every change drained in one batch
+// (in publish order), their combined DirtyFlags, and a pinned version that
+// already includes all of them.
+class RosterStore {
+public:
+    virtual ~RosterStore() = default;
+
+    virtual void Load(RosterVersion& data, RosterTables& tables) = 0;
+    virtual void Save(const RosterVersion& latest, const RosterTables& tables,
+                      const std::vector<Mutation>& batch, unsigned dirty) = 0;
+};
+
+// Human-readable text files, one per collection: classes.txt, students.txt,
+// enrollments.txt, student_attributes.txt, gradebook.txt, attendance.txt,
+// schedules.txt, rooms.txt, teacher_hours.txt, seats.txt, prerequisites.txt and
+// organization.txt. A save that touches several of them commits them together
+// through roster.commit (see WriteSnapshotBatch).
+class TextFileStore : public RosterStore {
+public:
+    void Load(RosterVersion& data, RosterTables& tables) override {
+        std::string body, line;
+        RecoverSnapshotBatch(kCommitPath, Files());
+
+        // Load classes from "classes.txt"
+        if (RecoverSnapshotFile("classes.txt", body)) {
+            std::istringstream finClasses(body);
+            while (std::getline(finClasses, line)) {
+                Trim(line);
+                if (!line.empty()) data.classes.push_back(line);
+            }
+        }
+        // Load students from "students.txt"
+        if (RecoverSnapshotFile("students.txt", body)) {
+            std::istringstream finStudents(body);
+            while (std::getline(finStudents, line)) {
+                Trim(line);
+                if (!line.empty()) data.students.push_back(line);
+            }
+        }
+        std::unordered_map<std::string, uint32_t> classIds, studentIds;
+        for (size_t i = 0; i < data.classes.size(); ++i) classIds.emplace(data.classes[i], static_cast<uint32_t>(i));
+        for (size_t i = 0; i < data.students.size(); ++i) studentIds.emplace(data.students[i], static_cast<uint32_t>(i));
+
+        // Load enrollments from "enrollments.txt" as "class<TAB>student" lines
+        if (RecoverSnapshotFile("enrollments.txt", body)) {
+            std::istringstream finEnrollments(body);
+            while (std::getline(finEnrollments, line)) {
+                size_t tab = line.find('\t');
+                if (tab == std::string::npos) continue;
+                std::string className = line.substr(0, tab), studentName = line.substr(tab + 1);
+                Trim(className);
+                Trim(studentName);
+                auto classId = classIds.find(className);
+                auto studentId = studentIds.find(studentName);
+                if (classId == classIds.end() || studentId == studentIds.end()) continue;
+                data.enrollments.push_back({classId->second, studentId->second});
+            }
+        }
+        // Load attributes from "student_attributes.txt" as "student<TAB>attributes"
+        // lines; students without a line keep the defaults
+        tables.attributes.EnsureRows(data.students.size());
+        if (RecoverSnapshotFile("student_attributes.txt", body)) {
+            std::istringstream finAttributes(body);
+            while (std::getline(finAttributes, line)) {
+                size_t tab = line.find('\t');
+                if (tab == std::string::npos) continue;
+                auto studentId = studentIds.find(line.substr(0, tab));
+                StudentAttributes row;
+                if (studentId == studentIds.end() || !row.Decode(line.substr(tab + 1))) continue;
+                tables.attributes.Set(studentId->second, row);
+            }
+        }
+        // Load the gradebook from "gradebook.txt": "assessment<TAB>class<TAB>name<TAB>max"
+        // lines, each followed by its "grade<TAB>class<TAB>assessment<TAB>student<TAB>score" lines
+        if (RecoverSnapshotFile("gradebook.txt", body)) {
+            std::istringstream finGrades(body);
+            while (std::getline(finGrades, line)) {
+                std::vector<std::string> fields = SplitFields(line);
+                auto classId = fields.size() > 1 ? classIds.find(fields[1]) : classIds.end();
+                if (classId == classIds.end()) continue;
+                if (fields[0] == "assessment" && fields.size() == 4) {
+                    tables.grades.AddAssessment(classId->second, fields[2], std::strtof(fields[3].c_str(), nullptr));
+                } else if (fields[0] == "grade" && fields.size() == 5) {
+                    auto studentId = studentIds.find(fields[3]);
+                    float previous;
+                    if (studentId == studentIds.end()) continue;
+                    tables.grades.SetScore(classId->second, fields[2], studentId->second,
+                                           std::strtof(fields[4].c_str(), nullptr), previous);
+                }
+            }
+        }
+        // Load attendance from "attendance.txt": "session<TAB>class<TAB>date<TAB>members<TAB>bitmap"
+        // lines in the order held. Bitmap rows follow enrollment order.
+        if (RecoverSnapshotFile("attendance.txt", body)) {
+            std::istringstream finAttendance(body);
+            std::vector<uint32_t> held(data.classes.size(), 0);
+            while (std::getline(finAttendance, line)) {
+                std::vector<std::string> fields = SplitFields(line);
+                auto classId = fields.size() == 5 ? classIds.find(fields[1]) : classIds.end();
+                int32_t day;
+                if (classId == classIds.end() || fields[0] != "session" || !ParseDate(fields[2], day)) continue;
+                uint32_t members = static_cast<uint32_t>(std::strtoul(fields[3].c_str(), nullptr, 10));
+                tables.attendance.RestoreSession(classId->second, held[classId->second]++, day, members,
+                                                 AttendanceBook::DecodeBitmap(fields[4], members));
+            }
+        }
+        // Load schedules from "schedules.txt" as "class<TAB>teacher<TAB>room<TAB>meetings" lines
+        if (RecoverSnapshotFile("schedules.txt", body)) {
+            std::istringstream finSchedules(body);
+            while (std::getline(finSchedules, line)) {
+                size_t tab = line.find('\t');
+                if (tab == std::string::npos) continue;
+                auto classId = classIds.find(line.substr(0, tab));
+                ClassSchedule schedule;
+                if (classId == classIds.end() || !schedule.Decode(line.substr(tab + 1))) continue;
+                tables.schedules.Set(classId->second, schedule);
+            }
+        }
+        // Load rooms from "rooms.txt" as "room<TAB>seats" lines
+        if (RecoverSnapshotFile("rooms.txt", body)) {
+            std::istringstream finRooms(body);
+            while (std::getline(finRooms, line)) {
+                std::vector<std::string> fields = SplitFields(line);
+                if (fields.size() == 2) tables.schedules.SetRoom(fields[0], static_cast<uint32_t>(std::strtoul(fields[1].c_str(), nullptr, 10)));
+            }
+        }
+        // Load teacher hours from "teacher_hours.txt" as "teacher<TAB>meetings" lines
+        if (RecoverSnapshotFile("teacher_hours.txt", body)) {
+            std::istringstream finHours(body);
+            while (std::getline(finHours, line)) {
+                std::vector<std::string> fields = SplitFields(line);
+                std::vector<Meeting> hours;
+                if (fields.size() == 2 && ParseMeetings(fields[1], hours)) tables.schedules.SetAvailability(fields[0], hours);
+            }
+        }
+        // Load capacities and waitlists from "seats.txt" as "capacity<TAB>class<TAB>seats"
+        // and "waiting<TAB>class<TAB>student" lines, waitlists in queue order
+        if (RecoverSnapshotFile("seats.txt", body)) {
+            std::istringstream finSeats(body);
+            while (std::getline(finSeats, line)) {
+                std::vector<std::string> fields = SplitFields(line);
+                auto classId = fields.size() == 3 ? classIds.find(fields[1]) : classIds.end();
+                if (classId == classIds.end()) continue;
+                if (fields[0] == "capacity") {
+                    tables.seats.RestoreCapacity(classId->second, static_cast<uint32_t>(std::strtoul(fields[2].c_str(), nullptr, 10)));
+                } else if (fields[0] == "waiting") {
+                    auto studentId = studentIds.find(fields[2]);
+                    if (studentId != studentIds.end()) tables.seats.RestoreWaiting(classId->second, studentId->second);
+                }
+            }
+        }
+        // Load prerequisites and completions from "prerequisites.txt" as
+        // "requires<TAB>class<TAB>prerequisite" and "passed<TAB>student<TAB>class" lines
+        if (RecoverSnapshotFile("prerequisites.txt", body)) {
+            std::istringstream finPrerequisites(body);
+            while (std::getline(finPrerequisites, line)) {
+                std::vector<std::string> fields = SplitFields(line);
+                if (fields.size() != 3) continue;
+                auto classId = classIds.find(fields[fields[0] == "passed" ? 2 : 1]);
+                if (classId == classIds.end()) continue;
+                if (fields[0] == "requires") {
+                    auto prerequisite = classIds.find(fields[2]);
+                    if (prerequisite != classIds.end()) tables.prerequisites.AddEdge(classId->second, prerequisite->second);
+                } else if (fields[0] == "passed") {
+                    auto studentId = studentIds.find(fields[1]);
+                    if (studentId != studentIds.end()) tables.prerequisites.Complete(studentId->second, classId->second);
+                }
+            }
+        }
+        // Load the organization from "organization.txt" as "unit<TAB>name<TAB>parent"
+        // lines (parent empty for a top-level unit), parents first, then
+        // "class<TAB>class<TAB>unit" lines
+        if (RecoverSnapshotFile("organization.txt", body)) {
+            std::istringstream finOrganization(body);
+            tables.organization.EnsureClasses(data.classes.size());
+            while (std::getline(finOrganization, line)) {
+                std::vector<std::string> fields = SplitFields(line);
+                if (fields.size() != 3) continue;
+                uint32_t parent = OrganizationTree::kRoot, unit;
+                if (!fields[2].empty() && !tables.organization.FindUnit(fields[2], parent)) continue;
+                if (fields[0] == "unit") {
+                    tables.organization.AddUnit(fields[1], parent, unit);
+                } else if (fields[0] == "class") {
+                    auto classId = classIds.find(fields[1]);
+                    if (classId != classIds.end()) tables.organization.Place(classId->second, parent);
+                }
+            }
+        }
+    }
+
+    // Rewrite the collections flagged in dirty as one atomic batch, so a drop
+    // never lands in enrollments.txt without the attendance rows it shifts
+    void Save(const RosterVersion& data, const RosterTables& tables,
+              const std::vector<Mutation>&, unsigned dirty) override {
+        std::vector<std::pair<std::string, std::string>> files; // path, body
+        // Save classes
+        if (dirty & kDirtyClasses) {
+            std::ostringstream foutClasses;
+            for (const auto& c : data.classes) foutClasses << c << '\n';
+            files.emplace_back("classes.txt", foutClasses.str());
+        }
+
+        // Save students
+        if (dirty & kDirtyStudents) {
+            std::ostringstream foutStudents;
+            for (const auto& s : data.students) foutStudents << s << '\n';
+            files.emplace_back("students.txt", foutStudents.str());
+        }
+
+        // Save enrollments; names never change, so only new enrollments dirty this file
+        if (dirty & kDirtyEnrollments) {
+            std::ostringstream foutEnrollments;
+            std::vector<Enrollment> ordered = tables.attendance.Read([&](const AttendanceBook& attendance) {
+                return SavedEnrollmentOrder(data, attendance);
+            });
+            for (const auto& e : ordered) {
+                foutEnrollments << data.classes[e.classId] << '\t' << data.students[e.studentId] << '\n';
+            }
+            files.emplace_back("enrollments.txt", foutEnrollments.str());
+        }
+
+        // Save attributes of students that have any
+        if (dirty & kDirtyAttributes) {
+            std::ostringstream foutAttributes;
+            tables.attributes.Read([&](const StudentAttributeStore& columns) {
+                size_t rows = std::min(columns.Rows(), data.students.size());
+                for (size_t i = 0; i < rows; ++i) {
+                    StudentAttributes row = columns.GetLocked(static_cast<uint32_t>(i));
+                    if (!row.IsDefault()) foutAttributes << data.students[i] << '\t' << row.Encode() << '\n';
+                }
+            });
+            files.emplace_back("student_attributes.txt", foutAttributes.str());
+        }
+
+        // Save the gradebook: every assessment and its graded scores
+        if (dirty & kDirtyGrades) {
+            std::ostringstream foutGrades;
+            tables.grades.Read([&](const Gradebook& grades) {
+                size_t classes = std::min(grades.Classes(), data.classes.size());
+                for (size_t c = 0; c < classes; ++c) {
+                    const Gradebook::ClassBook& book = *grades.Class(static_cast<uint32_t>(c));
+                    for (const auto& assessment : book.assessments) {
+                        foutGrades << "assessment\t" << data.classes[c] << '\t' << assessment.name << '\t'
+                                   << FormatFloat(assessment.maxPoints) << '\n';
+                        for (size_t row = 0; row < book.members.size(); ++row) {
+                            float score = assessment.scores[row];
+                            if (std::isnan(score) || book.members[row] >= data.students.size()) continue;
+                            foutGrades << "grade\t" << data.classes[c] << '\t' << assessment.name << '\t'
+                                       << data.students[book.members[row]] << '\t' << FormatFloat(score) << '\n';
+                        }
+                    }
+                }
+            });
+            files.emplace_back("gradebook.txt", foutGrades.str());
+        }
+
+        // Save attendance: every session with its bitmap
+        if (dirty & kDirtyAttendance) {
+            std::ostringstream foutAttendance;
+            tables.attendance.Read([&](const AttendanceBook& attendance) {
+                size_t classes = std::min(attendance.Classes(), data.classes.size());
+                for (size_t c = 0; c < classes; ++c) {
+                    for (const auto& session : attendance.Class(static_cast<uint32_t>(c))->sessions) {
+                        foutAttendance << "session\t" << data.classes[c] << '\t' << FormatDate(session.day) << '\t'
+                                       << session.members << '\t'
+                                       << AttendanceBook::EncodeBitmap(session.present, session.members) << '\n';
+                    }
+                }
+            });
+            files.emplace_back("attendance.txt", foutAttendance.str());
+        }
+
+        // Save schedules of classes that have one
+        if (dirty & kDirtySchedules) {
+            std::ostringstream foutSchedules;
+            tables.schedules.Read([&](const ScheduleBook& schedules) {
+                size_t classes = std::min(schedules.Classes(), data.classes.size());
+                for (size_t c = 0; c < classes; ++c) {
+                    const ClassSchedule& schedule = *schedules.Class(static_cast<uint32_t>(c));
+                    if (schedule.meetings.empty() && schedule.teacher.empty() && schedule.room.empty()) continue;
+                    foutSchedules << data.classes[c] << '\t' << schedule.Encode() << '\n';
+                }
+            });
+            files.emplace_back("schedules.txt", foutSchedules.str());
+
+            // Rooms and teacher hours travel with the schedules
+            std::ostringstream foutRooms, foutHours;
+            tables.schedules.Read([&](const ScheduleBook& schedules) {
+                for (const auto& room : schedules.Rooms()) foutRooms << room.first << '\t' << room.second << '\n';
+                for (const auto& teacher : schedules.Availability()) {
+                    foutHours << teacher.first << '\t' << FormatMeetings(teacher.second) << '\n';
+                }
+            });
+            files.emplace_back("rooms.txt", foutRooms.str());
+            files.emplace_back("teacher_hours.txt", foutHours.str());
+        }
+
+        // Save capacities and waitlists
+        if (dirty & kDirtySeats) {
+            std::ostringstream foutSeats;
+            size_t classes = std::min(tables.seats.Classes(), data.classes.size());
+            for (size_t c = 0; c < classes; ++c) {
+                uint32_t capacity = tables.seats.Get(static_cast<uint32_t>(c)).capacity;
+                if (capacity != 0) foutSeats << "capacity\t" << data.classes[c] << '\t' << capacity << '\n';
+                for (uint32_t studentId : tables.seats.Waitlist(static_cast<uint32_t>(c))) {
+                    if (studentId < data.students.size()) foutSeats << "waiting\t" << data.classes[c] << '\t' << data.students[studentId] << '\n';
+                }
+            }
+            files.emplace_back("seats.txt", foutSeats.str());
+        }
+
+        // Save prerequisites and completions
+        if (dirty & kDirtyPrerequisites) {
+            std::ostringstream foutPrerequisites;
+            tables.prerequisites.Read([&](const PrerequisiteBook& book) {
+                size_t classes = std::min(book.Classes(), data.classes.size());
+                for (size_t c = 0; c < classes; ++c) {
+                    book.ForEachPrerequisite(static_cast<uint32_t>(c), [&](uint32_t p) {
+                        if (p < data.classes.size()) foutPrerequisites << "requires\t" << data.classes[c] << '\t' << data.classes[p] << '\n';
+                    });
+                }
+                for (const auto& student : book.CompletedByStudent()) {
+                    if (student.first >= data.students.size()) continue;
+                    for (uint32_t c : student.second) {
+                        if (c < data.classes.size()) foutPrerequisites << "passed\t" << data.students[student.first] << '\t' << data.classes[c] << '\n';
+                    }
+                }
+            });
+            files.emplace_back("prerequisites.txt", foutPrerequisites.str());
+        }
+
+        // Save the organization
+        if (dirty & kDirtyOrganization) {
+            std::ostringstream foutOrganization;
+            tables.organization.Read([&](const OrganizationTree& tree) {
+                for (uint32_t u = 1; u < tree.Units(); ++u) {
+                    uint32_t parent = tree.Parent(u);
+                    foutOrganization << "unit\t" << tree.UnitName(u) << '\t'
+                                     << (parent == OrganizationTree::kRoot ? "" : tree.UnitName(parent)) << '\n';
+                }
+                size_t classes = std::min(tree.Classes(), data.classes.size());
+                for (size_t c = 0; c < classes; ++c) {
+                    uint32_t unit = tree.UnitOf(static_cast<uint32_t>(c));
+                    if (unit != OrganizationTree::kRoot) foutOrganization << "class\t" << data.classes[c] << '\t' << tree.UnitName(unit) << '\n';
+                }
+            });
+            files.emplace_back("organization.txt", foutOrganization.str());
+        }
+
+        if (!files.empty() && !WriteSnapshotBatch(kCommitPath, files)) {
+            std::cerr << "Warning: could not save the roster; the files on disk keep the previous save.\n";
+        }
+    }
+
+private:
+    static constexpr const char* kCommitPath = "roster.commit";
+
+    // Every file Save may write; crash recovery touches no others
+    static const std::vector<std::string>& Files() {
+        static const std::vector<std::string> files = {
+            "classes.txt", "students.txt", "enrollments.txt", "student_attributes.txt", "gradebook.txt",
+            "attendance.txt", "schedules.txt", "rooms.txt", "teacher_hours.txt", "seats.txt",
+            "prerequisites.txt", "organization.txt"};
+        return files;
+    }
+
+    // Trim helper
+    static void Trim(std::string& s) {
+        const char* whitespace = " \t\n\r\f\v";
+        s.erase(s.find_last_not_of(whitespace) + 1);
+        s.erase(0, s.find_first_not_of(whitespace));
+    }
+};
+
+// Append-only binary journal of mutation records plus a periodic checkpoint.
+// Saving a batch appends only the new records, so cost is proportional to the
+// change rather than the roster. Each record is framed as [u32 length][u32 crc]
+// [payload]; loading stops at the first torn or corrupt frame and cuts the
+// journal back to the last good record. Once the journal outgrows
+// kCheckpointBytes the whole roster is written to roster.checkpoint (same
+// record format, atomic snapshot) and the journal starts over.
+//
+// Every record carries the generation of the journal it was written to, and
+// the checkpoint's records carry the generation it covers. A crash after the
+// checkpoint is renamed into place but before the journal is truncated leaves
+// a journal of that generation behind; Load skips it rather than replaying
+// drops, re-enrollments and sessions on top of a roster that already has
+// them. Records from before generations existed have none and always replay.
+class JournaledBinaryStore : public RosterStore {
+public:
+    static constexpr long kCheckpointBytes = 4 << 20;
+
+    ~JournaledBinaryStore() override {
+        if (journal) std::fclose(journal);
+    }
+
+    void Load(RosterVersion& data, RosterTables& tables) override {
+        Replayer replay(data, tables);
+        std::string body;
+        uint64_t covered = 0, frameGeneration;
+        if (RecoverSnapshotFile(kCheckpointPath, body)) {
+            size_t offset = 0;
+            Mutation change;
+            while (ReadFrame(body, offset, change, frameGeneration)) {
+                covered = std::max(covered, frameGeneration);
+                replay.Apply(change);
+            }
+        }
+        generation = covered + 1;
+
+        std::ifstream in(kJournalPath, std::ios::binary);
+        std::string content((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+        in.close();
+        size_t offset = 0, stale = 0, applied = 0;
+        Mutation change;
+        while (ReadFrame(content, offset, change, frameGeneration)) {
+            if (frameGeneration != 0 && frameGeneration <= covered) {
+                ++stale;
+                continue;
+            }
+            generation = std::max(generation, frameGeneration);
+            replay.Apply(change);
+            ++applied;
+        }
+        if (stale > 0 && applied == 0) {
+            // The checkpoint already holds all of it; start the journal over
+            std::cerr << "Skipped " << stale << " records in " << kJournalPath << " that predate " << kCheckpointPath << ".\n";
+            offset = 0;
+            content.clear();
+            std::filesystem::resize_file(kJournalPath, 0);
+        }
+        if (offset < content.size()) {
+            std::cerr << "Discarded a torn record at the end of " << kJournalPath << ".\n";
+            std::filesystem::resize_file(kJournalPath, offset);
+        }
+        journal = std::fopen(kJournalPath, "ab");
+    }
+
+    void Save(const RosterVersion& latest, const RosterTables& tables,
+              const std::vector<Mutation>& batch, unsigned) override {
+        if (!journal) return;
+        std::string frames;
+        for (const auto& change : batch) {
+            if (change.kind != Mutation::Kind::Barrier) AppendFrame(frames, change);
+        }
+        if (frames.empty()) return;
+        bool ok = std::fwrite(frames.data(), 1, frames.size(), journal) == frames.size() && SyncFile(journal);
+        if (!ok) std::cerr << "Warning: could not append to " << kJournalPath << ".\n";
+        if (std::ftell(journal) > kCheckpointBytes) Checkpoint(latest, tables);
+    }
+
+private:
+    static constexpr const char* kJournalPath = "roster.journal";
+    static constexpr const char* kCheckpointPath = "roster.checkpoint";
+
+    std::FILE* journal = nullptr;
+    uint64_t generation = 1; // of the journal being appended; the next checkpoint covers it
+
+    // Applies records in order, ignoring any that are already reflected.
+    // Attribute, grade and attendance records overwrite values (a curve is
+    // journaled as the scores it produced, a session carries its index), so
+    // replaying one twice is harmless.
+    class Replayer {
+    public:
+        Replayer(RosterVersion& data, RosterTables& tables) : data(data), tables(tables) {}
+
+        void Apply(const Mutation& change) {
+            switch (change.kind) {
+                case Mutation::Kind::AddClass:
+                    if (classIds.emplace(change.first, static_cast<uint32_t>(data.classes.size())).second) {
+                        data.classes.push_back(change.first);
+                    }
+                    break;
+                case Mutation::Kind::AddStudent:
+                    if (studentIds.emplace(change.first, static_cast<uint32_t>(data.students.size())).second) {
+                        data.students.push_back(change.first);
+                        tables.attributes.EnsureRows(data.students.size());
+                    }
+                    break;
+                case Mutation::Kind::Enroll: {
+                    auto c = classIds.find(change.first);
+                    auto s = studentIds.find(change.second);
+                    if (c == classIds.end() || s == studentIds.end()) break;
+                    if (enrolled.emplace((uint64_t(c->second) << 32) | s->second, data.enrollments.size()).second) {
+                        data.enrollments.push_back({c->second, s->second});
+                        tables.attendance.AddMember(c->second, s->second);
+                    }
+                    break;
+                }
+                case Mutation::Kind::Drop: {
+                    auto c = classIds.find(change.first);
+                    auto s = studentIds.find(change.second);
+                    if (c == classIds.end() || s == studentIds.end()) break;
+                    auto at = enrolled.find((uint64_t(c->second) << 32) | s->second);
+                    if (at == enrolled.end()) break;
+                    size_t position = at->second;
+                    enrolled.erase(at);
+                    const Enrollment& moved = data.enrollments[data.enrollments.size() - 1];
+                    if (position + 1 != data.enrollments.size()) enrolled[(uint64_t(moved.classId) << 32) | moved.studentId] = position;
+                    data.enrollments.swap_erase(position);
+                    int64_t present, recorded;
+                    tables.attendance.RemoveMember(c->second, s->second, present, recorded);
+                    tables.grades.RemoveMember(c->second, s->second);
+                    break;
+                }
+                case Mutation::Kind::SetCapacity: {
+                    auto c = classIds.find(change.first);
+                    if (c != classIds.end()) tables.seats.RestoreCapacity(c->second, static_cast<uint32_t>(std::strtoul(change.second.c_str(), nullptr, 10)));
+                    break;
+                }
+                case Mutation::Kind::JoinWaitlist:
+                case Mutation::Kind::LeaveWaitlist: {
+                    auto c = classIds.find(change.first);
+                    auto s = studentIds.find(change.second);
+                    if (c == classIds.end() || s == studentIds.end()) break;
+                    if (change.kind == Mutation::Kind::JoinWaitlist) tables.seats.RestoreWaiting(c->second, s->second);
+                    else tables.seats.Leave(c->second, s->second, [] {});
+                    break;
+                }
+                case Mutation::Kind::AddPrerequisite:
+                case Mutation::Kind::RemovePrerequisite: {
+                    auto c = classIds.find(change.first);
+                    auto p = classIds.find(change.second);
+                    if (c == classIds.end() || p == classIds.end()) break;
+                    if (change.kind == Mutation::Kind::AddPrerequisite) tables.prerequisites.AddEdge(c->second, p->second);
+                    else tables.prerequisites.RemoveEdge(c->second, p->second);
+                    break;
+                }
+                case Mutation::Kind::Complete: {
+                    auto s = studentIds.find(change.first);
+                    auto c = classIds.find(change.second);
+                    if (s != studentIds.end() && c != classIds.end()) tables.prerequisites.Complete(s->second, c->second);
+                    break;
+                }
+                case Mutation::Kind::AddUnit:
+                case Mutation::Kind::PlaceClass: {
+                    // A unit that already exists keeps its first parent
+                    uint32_t unit = OrganizationTree::kRoot, added;
+                    if (!change.second.empty() && !tables.organization.FindUnit(change.second, unit)) break;
+                    if (change.kind == Mutation::Kind::AddUnit) {
+                        tables.organization.AddUnit(change.first, unit, added);
+                    } else {
+                        auto c = classIds.find(change.first);
+                        if (c != classIds.end()) tables.organization.Place(c->second, unit);
+                    }
+                    break;
+                }
+                case Mutation::Kind::SetAttributes: {
+                    auto s = studentIds.find(change.first);
+                    StudentAttributes row;
+                    if (s != studentIds.end() && row.Decode(change.second)) tables.attributes.Set(s->second, row);
+                    break;
+                }
+                case Mutation::Kind::AddAssessment: {
+                    auto c = classIds.find(change.first);
+                    std::vector<std::string> fields = SplitFields(change.second);
+                    if (c == classIds.end() || fields.size() != 2) break;
+                    tables.grades.AddAssessment(c->second, fields[0], std::strtof(fields[1].c_str(), nullptr));
+                    break;
+                }
+                case Mutation::Kind::SetGrades: {
+                    // "assessment<TAB>student<TAB>score" with further student/score pairs
+                    auto c = classIds.find(change.first);
+                    std::vector<std::string> fields = SplitFields(change.second);
+                    if (c == classIds.end()) break;
+                    for (size_t f = 1; f + 1 < fields.size(); f += 2) {
+                        auto s = studentIds.find(fields[f]);
+                        float previous;
+                        if (s == studentIds.end()) continue;
+                        tables.grades.SetScore(c->second, fields[0], s->second, std::strtof(fields[f + 1].c_str(), nullptr), previous);
+                    }
+                    break;
+                }
+                case Mutation::Kind::AddSession: {
+                    // "index<TAB>day<TAB>members" with an optional bitmap (none: all absent)
+                    auto c = classIds.find(change.first);
+                    std::vector<std::string> fields = SplitFields(change.second);
+                    if (c == classIds.end() || fields.size() < 3) break;
+                    uint32_t members = static_cast<uint32_t>(std::strtoul(fields[2].c_str(), nullptr, 10));
+                    tables.attendance.RestoreSession(c->second, static_cast<uint32_t>(std::strtoul(fields[0].c_str(), nullptr, 10)),
+                                                     std::atoi(fields[1].c_str()), members,
+                                                     AttendanceBook::DecodeBitmap(fields.size() > 3 ? fields[3] : "", members));
+                    break;
+                }
+                case Mutation::Kind::SetAttendance: {
+                    // "index<TAB>student<TAB>1|0" with further student/mark pairs
+                    auto c = classIds.find(change.first);
+                    std::vector<std::string> fields = SplitFields(change.second);
+                    if (c == classIds.end()) break;
+                    uint32_t session = static_cast<uint32_t>(std::strtoul(fields[0].c_str(), nullptr, 10));
+                    for (size_t f = 1; f + 1 < fields.size(); f += 2) {
+                        auto s = studentIds.find(fields[f]);
+                        if (s != studentIds.end()) tables.attendance.SetPresent(c->second, session, s->second, fields[f + 1] == "1");
+                    }
+                    break;
+                }
+                case Mutation::Kind::SetSchedule: {
+                    auto c = classIds.find(change.first);
+                    ClassSchedule schedule;
+                    if (c != classIds.end() && schedule.Decode(change.second)) tables.schedules.Set(c->second, schedule);
+                    break;
+                }
+                case Mutation::Kind::SetRoom:
+                    tables.schedules.SetRoom(change.first, static_cast<uint32_t>(std::strtoul(change.second.c_str(), nullptr, 10)));
+                    break;
+                case Mutation::Kind::SetAvailability: {
+                    std::vector<Meeting> hours;
+                    if (ParseMeetings(change.second, hours)) tables.schedules.SetAvailability(change.first, hours);
+                    break;
+                }
+                case Mutation::Kind::Barrier:
+                    break;
+            }
+        }
+
+    private:
+        RosterVersion& data;
+        RosterTables& tables;
+        std::unordered_map<std::string, uint32_t> classIds, studentIds;
+        std::unordered_map<uint64_t, size_t> enrolled; // position in data.enrollments, by class << 32 | student
+    };
+
+    void Checkpoint(const RosterVersion& latest, const RosterTables& tables) {
+        std::string body;
+        // Marks the generation covered even when the roster is empty
+        AppendFrame(body, {Mutation::Kind::Barrier, 0, "", ""});
+        for (const auto& c : latest.classes) AppendFrame(body, {Mutation::Kind::AddClass, 0, c, ""});
+        for (const auto& s : latest.students) AppendFrame(body, {Mutation::Kind::AddStudent, 0, s, ""});
+        std::vector<Enrollment> ordered = tables.attendance.Read([&](const AttendanceBook& attendance) {
+            return SavedEnrollmentOrder(latest, attendance);
+        });
+        for (const auto& e : ordered) {
+            AppendFrame(body, {Mutation::Kind::Enroll, 0, latest.classes[e.classId], latest.students[e.studentId]});
+        }
+        tables.attributes.Read([&](const StudentAttributeStore& columns) {
+            size_t rows = std::min(columns.Rows(), latest.students.size());
+            for (size_t i = 0; i < rows; ++i) {
+                StudentAttributes row = columns.GetLocked(static_cast<uint32_t>(i));
+                if (!row.IsDefault()) AppendFrame(body, {Mutation::Kind::SetAttributes, 0, latest.students[i], row.Encode()});
+            }
+        });
+        tables.grades.Read([&](const Gradebook& grades) {
+            size_t classes = std::min(grades.Classes(), latest.classes.size());
+            for (size_t c = 0; c < classes; ++c) {
+                const Gradebook::ClassBook& book = *grades.Class(static_cast<uint32_t>(c));
+                for (const auto& assessment : book.assessments) {
+                    AppendFrame(body, {Mutation::Kind::AddAssessment, 0, latest.classes[c],
+                                       assessment.name + '\t' + FormatFloat(assessment.maxPoints)});
+                    for (size_t row = 0; row < book.members.size(); ++row) {
+                        float score = assessment.scores[row];
+                        if (std::isnan(score) || book.members[row] >= latest.students.size()) continue;
+                        AppendFrame(body, {Mutation::Kind::SetGrades, 0, latest.classes[c], assessment.name + '\t'
+                                           + latest.students[book.members[row]] + '\t' + FormatFloat(score)});
+                    }
+                }
+            }
+        });
+        tables.attendance.Read([&](const AttendanceBook& attendance) {
+            size_t classes = std::min(attendance.Classes(), latest.classes.size());
+            for (size_t c = 0; c < classes; ++c) {
+                const auto& sessions = attendance.Class(static_cast<uint32_t>(c))->sessions;
+                for (size_t index = 0; index < sessions.size(); ++index) {
+                    const AttendanceBook::Session& session = sessions[index];
+                    AppendFrame(body, {Mutation::Kind::AddSession, 0, latest.classes[c],
+                                       std::to_string(index) + '\t' + std::to_string(session.day) + '\t'
+                                       + std::to_string(session.members) + '\t'
+                                       + AttendanceBook::EncodeBitmap(session.present, session.members)});
+                }
+            }
+        });
+        tables.schedules.Read([&](const ScheduleBook& schedules) {
+            size_t classes = std::min(schedules.Classes(), latest.classes.size());
+            for (size_t c = 0; c < classes; ++c) {
+                const ClassSchedule& schedule = *schedules.Class(static_cast<uint32_t>(c));
+                if (schedule.meetings.empty() && schedule.teacher.empty() && schedule.room.empty()) continue;
+                AppendFrame(body, {Mutation::Kind::SetSchedule, 0, latest.classes[c], schedule.Encode()});
+            }
+            for (const auto& room : schedules.Rooms()) {
+                AppendFrame(body, {Mutation::Kind::SetRoom, 0, room.first, std::to_string(room.second)});
+            }
+            for (const auto& teacher : schedules.Availability()) {
+                AppendFrame(body, {Mutation::Kind::SetAvailability, 0, teacher.first, FormatMeetings(teacher.second)});
+            }
+        });
+        size_t seatClasses = std::min(tables.seats.Classes(), latest.classes.size());
+        for (size_t c = 0; c < seatClasses; ++c) {
+            uint32_t capacity = tables.seats.Get(static_cast<uint32_t>(c)).capacity;
+            if (capacity != 0) AppendFrame(body, {Mutation::Kind::SetCapacity, 0, latest.classes[c], std::to_string(capacity)});
+            for (uint32_t studentId : tables.seats.Waitlist(static_cast<uint32_t>(c))) {
+                if (studentId < latest.students.size()) {
+                    AppendFrame(body, {Mutation::Kind::JoinWaitlist, 0, latest.classes[c], latest.students[studentId]});
+                }
+            }
+        }
+        tables.prerequisites.Read([&](const PrerequisiteBook& book) {
+            size_t classes = std::min(book.Classes(), latest.classes.size());
+            for (size_t c = 0; c < classes; ++c) {
+                book.ForEachPrerequisite(static_cast<uint32_t>(c), [&](uint32_t p) {
+                    if (p < latest.classes.size()) AppendFrame(body, {Mutation::Kind::AddPrerequisite, 0, latest.classes[c], latest.classes[p]});
+                });
+            }
+            for (const auto& student : book.CompletedByStudent()) {
+                if (student.first >= latest.students.size()) continue;
+                for (uint32_t c : student.second) {
+                    if (c < latest.classes.size()) AppendFrame(body, {Mutation::Kind::Complete, 0, latest.students[student.first], latest.classes[c]});
+                }
+            }
+        });
+        tables.organization.Read([&](const OrganizationTree& tree) {
+            for (uint32_t u = 1; u < tree.Units(); ++u) {
+                uint32_t parent = tree.Parent(u);
+                AppendFrame(body, {Mutation::Kind::AddUnit, 0, tree.UnitName(u),
+                                   parent == OrganizationTree::kRoot ? "" : tree.UnitName(parent)});
+            }
+            size_t classes = std::min(tree.Classes(), latest.classes.size());
+            for (size_t c = 0; c < classes; ++c) {
+                uint32_t unit = tree.UnitOf(static_cast<uint32_t>(c));
+                if (unit != OrganizationTree::kRoot) AppendFrame(body, {Mutation::Kind::PlaceClass, 0, latest.classes[c], tree.UnitName(unit)});
+            }
+        });
+        if (!WriteSnapshotFile(kCheckpointPath, body)) {
+            std::cerr << "Warning: could not save " << kCheckpointPath << ".\n";
+            return;
+        }
+        // From here a crash leaves a stale journal that Load recognizes and skips
+        ++generation;
+        std::fclose(journal);
+        journal = std::fopen(kJournalPath, "wb");
+        if (!journal || !SyncFile(journal)) std::cerr << "Warning: could not truncate " << kJournalPath << ".\n";
+        SyncDirectory(".");
+    }
+
+    // Payload: kind byte (high bit set when a generation follows), the u64
+    // generation, then each field as [u32 length][bytes]
+    static constexpr unsigned char kHasGeneration = 0x80;
+
+    void AppendFrame(std::string& out, const Mutation& change) const {
+        std::string payload(1, static_cast<char>(static_cast<unsigned char>(change.kind) | kHasGeneration));
+        payload.append(reinterpret_cast<const char*>(&generation), 8);
+        for (const std::string* field : {&change.first, &change.second}) {
+            uint32_t length = static_cast<uint32_t>(field->size());
+            payload.append(reinterpret_cast<const char*>(&length), 4);
+            payload += *field;
+        }
+        uint32_t header[2] = {static_cast<uint32_t>(payload.size()), Crc32(payload.data(), payload.size())};
+        out.append(reinterpret_cast<const char*>(header), 8);
+        out += payload;
+    }
+
+    // generation is 0 for a record written before generations existed
+    static bool ReadFrame(const std::string& in, size_t& offset, Mutation& change, uint64_t& generation) {
+        uint32_t header[2];
+        if (in.size() - offset < 8) return false;
+        std::memcpy(header, in.data() + offset, 8);
+        if (in.size() - offset - 8 < header[0] || header[0] < 9) return false;
+        const char* payload = in.data() + offset + 8;
+        if (Crc32(payload, header[0]) != header[1]) return false;
+
+        size_t pos = 1;
+        unsigned char kind = static_cast<unsigned char>(payload[0]);
+        generation = 0;
+        if (kind & kHasGeneration) {
+            if (header[0] < 17) return false;
+            std::memcpy(&generation, payload + 1, 8);
+            pos += 8;
+            kind &= static_cast<unsigned char>(~kHasGeneration);
+        }
+        std::string* fields[2] = {&change.first, &change.second};
+        for (std::string* field : fields) {
+            uint32_t length;
+            if (header[0] - pos < 4) return false;
+            std::memcpy(&length, payload + pos, 4);
+            pos += 4;
+            if (header[0] - pos < length) return false;
+            field->assign(payload + pos, length);
+            pos += length;
+        }
+        change.kind = static_cast<Mutation::Kind>(kind);
+        change.ticket = 0;
+        offset += 8 + header[0];
+        return true;
+    }
+};
+
+// Keeps nothing; for benchmarks and tests that must not touch the disk
+class MemoryStore : public RosterStore {
+public:
+    void Load(RosterVersion&, RosterTables&) override {}
+    void Save(const RosterVersion&, const RosterTables&, const std::vector<Mutation>&, unsigned) override {}
+};
+
+// Live per-class totals for dashboards, maintained by deltas as enrollments,
+// grades and attendance change so a class card reads them in O(1) instead of
+// scanning. Grade sums are kept in fixed point (thousandths) so adding and
+// later removing the same grade cancels exactly. Fields are atomics: writers
+// adjust them under the shared lock, which is taken exclusively only to grow
+// the table when classes are added.
+class ClassAggregates {
+public:
+    // A consistent-enough copy of one class's totals; rates are NaN with no data
+    struct Totals {
+        size_t enrolled = 0;
+        size_t graded = 0;            // grades contributing to the average
+        double averageGrade = std::numeric_limits<double>::quiet_NaN();
+        size_t sessionsRecorded = 0;  // attendance marks, present or absent
+        double attendanceRate = std::numeric_limits<double>::quiet_NaN();
+    };
+
+    void EnsureClasses(size_t count) {
+        std::unique_lock<std::shared_mutex> lock(mutex);
+        while (slots.size() < count) slots.emplace_back(new Slot());
+    }
+
+    void AddEnrollment(uint32_t classId, int64_t delta = 1) {
+        Update(classId, [&](Slot& slot) { slot.enrolled += delta; });
+    }
+
+    // Add (count 1) or remove (count -1) a grade from the class average
+    void AddGrade(uint32_t classId, double grade, int64_t count = 1) {
+        int64_t milli = static_cast<int64_t>(std::llround(grade * 1000.0));
+        Update(classId, [&](Slot& slot) {
+            slot.gradeMilliSum += milli * count;
+            slot.gradeCount += count;
+        });
+    }
+
+    // Record attendance marks: present of recorded sessions attended
+    void AddAttendance(uint32_t classId, int64_t present, int64_t recorded) {
+        Update(classId, [&](Slot& slot) {
+            slot.present += present;
+            slot.recorded += recorded;
+        });
+    }
+
+    Totals Get(uint32_t classId) const { return Get(&classId, 1); }
+
+    // Combined totals of several classes, in O(count): enrollments add up,
+    // and the rates are over every grade and mark in them
+    Totals Get(const uint32_t* classIds, size_t count) const {
+        Totals totals;
+        int64_t enrolled = 0, gradeMilliSum = 0, graded = 0, present = 0, recorded = 0;
+        std::shared_lock<std::shared_mutex> lock(mutex);
+        for (size_t i = 0; i < count; ++i) {
+            if (classIds[i] >= slots.size()) continue;
+            const Slot& slot = *slots[classIds[i]];
+            enrolled += slot.enrolled.load();
+            gradeMilliSum += slot.gradeMilliSum.load();
+            graded += slot.gradeCount.load();
+            present += slot.present.load();
+            recorded += slot.recorded.load();
+        }
+        totals.enrolled = static_cast<size_t>(std::max<int64_t>(0, enrolled));
+        totals.graded = static_cast<size_t>(std::max<int64_t>(0, graded));
+        if (graded > 0) totals.averageGrade = gradeMilliSum / 1000.0 / graded;
+        totals.sessionsRecorded = static_cast<size_t>(std::max<int64_t>(0, recorded));
+        if (recorded > 0) totals.attendanceRate = static_cast<double>(present) / recorded;
+        return totals;
+    }
+
+private:
+    struct Slot {
+        std::atomic<int64_t> enrolled{0};
+        std::atomic<int64_t> gradeMilliSum{0};
+        std::atomic<int64_t> gradeCount{0};
+        std::atomic<int64_t> present{0};
+        std::atomic<int64_t> recorded{0};
+    };
+
+    mutable std::shared_mutex mutex;
+    std::vector<std::unique_ptr<Slot>> slots; // by class ID
+
+    template <typename F>
+    void Update(uint32_t classId, F apply) {
+        std::shared_lock<std::shared_mutex> lock(mutex);
+        if (classId < slots.size()) apply(*slots[classId]);
+    }
+};
+
+// Append-only log of live classroom activity (joins, leaves, raised hands,
+// chat, reactions), kept per class in fixed time partitions of kPartitionMs.
+// Within a partition each event is three varints: the zigzag-encoded delta
+// from the previous event's timestamp (so late arrivals still append), the
+// event type's code in a shared dictionary, and the student ID. A typical
+// event takes 4-5 bytes. Range scans binary-search the partitions and decode
+// only those overlapping the window; retention drops whole partitions from
+// the front, O(1) each.
+//
+// With a directory, each partition is also a file, <class>-<start>.events,
+// holding exactly its in-memory bytes, and the type dictionary is types.txt;
+// dropping a partition deletes its file. A torn final event is cut off on
+// load. Without one, events live only in memory.
+class ClassEventStore {
+public:
+    static constexpr int64_t kPartitionMs = 3600 * 1000;
+    static constexpr uint32_t kNoStudent = 0xFFFFFFFFu;
+
+    struct Stats {
+        size_t partitions = 0;
+        size_t events = 0;
+        size_t bytes = 0;       // encoded events
+        size_t types = 0;
+    };
+
+    explicit ClassEventStore(const std::string& directory = "") : dir(directory) {
+        if (!dir.empty()) Load();
+    }
+
+    ~ClassEventStore() {
+        for (auto& partitions : classes) {
+            for (auto& partition : partitions) {
+                if (partition.file) std::fclose(partition.file);
+            }
+        }
+        if (typesFile) std::fclose(typesFile);
+    }
+
+    ClassEventStore(const ClassEventStore&) = delete;
+    ClassEventStore& operator=(const ClassEventStore&) = delete;
+
+    // Record an event at time (milliseconds since the epoch)
+    void Append(uint32_t classId, int64_t time, const std::string& type, uint32_t studentId) {
+        std::unique_lock<std::shared_mutex> lock(mutex);
+        uint32_t code = TypeCode(type);
+        if (classId >= classes.size()) classes.resize(classId + 1);
+        Partition& partition = PartitionFor(classes[classId], classId, time);
+        size_t offset = partition.bytes.size();
+        PutVarint(partition.bytes, ZigZag(time - partition.last));
+        PutVarint(partition.bytes, code);
+        PutVarint(partition.bytes, studentId);
+        partition.last = time;
+        ++partition.count;
+        if (partition.file) {
+            std::fwrite(partition.bytes.data() + offset, 1, partition.bytes.size() - offset, partition.file);
+            std::fflush(partition.file);
+        }
+    }
+
+    // Call fn(time, type, studentId) for each event of a class in [from, to),
+    // in append order within each partition and partitions in time order.
+    // An empty type matches every event. Returns the number of matches.
+    template <typename F>
+    size_t Scan(uint32_t classId, int64_t from, int64_t to, const std::string& type, F fn) const {
+        std::shared_lock<std::shared_mutex> lock(mutex);
+        if (classId >= classes.size() || from >= to) return 0;
+        uint64_t wanted = 0;
+        if (!type.empty()) {
+            auto code = codes.find(type);
+            if (code == codes.end()) return 0;
+            wanted = code->second + 1;
+        }
+        const auto& partitions = classes[classId];
+        auto first = std::upper_bound(partitions.begin(), partitions.end(), from - kPartitionMs,
+                                      [](int64_t t, const Partition& p) { return t < p.start; });
+        size_t matched = 0;
+        for (auto p = first; p != partitions.end() && p->start < to; ++p) {
+            const char* pos = p->bytes.data();
+            const char* end = pos + p->bytes.size();
+            int64_t time = p->start;
+            uint64_t delta, code, student;
+            while (GetVarint(pos, end, delta) && GetVarint(pos, end, code) && GetVarint(pos, end, student)) {
+                time += UnZigZag(delta);
+                if (time < from || time >= to || (wanted && code + 1 != wanted)) continue;
+                ++matched;
+                fn(time, types[code], static_cast<uint32_t>(student));
+            }
+        }
+        return matched;
+    }
+
+    // Drop every partition, in any class, that ends at or before time
+    size_t DropBefore(int64_t time) {
+        std::unique_lock<std::shared_mutex> lock(mutex);
+        size_t dropped = 0;
+        for (size_t c = 0; c < classes.size(); ++c) {
+            auto& partitions = classes[c];
+            while (!partitions.empty() && partitions.front().start + kPartitionMs <= time) {
+                Partition& oldest = partitions.front();
+                if (oldest.file) {
+                    std::fclose(oldest.file);
+                    std::remove(PartitionPath(static_cast<uint32_t>(c), oldest.start).c_str());
+                }
+                partitions.pop_front();
+                ++dropped;
+            }
+        }
+        return dropped;
+    }
+
+    Stats GetStats() const {
+        std::shared_lock<std::shared_mutex> lock(mutex);
+        Stats stats;
+        stats.types = types.size();
+        for (const auto& partitions : classes) {
+            stats.partitions += partitions.size();
+            for (const auto& partition : partitions) {
+                stats.events += partition.count;
+                stats.bytes += partition.bytes.size();
+            }
+        }
+        return stats;
+    }
+
+private:
+    struct Partition {
+        int64_t start = 0;      // multiple of kPartitionMs; also the delta base
+        int64_t last = 0;       // timestamp of the latest event appended
+        size_t count = 0;
+        std::string bytes;
+        std::FILE* file = nullptr;
+    };
+
+    std::string dir;
+    mutable std::shared_mutex mutex;
+    std::vector<std::deque<Partition>> classes; // by class ID, partitions by start
+    std::vector<std::string> types;
+    std::unordered_map<std::string, uint32_t> codes;
+    std::FILE* typesFile = nullptr;
+
+    static uint64_t ZigZag(int64_t v) { return (static_cast<uint64_t>(v) << 1) ^ static_cast<uint64_t>(v >> 63); }
+    static int64_t UnZigZag(uint64_t v) { return static_cast<int64_t>(v >> 1) ^ -static_cast<int64_t>(v & 1); }
+
+    static void PutVarint(std::string& out, uint64_t v) {
+        while (v >= 0x80) {
+            out += static_cast<char>((v & 0x7F) | 0x80);
+            v >>= 7;
+        }
+        out += static_cast<char>(v);
+    }
+
+    static bool GetVarint(const char*& pos, const char* end, uint64_t& v) {
+        v = 0;
+        for (unsigned shift = 0; pos < end && shift < 64; shift += 7) {
+            uint8_t byte = static_cast<uint8_t>(*pos++);
+            v |= uint64_t(byte & 0x7F) << shift;
+            if (!(byte & 0x80)) return true;
+        }
+        return false;
+    }
+
+    static int64_t PartitionStart(int64_t time) {
+        int64_t start = time / kPartitionMs * kPartitionMs;
+        return start > time ? start - kPartitionMs : start;
+    }
+
+    std::string PartitionPath(uint32_t classId, int64_t start) const {
+        return dir + "/" + std::to_string(classId) + "-" + std::to_string(start) + ".events";
+    }
+
+    uint32_t TypeCode(const std::string& type) {
+        auto found = codes.find(type);
+        if (found != codes.end()) return found->second;
+        uint32_t code = static_cast<uint32_t>(types.size());
+        types.push_back(type);
+        codes.emplace(type, code);
+        if (typesFile) {
+            std::fprintf(typesFile, "%s\n", type.c_str());
+            std::fflush(typesFile);
+        }
+        return code;
+    }
+
+    // The partition holding time, created in order if missing; live events
+    // almost always land in the newest one
+    Partition& PartitionFor(std::deque<Partition>& partitions, uint32_t classId, int64_t time) {
+        int64_t start = PartitionStart(time);
+        if (!partitions.empty() && partitions.back().start == start) return partitions.back();
+        auto at = std::lower_bound(partitions.begin(), partitions.end(), start,
+                                   [](const Partition& p, int64_t s) { return p.start < s; });
+        if (at != partitions.end() && at->start == start) return *at;
+        Partition fresh;
+        fresh.start = fresh.last = start;
+        if (!dir.empty()) fresh.file = std::fopen(PartitionPath(classId, start).c_str(), "ab");
+        return *partitions.insert(at, std::move(fresh));
+    }
+
+    void Load() {
+        std::filesystem::create_directories(dir);
+        std::ifstream typesIn(dir + "/types.txt");
+        std::string line;
+        while (std::getline(typesIn, line)) {
+            codes.emplace(line, static_cast<uint32_t>(types.size()));
+            types.push_back(line);
+        }
+        typesIn.close();
+        typesFile = std::fopen((dir + "/types.txt").c_str(), "a");
+
+        std::vector<std::pair<uint32_t, int64_t>> found;
+        for (const auto& entry : std::filesystem::directory_iterator(dir)) {
+            std::string name = entry.path().filename().string();
+            unsigned long classId;
+            long long start;
+            char tail[16] = {};
+            if (std::sscanf(name.c_str(), "%lu-%lld.%15s", &classId, &start, tail) == 3 && std::string(tail) == "events") {
+                found.emplace_back(static_cast<uint32_t>(classId), start);
+            }
+        }
+        std::sort(found.begin(), found.end());
+        for (const auto& file : found) {
+            std::string path = PartitionPath(file.first, file.second);
+            std::ifstream in(path, std::ios::binary);
+            Partition partition;
+            partition.start = partition.last = file.second;
+            partition.bytes.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+            in.close();
+            // Keep whole events whose type is known; cut anything after
+            const char* pos = partition.bytes.data();
+            const char* end = pos + partition.bytes.size();
+            const char* good = pos;
+            uint64_t delta, code, student;
+            while (GetVarint(pos, end, delta) && GetVarint(pos, end, code) && GetVarint(pos, end, student)
+                   && code < types.size()) {
+                partition.last += UnZigZag(delta);
+                ++partition.count;
+                good = pos;
+            }
+            if (good != end) {
+                partition.bytes.resize(good - partition.bytes.data());
+                std::filesystem::resize_file(path, partition.bytes.size());
+            }
+            partition.file = std::fopen(path.c_str(), "ab");
+            if (file.first >= classes.size()) classes.resize(file.first + 1);
+            classes[file.first].push_back(std::move(partition));
+        }
+    }
+};
+
+// Live participation per student over classroom events. Each member has a
+// ring of kPanes panes of kPaneMs; an event adds its weight to the pane for
+// its time, first zeroing any panes the ring has moved past, so an update
+// costs at most kPanes steps however long the student was quiet. The sliding
+// score is the sum of the panes inside the last kWindowMs (the ring keeps a
+// running total and subtracts panes that have aged out at query time).
+// Alongside, a tumbling window of the same length aligned to the epoch keeps
+// the total of the last completed window.
+//
+// Events older than the ring are ignored. Members are rows in enrollment
+// order, so students nobody has heard from score zero.
+class EngagementWindows {
+public:
+    static constexpr int64_t kPaneMs = 30 * 1000;
+    static constexpr size_t kPanes = 10;
+    static constexpr int64_t kWindowMs = kPaneMs * kPanes; // five minutes
+
+    struct Score {
+        uint32_t studentId;
+        uint32_t sliding;       // weight in the last kWindowMs
+        uint32_t lastTumbling;  // weight in the last completed tumbling window
+    };
+
+    // How much an event type says about participation
+    static uint32_t Weight(const std::string& type) {
+        if (type == "hand") return 3;
+        if (type == "chat" || type == "answer") return 2;
+        if (type == "reaction") return 1;
+        return 0;
+    }
+
+    void AddMember(uint32_t classId, uint32_t studentId) {
+        std::unique_lock<std::shared_mutex> lock(mutex);
+        if (classId >= classes.size()) classes.resize(classId + 1);
+        ClassWindows& book = classes[classId];
+        if (book.rowOf.emplace(studentId, static_cast<uint32_t>(book.members.size())).second) {
+            book.members.push_back(studentId);
+            book.rings.emplace_back();
+        }
+    }
+
+    void RemoveMember(uint32_t classId, uint32_t studentId) {
+        std::unique_lock<std::shared_mutex> lock(mutex);
+        if (classId >= classes.size()) return;
+        ClassWindows& book = classes[classId];
+        auto found = book.rowOf.find(studentId);
+        if (found == book.rowOf.end()) return;
+        uint32_t row = found->second;
+        book.members.erase(book.members.begin() + row);
+        book.rings.erase(book.rings.begin() + row);
+        book.rowOf.erase(found);
+        for (uint32_t r = row; r < book.members.size(); ++r) book.rowOf[book.members[r]] = r;
+    }
+
+    void Observe(uint32_t classId, uint32_t studentId, int64_t time, uint32_t weight) {
+        if (weight == 0) return;
+        std::unique_lock<std::shared_mutex> lock(mutex);
+        if (classId >= classes.size()) return;
+        auto row = classes[classId].rowOf.find(studentId);
+        if (row == classes[classId].rowOf.end()) return;
+        Ring& ring = classes[classId].rings[row->second];
+
+        int64_t pane = FloorDiv(time, kPaneMs);
+        if (pane > ring.head) {
+            // Zero the panes moved past; a long silence clears the whole ring
+            int64_t steps = std::min<int64_t>(pane - ring.head, kPanes);
+            for (int64_t p = pane - steps + 1; p <= pane; ++p) {
+                uint32_t& slot = ring.panes[Slot(p)];
+                ring.total -= slot;
+                slot = 0;
+            }
+            ring.head = pane;
+        } else if (pane <= ring.head - static_cast<int64_t>(kPanes)) {
+            return; // older than the ring
+        }
+        ring.panes[Slot(pane)] += weight;
+        ring.total += weight;
+
+        int64_t tumble = FloorDiv(time, kWindowMs);
+        if (tumble > ring.tumble) {
+            ring.previous = tumble == ring.tumble + 1 ? ring.current : 0;
+            ring.current = 0;
+            ring.tumble = tumble;
+        }
+        if (tumble == ring.tumble) ring.current += weight;
+        else if (tumble == ring.tumble - 1) ring.previous += weight;
+    }
+
+    Score Get(uint32_t classId, uint32_t studentId, int64_t now) const {
+        std::shared_lock<std::shared_mutex> lock(mutex);
+        Score score{studentId, 0, 0};
+        if (classId >= classes.size()) return score;
+        auto row = classes[classId].rowOf.find(studentId);
+        if (row != classes[classId].rowOf.end()) score = Evaluate(classes[classId].rings[row->second], studentId, now);
+        return score;
+    }
+
+    // The k members with the lowest sliding scores at now, lowest first (ties
+    // by the earlier tumbling window, then student ID)
+    std::vector<Score> LeastEngaged(uint32_t classId, int64_t now, size_t k) const {
+        std::shared_lock<std::shared_mutex> lock(mutex);
+        std::vector<Score> lowest;
+        if (classId >= classes.size() || k == 0) return lowest;
+        const ClassWindows& book = classes[classId];
+        auto before = [](const Score& a, const Score& b) {
+            return std::tie(a.sliding, a.lastTumbling, a.studentId) < std::tie(b.sliding, b.lastTumbling, b.studentId);
+        };
+        // Max-heap of the k lowest seen so far
+        for (size_t row = 0; row < book.members.size(); ++row) {
+            Score score = Evaluate(book.rings[row], book.members[row], now);
+            if (lowest.size() < k) {
+                lowest.push_back(score);
+                std::push_heap(lowest.begin(), lowest.end(), before);
+            } else if (before(score, lowest.front())) {
+                std::pop_heap(lowest.begin(), lowest.end(), before);
+                lowest.back() = score;
+                std::push_heap(lowest.begin(), lowest.end(), before);
+            }
+        }
+        std::sort_heap(lowest.begin(), lowest.end(), before);
+        return lowest;
+    }
+
+private:
+    struct Ring {
+        int64_t head = std::numeric_limits<int64_t>::min() / 2; // newest pane written
+        uint32_t total = 0;                                      // sum of panes
+        uint32_t panes[kPanes] = {};
+        int64_t tumble = std::numeric_limits<int64_t>::min() / 2; // current tumbling window
+        uint32_t current = 0;
+        uint32_t previous = 0;                                    // the window before it
+    };
+
+    struct ClassWindows {
+        std::vector<uint32_t> members;
+        std::unordered_map<uint32_t, uint32_t> rowOf;
+        std::vector<Ring> rings; // by row
+    };
+
+    mutable std::shared_mutex mutex;
+    std::vector<ClassWindows> classes; // by class ID
+
+    static int64_t FloorDiv(int64_t a, int64_t b) { return a >= 0 ? a / b : (a - b + 1) / b; }
+    static size_t Slot(int64_t pane) { return static_cast<size_t>(((pane % int64_t(kPanes)) + int64_t(kPanes)) % int64_t(kPanes)); }
+
+    static Score Evaluate(const Ring& ring, uint32_t studentId, int64_t now) {
+        Score score{studentId, 0, 0};
+        int64_t pane = FloorDiv(now, kPaneMs);
+        int64_t age = pane - ring.head;
+        if (age < static_cast<int64_t>(kPanes)) {
+            score.sliding = ring.total;
+            // Subtract the panes that have slid out since the last event
+            for (int64_t p = ring.head - static_cast<int64_t>(kPanes) + 1; p <= ring.head - static_cast<int64_t>(kPanes) + age; ++p) {
+                score.sliding -= ring.panes[Slot(p)];
+            }
+        }
+        int64_t tumble = FloorDiv(now, kWindowMs);
+        if (tumble == ring.tumble) score.lastTumbling = ring.previous;
+        else if (tumble == ring.tumble + 1) score.lastTumbling = ring.current;
+        return score;
+    }
+};
+
+// Bookings of one student, teacher or room over the week. Every booking is
+// checked before it goes in, so bookings never overlap and a map ordered by
+// start is all the interval index needs: the only booking that can overlap
+// [start, end) is the last one starting before end, since every earlier one
+// ends before that one starts. Queries and updates are O(log n).
+class IntervalIndex {
+public:
+    // A class booked over part of [start, end) other than ignoreClass, or -1
+    int64_t Overlap(int start, int end, uint32_t ignoreClass = 0xFFFFFFFFu) const {
+        auto next = bookings.lower_bound(end);
+        while (next != bookings.begin()) {
+            --next;
+            if (next->second.end <= start) return -1;
+            if (next->second.classId != ignoreClass) return next->second.classId;
+            // The ignored class's own meeting; keep looking before it
+        }
+        return -1;
+    }
+
+    // Book [start, end) for a class; false (and nothing booked) on overlap
+    bool Insert(int start, int end, uint32_t classId) {
+        if (Overlap(start, end) >= 0) return false;
+        bookings.emplace(start, Booking{end, classId});
+        return true;
+    }
+
+    void Erase(int start, uint32_t classId) {
+        auto found = bookings.find(start);
+        if (found != bookings.end() && found->second.classId == classId) bookings.erase(found);
+    }
+
+    size_t Size() const { return bookings.size(); }
+
+private:
+    struct Booking {
+        int end;
+        uint32_t classId;
+    };
+    std::map<int, Booking> bookings; // by start
+};
+
+// A double booking: resource is "student <name>", "teacher <name>" or
+// "room <name>"; classId's meeting `when` overlaps one of otherClass's. A
+// schedule whose own meetings overlap has resource "class" and otherClass
+// equal to classId.
+struct TimetableConflict {
+    std::string resource;
+    uint32_t classId = 0;
+    uint32_t otherClass = 0;
+    Meeting when;
+};
+
+// Result of checking a whole timetable
+struct TimetableReport {
+    std::vector<TimetableConflict> conflicts;
+    size_t studentsChecked = 0;
+    unsigned threads = 1;
+    double milliseconds = 0;
+};
+
+// The interval indexes behind enrollment and scheduling checks: one per
+// student, teacher and room, plus each class's members so a reschedule can
+// recheck them. Rebuilt from the roster at startup; the Model's writer is
+// the only user, so there is no lock of its own.
+class TimetableIndex {
+public:
+    void AddMember(uint32_t classId, uint32_t studentId) {
+        if (classId >= members.size()) members.resize(classId + 1);
+        members[classId].push_back(studentId);
+    }
+
+    // Would studentId be double-booked by attending meetings of classId?
+    bool CheckStudent(uint32_t classId, uint32_t studentId, const std::vector<Meeting>& meetings, int64_t& otherClass, Meeting& when) const {
+        auto index = students.find(studentId);
+        if (index == students.end()) return true;
+        for (const Meeting& meeting : meetings) {
+            otherClass = index->second.Overlap(meeting.start, meeting.end, classId);
+            if (otherClass >= 0) {
+                when = meeting;
+                return false;
+            }
+        }
+        return true;
+    }
+
+    void BookStudent(uint32_t classId, uint32_t studentId, const std::vector<Meeting>& meetings) {
+        for (const Meeting& meeting : meetings) students[studentId].Insert(meeting.start, meeting.end, classId);
+    }
+
+    // A student dropped classId, which meets at meetings
+    void RemoveMember(uint32_t classId, uint32_t studentId, const std::vector<Meeting>& meetings) {
+        if (classId < members.size()) {
+            auto& enrolled = members[classId];
+            auto found = std::find(enrolled.begin(), enrolled.end(), studentId);
+            if (found != enrolled.end()) enrolled.erase(found);
+        }
+        auto index = students.find(studentId);
+        if (index == students.end()) return;
+        for (const Meeting& meeting : meetings) index->second.Erase(meeting.start, classId);
+    }
+
+    // Move a class from its old schedule to next, unless next's meetings
+    // overlap each other or it would double-book its teacher, its room or one
+    // of its students. On a conflict nothing changes and conflict says what
+    // clashed; describe names a student ID for the message.
+    template <typename Describe>
+    bool Reschedule(uint32_t classId, const ClassSchedule& old, const ClassSchedule& next,
+                    TimetableConflict& conflict, Describe describe) {
+        if (MeetingsOverlap(next.meetings, conflict.when)) {
+            conflict.resource = "class";
+            conflict.classId = classId;
+            conflict.otherClass = classId;
+            return false;
+        }
+        Book(classId, old, false);
+        const std::vector<uint32_t> none;
+        const std::vector<uint32_t>& enrolled = classId < members.size() ? members[classId] : none;
+        for (const Meeting& meeting : next.meetings) {
+            int64_t other = -1;
+            if (!next.teacher.empty() && (other = teachers[next.teacher].Overlap(meeting.start, meeting.end)) >= 0) {
+                conflict.resource = "teacher " + next.teacher;
+            } else if (!next.room.empty() && (other = rooms[next.room].Overlap(meeting.start, meeting.end)) >= 0) {
+                conflict.resource = "room " + next.room;
+            } else {
+                for (uint32_t studentId : enrolled) {
+                    auto index = students.find(studentId);
+                    if (index != students.end() && (other = index->second.Overlap(meeting.start, meeting.end)) >= 0) {
+                        conflict.resource = "student " + describe(studentId);
+                        break;
+                    }
+                }
+            }
+            if (other >= 0) {
+                conflict.classId = classId;
+                conflict.otherClass = static_cast<uint32_t>(other);
+                conflict.when = meeting;
+                Book(classId, old, true);
+                return false;
+            }
+        }
+        Book(classId, next, true);
+        return true;
+    }
+
+    // Index a schedule loaded from disk; bookings that would overlap are left
+    // out and counted
+    void Load(uint32_t classId, const ClassSchedule& schedule) { Book(classId, schedule, true); }
+
+    size_t LoadConflicts() const { return skipped; }
+
+private:
+    std::unordered_map<uint32_t, IntervalIndex> students;
+    std::unordered_map<std::string, IntervalIndex> teachers, rooms;
+    std::vector<std::vector<uint32_t>> members; // by class ID
+    size_t skipped = 0;
+
+    // Add (or remove) every booking a schedule implies
+    void Book(uint32_t classId, const ClassSchedule& schedule, bool add) {
+        const std::vector<uint32_t> none;
+        const std::vector<uint32_t>& enrolled = classId < members.size() ? members[classId] : none;
+        for (const Meeting& meeting : schedule.meetings) {
+            std::vector<IntervalIndex*> indexes;
+            if (!schedule.teacher.empty()) indexes.push_back(&teachers[schedule.teacher]);
+            if (!schedule.room.empty()) indexes.push_back(&rooms[schedule.room]);
+            for (uint32_t studentId : enrolled) indexes.push_back(&students[studentId]);
+            for (IntervalIndex* index : indexes) {
+                if (!add) index->Erase(meeting.start, classId);
+                else if (!index->Insert(meeting.start, meeting.end, classId)) ++skipped;
+            }
+        }
+    }
+};
+
+// Check a whole timetable without the indexes: every student's classes (and
+// every teacher's and room's) are swept in start order for overlaps.
+// Students are split across up to maxThreads threads (0: every core); each
+// pair of classes is reported once per student, teacher or room.
+inline TimetableReport ValidateTimetable(const PagedList<std::string>& classes, const PagedList<std::string>& students,
+                                         const PagedList<Enrollment>& enrollments, const ScheduleBook& schedules,
+                                         unsigned maxThreads) {
+    using Clock = std::chrono::steady_clock;
+    auto started = Clock::now();
+    TimetableReport report;
+    std::vector<ClassSchedule> byClass(classes.size());
+    schedules.Read([&](const ScheduleBook& book) {
+        for (size_t c = 0; c < byClass.size() && c < book.Classes(); ++c) byClass[c] = *book.Class(static_cast<uint32_t>(c));
+    });
+    // Classes per student, bucketed from the enrollment list
+    std::vector<std::vector<uint32_t>> classesOf(students.size());
+    for (const auto& e : enrollments) {
+        if (e.studentId < classesOf.size()) classesOf[e.studentId].push_back(e.classId);
+    }
+
+    struct Slot {
+        Meeting when;
+        uint32_t classId;
+    };
+    // Overlapping pairs among one resource's classes
+    auto sweep = [&](const std::string& resource, const std::vector<uint32_t>& classIds, std::vector<TimetableConflict>& out) {
+        std::vector<Slot> slots;
+        for (uint32_t classId : classIds) {
+            for (const Meeting& meeting : byClass[classId].meetings) slots.push_back({meeting, classId});
+        }
+        if (slots.size() < 2) return;
+        std::sort(slots.begin(), slots.end(), [](const Slot& a, const Slot& b) { return a.when.start < b.when.start; });
+        std::set<std::pair<uint32_t, uint32_t>> reported;
+        Slot latest = slots[0]; // the slot reaching furthest so far
+        for (size_t i = 1; i < slots.size(); ++i) {
+            const Slot& slot = slots[i];
+            if (slot.when.start < latest.when.end && slot.classId != latest.classId
+                && reported.emplace(std::min(slot.classId, latest.classId), std::max(slot.classId, latest.classId)).second) {
+                out.push_back({resource, slot.classId, latest.classId, slot.when});
+            }
+            if (slot.when.end > latest.when.end) latest = slot;
+        }
+    };
+
+    unsigned cores = std::max(1u, std::thread::hardware_concurrency());
+    unsigned threads = std::max(1u, std::min<unsigned>(maxThreads ? maxThreads : cores,
+                                                      static_cast<unsigned>(students.size() / 1024 + 1)));
+    std::vector<std::vector<TimetableConflict>> found(threads);
+    auto check = [&](unsigned t) {
+        size_t begin = students.size() * t / threads, end = students.size() * (t + 1) / threads;
+        for (size_t s = begin; s < end; ++s) {
+            if (classesOf[s].size() > 1) sweep("student " + students[s], classesOf[s], found[t]);
+        }
+    };
+    std::vector<std::thread> workers;
+    for (unsigned t = 1; t < threads; ++t) workers.emplace_back(check, t);
+    check(0);
+    for (auto& worker : workers) worker.join();
+    for (auto& part : found) report.conflicts.insert(report.conflicts.end(), part.begin(), part.end());
+
+    std::map<std::string, std::vector<uint32_t>> teachers, rooms;
+    for (size_t c = 0; c < byClass.size(); ++c) {
+        if (!byClass[c].teacher.empty()) teachers[byClass[c].teacher].push_back(static_cast<uint32_t>(c));
+        if (!byClass[c].room.empty()) rooms[byClass[c].room].push_back(static_cast<uint32_t>(c));
+    }
+    for (const auto& teacher : teachers) sweep("teacher " + teacher.first, teacher.second, report.conflicts);
+    for (const auto& room : rooms) sweep("room " + room.first, room.second, report.conflicts);
+
+    report.studentsChecked = students.size();
+    report.threads = threads;
+    report.milliseconds = std::chrono::duration<double, std::milli>(Clock::now() - started).count();
+    return report;
+}
+
+// A term timetable to build: classes needing weekly meetings, the rooms they
+// may use, and the candidate meeting starts. Built from the Model's classes.
+struct TimetableProblem {
+    struct Class {
+        uint32_t classId;
+        std::string teacher;            // empty: none assigned
+        uint32_t size;                  // students enrolled
+        int meetings;                   // weekly meetings to place
+    };
+
+    std::vector<Class> classes;
+    std::vector<std::pair<std::string, uint32_t>> rooms; // name, seats
+    std::vector<int> slots;             // meeting starts, minutes since Monday
+    int meetingMinutes = 50;
+    std::map<std::string, std::vector<Meeting>> availability; // teachers with limited hours
+    std::vector<std::vector<uint32_t>> studentsOf;             // by class index, sorted student IDs
+
+    // Mon-Fri, hourly from 08:00, eight periods a day
+    void UseStandardWeek() {
+        slots.clear();
+        for (int day = 0; day < 5; ++day) {
+            for (int period = 0; period < 8; ++period) slots.push_back(day * 1440 + 8 * 60 + period * 60);
+        }
+    }
+};
+
+// Best timetable found and how its quality improved. Violations are hard
+// constraints broken: a room, teacher or student in two places at once, a
+// room too small, a teacher outside their hours. Penalty counts soft ones: a
+// class meeting twice on the same day.
+struct TimetableSolution {
+    struct Progress {
+        double milliseconds;
+        size_t violations;
+        size_t penalty;
+        unsigned thread;                // which portfolio member found it
+    };
+
+    std::vector<uint16_t> roomOf;                 // by class index
+    std::vector<std::vector<uint16_t>> slotsOf;   // by class index, one per meeting
+    size_t violations = 0;
+    size_t penalty = 0;
+    std::vector<Progress> timeline;
+    uint64_t moves = 0;
+    unsigned threads = 1;
+
+    // The schedule for class index c
+    ClassSchedule Schedule(const TimetableProblem& problem, size_t c) const {
+        ClassSchedule schedule;
+        schedule.teacher = problem.classes[c].teacher;
+        if (!problem.rooms.empty()) schedule.room = problem.rooms[roomOf[c]].first;
+        for (uint16_t slot : slotsOf[c]) {
+            schedule.meetings.push_back({problem.slots[slot], problem.slots[slot] + problem.meetingMinutes});
+        }
+        std::sort(schedule.meetings.begin(), schedule.meetings.end(), [](const Meeting& a, const Meeting& b) { return a.start < b.start; });
+        return schedule;
+    }
+};
+
+// Portfolio local search for a TimetableProblem. Every thread runs its own
+// simulated annealing from a greedy start, with its own seed and starting
+// temperature, until the deadline or until any of them reaches cost 0; the
+// best timetable any of them reaches is kept, and each improvement is logged. A move re-places one meeting, gives a
+// class another room, or swaps two meetings' slots; its cost change is
+// computed from per-slot occupancy counts and a matrix of students shared
+// between classes, so a move costs O(classes meeting in the slot).
+class TimetableSolver {
+public:
+    static constexpr int64_t kHard = 1000; // one violation outweighs any soft penalty
+
+    explicit TimetableSolver(const TimetableProblem& problem) : problem(problem) {
+        const size_t n = problem.classes.size();
+        std::map<std::string, uint16_t> teacherIds;
+        teacherOf.assign(n, -1);
+        for (size_t c = 0; c < n; ++c) {
+            const std::string& teacher = problem.classes[c].teacher;
+            if (!teacher.empty()) teacherOf[c] = teacherIds.emplace(teacher, static_cast<uint16_t>(teacherIds.size())).first->second;
+        }
+        teachers = teacherIds.size();
+        // Students shared by each pair of classes, counted from each student's classes
+        shared.assign(n * n, 0);
+        std::unordered_map<uint32_t, std::vector<uint32_t>> classesOf;
+        for (size_t c = 0; c < n && c < problem.studentsOf.size(); ++c) {
+            for (uint32_t studentId : problem.studentsOf[c]) classesOf[studentId].push_back(static_cast<uint32_t>(c));
+        }
+        for (const auto& student : classesOf) {
+            const std::vector<uint32_t>& mine = student.second;
+            for (size_t i = 0; i < mine.size(); ++i) {
+                for (size_t j = i + 1; j < mine.size(); ++j) {
+                    uint16_t& count = shared[mine[i] * n + mine[j]];
+                    if (count < 0xFFFF) shared[mine[j] * n + mine[i]] = ++count;
+                }
+            }
+        }
+        // Slots each class's teacher can take; a teacher with no hours that fit is left unconstrained
+        available.assign(n, std::vector<char>(problem.slots.size(), 1));
+        for (size_t c = 0; c < n; ++c) {
+            auto hours = problem.availability.find(problem.classes[c].teacher);
+            if (hours == problem.availability.end() || hours->second.empty()) continue;
+            bool any = false;
+            for (size_t s = 0; s < problem.slots.size(); ++s) {
+                int start = problem.slots[s], end = start + problem.meetingMinutes;
+                available[c][s] = std::any_of(hours->second.begin(), hours->second.end(),
+                                              [&](const Meeting& m) { return m.start <= start && end <= m.end; });
+                any = any || available[c][s];
+            }
+            if (!any) available[c].assign(problem.slots.size(), 1);
+        }
+    }
+
+    TimetableSolution Solve(double seconds, unsigned maxThreads) {
+        using Clock = std::chrono::steady_clock;
+        TimetableSolution best;
+        unsigned threads = std::max(1u, maxThreads ? maxThreads : std::thread::hardware_concurrency());
+        best.threads = threads;
+        if (problem.classes.empty() || problem.rooms.empty() || problem.slots.empty()) return best;
+        auto started = Clock::now();
+        auto deadline = started + std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(seconds));
+        int64_t bestCost = std::numeric_limits<int64_t>::max();
+        std::mutex bestMutex;
+        std::atomic<uint64_t> moves{0};
+        std::atomic<bool> solved{false}; // some worker reached cost 0; the rest stop too
+
+        auto run = [&](unsigned t) {
+            const double starts[] = {50.0, 200.0, 800.0, 3000.0};
+            State state(*this, 0x9E3779B97F4A7C15ull * (t + 1));
+            state.Greedy();
+            double initialTemperature = starts[t % 4];
+            int64_t localBest = std::numeric_limits<int64_t>::max();
+            uint64_t count = 0;
+            for (;;) {
+                if ((count & 1023) == 0) {
+                    auto now = Clock::now();
+                    if (now >= deadline || solved.load(std::memory_order_relaxed)) break;
+                    double progress = std::chrono::duration<double>(now - started).count() / seconds;
+                    state.temperature = initialTemperature * std::pow(0.001, progress);
+                }
+                ++count;
+                state.Step();
+                if (state.Cost() < localBest) {
+                    localBest = state.Cost();
+                    std::lock_guard<std::mutex> lock(bestMutex);
+                    if (localBest < bestCost) {
+                        bestCost = localBest;
+                        best.roomOf = state.roomOf;
+                        best.slotsOf = state.slotsOf;
+                        best.violations = static_cast<size_t>(state.violations);
+                        best.penalty = static_cast<size_t>(state.penalty);
+                        best.timeline.push_back({std::chrono::duration<double, std::milli>(Clock::now() - started).count(),
+                                                 best.violations, best.penalty, t});
+                    }
+                    if (localBest == 0) {
+                        solved.store(true, std::memory_order_relaxed);
+                        break;
+                    }
+                }
+            }
+            moves += count;
+        };
+        std::vector<std::thread> workers;
+        for (unsigned t = 1; t < threads; ++t) workers.emplace_back(run, t);
+        run(0);
+        for (auto& worker : workers) worker.join();
+        best.moves = moves.load();
+        return best;
+    }
+
+private:
+    const TimetableProblem& problem;
+    std::vector<int> teacherOf;                 // by class index; -1 for none
+    size_t teachers = 0;
+    std::vector<uint16_t> shared;               // n x n, students in common
+    std::vector<std::vector<char>> available;   // by class index and slot
+
+    // One annealing run's timetable with the occupancy counts behind its cost
+    struct State {
+        const TimetableSolver& solver;
+        const TimetableProblem& problem;
+        size_t n, slots, rooms, teacherStride;
+        std::vector<uint16_t> roomOf;
+        std::vector<std::vector<uint16_t>> slotsOf;
+        std::vector<uint16_t> roomCount;        // slot * rooms + room
+        std::vector<uint16_t> teacherCount;     // slot * teachers + teacher
+        std::vector<std::vector<uint32_t>> classesAt; // by slot, one entry per meeting
+        int64_t violations = 0, penalty = 0;
+        double temperature = 1.0;
+        uint64_t seed;
+
+        static constexpr uint16_t kUnplaced = 0xFFFF;
+
+        State(const TimetableSolver& owner, uint64_t start)
+            : solver(owner), problem(owner.problem), n(problem.classes.size()), slots(problem.slots.size()),
+              rooms(problem.rooms.size()), teacherStride(std::max<size_t>(1, owner.teachers)), roomOf(n, 0),
+              slotsOf(n), roomCount(slots * rooms, 0), teacherCount(slots * teacherStride, 0), classesAt(slots),
+              seed(start | 1) {}
+
+        int64_t Cost() const { return violations * kHard + penalty; }
+
+        uint64_t Next() {
+            seed ^= seed << 13; seed ^= seed >> 7; seed ^= seed << 17;
+            return seed;
+        }
+
+        bool Fits(size_t c, size_t room) const { return problem.rooms[room].second >= problem.classes[c].size; }
+
+        // Hard and soft cost of class c meeting in slot/room against everything
+        // else placed (the meeting itself must not be placed)
+        void MeetingCost(size_t c, size_t slot, size_t room, int64_t& hard, int64_t& soft) const {
+            hard = roomCount[slot * rooms + room];
+            if (solver.teacherOf[c] >= 0) hard += teacherCount[slot * teacherStride + solver.teacherOf[c]];
+            for (uint32_t other : classesAt[slot]) hard += other == c ? 1 : solver.shared[c * n + other];
+            if (!solver.available[c][slot]) ++hard;
+            soft = 0;
+            int day = problem.slots[slot] / 1440;
+            for (uint16_t mine : slotsOf[c]) {
+                if (mine != kUnplaced && problem.slots[mine] / 1440 == day) ++soft;
+            }
+        }
+
+        void Place(size_t c, size_t m, size_t slot) {
+            int64_t hard, soft;
+            MeetingCost(c, slot, roomOf[c], hard, soft);
+            violations += hard;
+            penalty += soft;
+            slotsOf[c][m] = static_cast<uint16_t>(slot);
+            ++roomCount[slot * rooms + roomOf[c]];
+            if (solver.teacherOf[c] >= 0) ++teacherCount[slot * teacherStride + solver.teacherOf[c]];
+            classesAt[slot].push_back(static_cast<uint32_t>(c));
+        }
+
+        void Unplace(size_t c, size_t m) {
+            size_t slot = slotsOf[c][m];
+            slotsOf[c][m] = kUnplaced;
+            --roomCount[slot * rooms + roomOf[c]];
+            if (solver.teacherOf[c] >= 0) --teacherCount[slot * teacherStride + solver.teacherOf[c]];
+            auto& here = classesAt[slot];
+            *std::find(here.begin(), here.end(), static_cast<uint32_t>(c)) = here.back();
+            here.pop_back();
+            int64_t hard, soft;
+            MeetingCost(c, slot, roomOf[c], hard, soft);
+            violations -= hard;
+            penalty -= soft;
+        }
+
+        void SetRoom(size_t c, size_t room) {
+            std::vector<uint16_t> placed = slotsOf[c];
+            for (size_t m = 0; m < placed.size(); ++m) Unplace(c, m);
+            if (!Fits(c, roomOf[c])) --violations;
+            roomOf[c] = static_cast<uint16_t>(room);
+            if (!Fits(c, room)) ++violations;
+            for (size_t m = 0; m < placed.size(); ++m) Place(c, m, placed[m]);
+        }
+
+        // Smallest room that fits each class (largest first), then each
+        // meeting in its cheapest slot
+        void Greedy() {
+            std::vector<size_t> order(n);
+            for (size_t c = 0; c < n; ++c) order[c] = c;
+            std::sort(order.begin(), order.end(), [&](size_t a, size_t b) { return problem.classes[a].size > problem.classes[b].size; });
+            for (size_t c : order) {
+                size_t room = 0;
+                for (size_t r = 0; r < rooms; ++r) {
+                    bool better = Fits(c, r) ? (!Fits(c, room) || problem.rooms[r].second < problem.rooms[room].second
+                                                || (problem.rooms[r].second == problem.rooms[room].second && Next() % 2))
+                                             : (!Fits(c, room) && problem.rooms[r].second > problem.rooms[room].second);
+                    if (better) room = r;
+                }
+                roomOf[c] = static_cast<uint16_t>(room);
+                if (!Fits(c, room)) ++violations;
+                slotsOf[c].assign(static_cast<size_t>(std::max(0, problem.classes[c].meetings)), kUnplaced);
+                for (size_t m = 0; m < slotsOf[c].size(); ++m) {
+                    size_t bestSlot = 0;
+                    int64_t bestCost = std::numeric_limits<int64_t>::max();
+                    size_t offset = static_cast<size_t>(Next() % slots);
+                    for (size_t i = 0; i < slots; ++i) {
+                        size_t slot = (i + offset) % slots;
+                        int64_t hard, soft;
+                        MeetingCost(c, slot, room, hard, soft);
+                        if (hard * kHard + soft < bestCost) {
+                            bestCost = hard * kHard + soft;
+                            bestSlot = slot;
+                        }
+                    }
+                    Place(c, m, bestSlot);
+                }
+            }
+        }
+
+        bool Accept(int64_t delta) {
+            if (delta <= 0) return true;
+            double p = std::exp(-static_cast<double>(delta) / std::max(1e-9, temperature));
+            return static_cast<double>(Next() % 1000000) < p * 1000000.0;
+        }
+
+        void Step() {
+            size_t c = static_cast<size_t>(Next() % n);
+            if (slotsOf[c].empty()) return;
+            int64_t before = Cost();
+            uint64_t kind = Next() % 10;
+            if (kind < 7) {
+                // Re-place one meeting
+                size_t m = static_cast<size_t>(Next() % slotsOf[c].size());
+                size_t from = slotsOf[c][m], to = static_cast<size_t>(Next() % slots);
+                if (to == from) return;
+                Unplace(c, m);
+                Place(c, m, to);
+                if (!Accept(Cost() - before)) {
+                    Unplace(c, m);
+                    Place(c, m, from);
+                }
+            } else if (kind < 9) {
+                // Another room, among those that fit when any do
+                size_t room = static_cast<size_t>(Next() % rooms), from = roomOf[c];
+                if (room == from || (!Fits(c, room) && Fits(c, from))) return;
+                SetRoom(c, room);
+                if (!Accept(Cost() - before)) SetRoom(c, from);
+            } else {
+                // Swap the slots of two meetings
+                size_t d = static_cast<size_t>(Next() % n);
+                if (d == c || slotsOf[d].empty()) return;
+                size_t m = static_cast<size_t>(Next() % slotsOf[c].size()), k = static_cast<size_t>(Next() % slotsOf[d].size());
+                size_t a = slotsOf[c][m], b = slotsOf[d][k];
+                if (a == b) return;
+                Unplace(c, m);
+                Unplace(d, k);
+                Place(c, m, b);
+                Place(d, k, a);
+                if (!Accept(Cost() - before)) {
+                    Unplace(c, m);
+                    Unplace(d, k);
+                    Place(c, m, a);
+                    Place(d, k, b);
+                }
+            }
+        }
+    };
+};
+
+enum class EnrollResult { Enrolled, AlreadyEnrolled, NoSuchClass, NoSuchStudent, ScheduleConflict, Waitlisted, AlreadyWaitlisted,
+                          MissingPrerequisite };
+
+enum class DropResult { Dropped, LeftWaitlist, NoSuchClass, NoSuchStudent, NotEnrolled };
+
+enum class PrerequisiteResult { Added, Removed, NoSuchClass, AlreadyRequired, NotRequired, Cycle };
+
+enum class OrganizationResult { Ok, NoSuchClass, NoSuchUnit, DuplicateUnit };
+
+enum class ScheduleResult { Ok, NoSuchClass, Conflict };
+
+enum class AddStudentResult { Added, AlreadyExists, NameTooLong };
+
+enum class GradebookResult { Ok, NoSuchClass, NoSuchStudent, NotEnrolled, NoSuchAssessment, DuplicateAssessment, OutOfRange };
+
+enum class AttendanceResult { Ok, NoSuchClass, NoSuchStudent, NotEnrolled, NoSuchSession };
+
+// One badge scan: a student checking in to a class
+struct ScanEvent {
+    int64_t time = 0;           // seconds since 1970-01-01 UTC
+    std::string className;
+    std::string studentName;
+};
+
+// Outcome of applying a batch of scans
+struct ScanTotals {
+    size_t marked = 0;          // students newly marked present
+    size_t alreadyPresent = 0;
+    size_t unknown = 0;         // no such class or student
+    size_t notEnrolled = 0;
+    size_t sessionsStarted = 0;
+};
+
+// Which RosterStore keeps the roster between runs
+enum class StoreKind { Text, Journal, Memory };
+
+// Which NameIndex backs the student roster
+enum class IndexKind { Memory, Lsm, BTree };
+
+// Startup configuration for the Model
+struct ModelOptions {
+    StoreKind store = StoreKind::Text;          // Memory: no file I/O at all
+    IndexKind studentIndex = IndexKind::Memory;
+    std::string indexDirectory = "roster_index";
+    size_t memoryBudgetBytes = 0;               // roster pages beyond this spill to disk; 0 = no limit
+    std::string spillPath = "roster.spill";
+    std::vector<std::pair<StudentColumn, AttributeIndex::Type>> attributeIndexes; // built at startup
+    std::string eventDirectory = "class_events"; // live activity partitions; unused with the memory store
+    int64_t eventRetentionMs = 0;               // drop activity older than this; 0 = keep everything
+};
+
+// Model: Manages data storage for classes, students and enrollments
+//
+// Multi-version: every write publishes a new RosterVersion with an atomic
+// pointer swap. Readers pin a version and see a consistent roster for as long
+// as they hold it, without ever waiting on writers. Writers are serialized on
+// writeMutex; versions nobody can see any more are reclaimed through epochs.
+//
+// Persistence is asynchronous: a write updates memory, queues a Mutation and
+// returns. A dedicated thread drains the queue and saves the latest version;
+// Flush() waits until everything queued so far is on disk.
+//
+// Name lookups and ordered listings go through a NameIndex per collection.
+// The student index can live out of core (ModelOptions::studentIndex).
+//
+// Student attributes live beside the versions in a columnar store indexed by
+// student ID. They are updated in place rather than versioned, so a pinned
+// snapshot sees the latest attributes of the students it contains. Per-class
+// dashboard totals (ClassAggregates) are likewise kept current by deltas.
+//
+// Live classroom activity goes to its own append-only ClassEventStore rather
+// than through the persistence queue: events arrive far faster than roster
+// changes and are only ever appended or aged out.
+class Model {
+public:
+    // A pinned roster version. Classes, students and enrollments read through
+    // it are mutually consistent while writers carry on. Release it promptly:
+    // retired versions cannot be reclaimed while an older pin is held.
+    class Snapshot {
+    public:
+        Snapshot(Snapshot&& other) noexcept : epochs(other.epochs), slot(other.slot), data(other.data) {
+            other.epochs = nullptr;
+        }
+        Snapshot(const Snapshot&) = delete;
+        Snapshot& operator=(const Snapshot&) = delete;
+        ~Snapshot() {
+            if (epochs) epochs->Exit(slot);
+        }
+
+        uint64_t Version() const { return data->version; }
+        const PagedList<std::string>& Classes() const { return data->classes; }
+        const PagedList<std::string>& Students() const { return data->students; }
+        const PagedList<Enrollment>& Enrollments() const { return data->enrollments; }
+
+    private:
+        friend class Model;
+        Snapshot(EpochManager* epochs, size_t slot, const RosterVersion* data)
+            : epochs(epochs), slot(slot), data(data) {}
+
+        EpochManager* epochs;
+        size_t slot;
+        const RosterVersion* data;
+    };
+
+    // A single list of the latest roster version, keeping that version pinned
+    template <typename T>
+    class ListView {
+    public:
+        ListView(Snapshot snapshot, const PagedList<T>& list) : snapshot(std::move(snapshot)), list(&list) {}
+        size_t size() const { return list->size(); }
+        bool empty() const { return list->empty(); }
+        const T& operator[](size_t i) const { return (*list)[i]; }
+        typename PagedList<T>::const_iterator begin() const { return list->begin(); }
+        typename PagedList<T>::const_iterator end() const { return list->end(); }
+    private:
+        Snapshot snapshot;
+        const PagedList<T>* list;
+    };
+
+    explicit Model(const ModelOptions& options = ModelOptions())
+        : persistent(options.store != StoreKind::Memory),
+          events(persistent ? options.eventDirectory : ""),
+          eventRetentionMs(options.eventRetentionMs) {
+        switch (options.store) {
+            case StoreKind::Text: store.reset(new TextFileStore()); break;
+            case StoreKind::Journal: store.reset(new JournaledBinaryStore()); break;
+            case StoreKind::Memory: store.reset(new MemoryStore()); break;
+        }
+        auto initial = new RosterVersion();
+        if (options.memoryBudgetBytes > 0) {
+            pageCache.reset(new PageCache(options.memoryBudgetBytes, options.spillPath, epochs));
+            initial->classes.SetCache(pageCache.get());
+            initial->students.SetCache(pageCache.get());
+            initial->enrollments.SetCache(pageCache.get());
+        }
+        for (const auto& declared : options.attributeIndexes) tables.attributes.AddIndex(declared.first, declared.second);
+        store->Load(*initial, tables);
+        tables.attributes.EnsureRows(initial->students.size());
+        classIndex.reset(new MemoryNameIndex());
+        if (options.studentIndex == IndexKind::Memory) {
+            studentIndex.reset(new MemoryNameIndex());
+        } else {
+            // Disk-backed indexes get a Bloom filter in front for duplicate checks
+            std::unique_ptr<NameIndex> disk;
+            if (options.studentIndex == IndexKind::Lsm) {
+                disk.reset(new LsmNameIndex(options.indexDirectory + "/students"));
+            } else {
+                disk.reset(new BTreeNameIndex(options.indexDirectory + "/students.btree"));
+            }
+            studentFilter = new BloomFilteredIndex(std::move(disk), options.indexDirectory + "/students.bloom");
+            studentIndex.reset(studentFilter);
+        }
+        SyncIndex(*classIndex, initial->classes);
+        SyncIndex(*studentIndex, initial->students);
+        aggregates.EnsureClasses(initial->classes.size());
+        tables.seats.EnsureClasses(initial->classes.size());
+        tables.prerequisites.EnsureClasses(initial->classes.size());
+        tables.organization.EnsureClasses(initial->classes.size());
+        for (size_t i = 0; i < initial->enrollments.size(); ++i) {
+            const Enrollment& e = initial->enrollments[i];
+            enrollmentAt[(uint64_t(e.classId) << 32) | e.studentId] = i;
+            aggregates.AddEnrollment(e.classId);
+            tables.seats.AddTaken(e.classId);
+            tables.grades.AddMember(e.classId, e.studentId);
+            tables.attendance.AddMember(e.classId, e.studentId);
+            engagement.AddMember(e.classId, e.studentId);
+            timetable.AddMember(e.classId, e.studentId);
+        }
+        tables.schedules.Read([&](const ScheduleBook& schedules) {
+            for (size_t c = 0; c < schedules.Classes(); ++c) timetable.Load(static_cast<uint32_t>(c), *schedules.Class(static_cast<uint32_t>(c)));
+        });
+        if (timetable.LoadConflicts() > 0) {
+            std::cerr << "Warning: " << timetable.LoadConflicts() << " saved booking(s) overlap another and were left out of "
+                      << "conflict checks; validate the timetable to list them.\n";
+        }
+        // Warm the engagement windows from recent activity
+        int64_t now = NowMs();
+        for (size_t c = 0; c < initial->classes.size(); ++c) {
+            events.Scan(static_cast<uint32_t>(c), now - EngagementWindows::kWindowMs * 2, now + 1, "",
+                        [&](int64_t time, const std::string& type, uint32_t studentId) {
+                engagement.Observe(static_cast<uint32_t>(c), studentId, time, EngagementWindows::Weight(type));
+            });
+        }
+        tables.grades.Read([&](const Gradebook& grades) {
+            for (size_t c = 0; c < grades.Classes(); ++c) {
+                for (const auto& assessment : grades.Class(static_cast<uint32_t>(c))->assessments) {
+                    for (float score : assessment.scores) {
+                        if (!std::isnan(score)) aggregates.AddGrade(static_cast<uint32_t>(c), Percent(score, assessment.maxPoints));
+                    }
+                }
+            }
+        });
+        tables.attendance.Read([&](const AttendanceBook& attendance) {
+            for (size_t c = 0; c < attendance.Classes(); ++c) {
+                for (const auto& session : attendance.Class(static_cast<uint32_t>(c))->sessions) {
+                    aggregates.AddAttendance(static_cast<uint32_t>(c), AttendanceBook::Attended(session), session.members);
+                }
+            }
+        });
+        current.store(initial);
+        if (persistent) persister = std::thread(&Model::PersistLoop, this);
+    }
+
+    ~Model() {
+        if (persister.joinable()) {
+            Flush();
+            {
+                std::lock_guard<std::mutex> lock(persistMutex);
+                stopping = true;
+            }
+            persistWake.notify_one();
+            persister.join();
+        }
+        delete current.load();
+    }
+
+    Model(const Model&) = delete;
+    Model& operator=(const Model&) = delete;
+
+    // Add a class if name is unique
+    bool AddClass(const std::string& className) {
+        std::lock_guard<std::mutex> lock(writeMutex);
+        Snapshot pin = Pin();
+        const RosterVersion* base = pin.data;
+        uint32_t existing;
+        if (classIndex->Find(className, existing)) return false;
+        classIndex->Insert(className, static_cast<uint32_t>(base->classes.size()));
+        aggregates.EnsureClasses(base->classes.size() + 1);
+        tables.seats.EnsureClasses(base->classes.size() + 1);
+        tables.prerequisites.EnsureClasses(base->classes.size() + 1);
+        tables.organization.EnsureClasses(base->classes.size() + 1);
+        auto next = new RosterVersion(*base);
+        next->classes.push_back(className);
+        Publish(next, {Mutation::Kind::AddClass, 0, className, ""});
+        return true;
+    }
+
+    // Add a student if name is unique and the student index can hold it;
+    // uniqueness is only checked through the index
+    AddStudentResult AddStudent(const std::string& studentName) {
+        std::lock_guard<std::mutex> lock(writeMutex);
+        Snapshot pin = Pin();
+        const RosterVersion* base = pin.data;
+        uint32_t existing;
+        if (studentIndex->Find(studentName, existing)) return AddStudentResult::AlreadyExists;
+        if (!studentIndex->Insert(studentName, static_cast<uint32_t>(base->students.size()))) return AddStudentResult::NameTooLong;
+        tables.attributes.EnsureRows(base->students.size() + 1);
+        auto next = new RosterVersion(*base);
+        next->students.push_back(studentName);
+        Publish(next, {Mutation::Kind::AddStudent, 0, studentName, ""});
+        return AddStudentResult::Added;
+    }
+
+    // Enroll an existing student in an existing class, unless one of its
+    // meetings overlaps another of the student's classes (described in
+    // conflict when given)
+    EnrollResult Enroll(const std::string& className, const std::string& studentName,
+                        TimetableConflict* conflict = nullptr) {
+        uint32_t classId, studentId;
+        if (!classIndex->Find(className, classId)) return EnrollResult::NoSuchClass;
+        if (!studentIndex->Find(studentName, studentId)) return EnrollResult::NoSuchStudent;
+        if (tables.grades.IsMember(classId, studentId)) return EnrollResult::AlreadyEnrolled;
+        if (tables.prerequisites.Missing(classId, studentId) >= 0) return EnrollResult::MissingPrerequisite;
+        // Claim a seat before taking the writer lock, so a full class turns
+        // students to its waitlist without them queuing behind writers
+        if (!tables.seats.TryReserve(classId)) {
+            auto joined = tables.seats.Join(classId, studentId, [&] {
+                if (persistent) Enqueue({Mutation::Kind::JoinWaitlist, 0, className, studentName});
+            });
+            if (joined == SeatBook::JoinResult::Waitlisted) return EnrollResult::Waitlisted;
+            if (joined == SeatBook::JoinResult::AlreadyWaitlisted) return EnrollResult::AlreadyWaitlisted;
+        }
+        std::lock_guard<std::mutex> lock(writeMutex);
+        EnrollResult result = EnrollLocked(classId, studentId, conflict);
+        if (result != EnrollResult::Enrolled) FreeSeatLocked(classId);
+        return result;
+    }
+
+    // Take a student out of a class, or off its waitlist. A freed seat goes to
+    // the first student on the waitlist who can still enroll; promoted
+    // receives their name (empty if nobody).
+    DropResult Drop(const std::string& className, const std::string& studentName, std::string* promoted = nullptr) {
+        std::lock_guard<std::mutex> lock(writeMutex);
+        uint32_t classId, studentId;
+        if (!classIndex->Find(className, classId)) return DropResult::NoSuchClass;
+        if (!studentIndex->Find(studentName, studentId)) return DropResult::NoSuchStudent;
+        if (promoted) promoted->clear();
+        if (!tables.grades.IsMember(classId, studentId)) {
+            bool left = tables.seats.Leave(classId, studentId, [&] {
+                if (persistent) Enqueue({Mutation::Kind::LeaveWaitlist, 0, className, studentName});
+            });
+            return left ? DropResult::LeftWaitlist : DropResult::NotEnrolled;
+        }
+        Snapshot pin = Pin();
+        const RosterVersion* base = pin.data;
+        auto found = enrollmentAt.find((uint64_t(classId) << 32) | studentId);
+        if (found == enrollmentAt.end()) return DropResult::NotEnrolled;
+        size_t at = found->second;
+        enrollmentAt.erase(found);
+        const Enrollment& moved = base->enrollments[base->enrollments.size() - 1];
+        if (at + 1 != base->enrollments.size()) enrollmentAt[(uint64_t(moved.classId) << 32) | moved.studentId] = at;
+        auto next = new RosterVersion(*base);
+        next->enrollments.swap_erase(at);
+        Publish(next, {Mutation::Kind::Drop, 0, className, studentName});
+        // The student's grades and attendance marks leave the class totals with them
+        aggregates.AddEnrollment(classId, -1);
+        for (const auto& grade : tables.grades.RemoveMember(classId, studentId)) {
+            aggregates.AddGrade(classId, Percent(grade.first, grade.second), -1);
+        }
+        int64_t present, recorded;
+        tables.attendance.RemoveMember(classId, studentId, present, recorded);
+        aggregates.AddAttendance(classId, -present, -recorded);
+        engagement.RemoveMember(classId, studentId);
+        timetable.RemoveMember(classId, studentId, tables.schedules.Get(classId).meetings);
+        std::vector<uint32_t> seated = FreeSeatLocked(classId);
+        if (promoted && !seated.empty()) *promoted = pin.Students()[seated[0]];
+        return DropResult::Dropped;
+    }
+
+    // Set a class's capacity (0: unlimited); seats it opens go down the
+    // waitlist, and promoted receives who got them. False if no such class.
+    bool SetCapacity(const std::string& className, uint32_t capacity, std::vector<std::string>* promoted = nullptr) {
+        std::lock_guard<std::mutex> lock(writeMutex);
+        uint32_t classId;
+        if (!classIndex->Find(className, classId)) return false;
+        if (persistent) Enqueue({Mutation::Kind::SetCapacity, 0, className, std::to_string(capacity)});
+        Snapshot pin = Pin();
+        std::vector<uint32_t> seated = tables.seats.SetCapacity(classId, capacity, [&](uint32_t studentId) {
+            if (persistent) Enqueue({Mutation::Kind::LeaveWaitlist, 0, className, pin.Students()[studentId]});
+        });
+        for (uint32_t studentId : seated) {
+            if (EnrollLocked(classId, studentId, nullptr) == EnrollResult::Enrolled) {
+                if (promoted) promoted->push_back(pin.Students()[studentId]);
+            } else {
+                for (uint32_t other : FreeSeatLocked(classId)) {
+                    if (promoted) promoted->push_back(pin.Students()[other]);
+                }
+            }
+        }
+        return true;
+    }
+
+    SeatBook::Seats GetSeats(uint32_t classId) const { return tables.seats.Get(classId); }
+
+    // Make a class require another (required) or stop requiring it. An edge
+    // that would make a class its own prerequisite, however indirectly, is
+    // refused as a Cycle.
+    PrerequisiteResult SetPrerequisite(const std::string& className, const std::string& prerequisite, bool required) {
+        std::lock_guard<std::mutex> lock(writeMutex);
+        uint32_t classId, prerequisiteId;
+        if (!classIndex->Find(className, classId) || !classIndex->Find(prerequisite, prerequisiteId)) {
+            return PrerequisiteResult::NoSuchClass;
+        }
+        if (required) {
+            switch (tables.prerequisites.AddEdge(classId, prerequisiteId)) {
+                case PrerequisiteBook::EdgeResult::Cycle: return PrerequisiteResult::Cycle;
+                case PrerequisiteBook::EdgeResult::Exists: return PrerequisiteResult::AlreadyRequired;
+                default: break;
+            }
+        } else if (tables.prerequisites.RemoveEdge(classId, prerequisiteId) == PrerequisiteBook::EdgeResult::Missing) {
+            return PrerequisiteResult::NotRequired;
+        }
+        if (persistent) {
+            Enqueue({required ? Mutation::Kind::AddPrerequisite : Mutation::Kind::RemovePrerequisite, 0, className, prerequisite});
+        }
+        return required ? PrerequisiteResult::Added : PrerequisiteResult::Removed;
+    }
+
+    // Record that a student passed a class; false if either does not exist
+    bool RecordCompletion(const std::string& studentName, const std::string& className) {
+        std::lock_guard<std::mutex> lock(writeMutex);
+        uint32_t classId, studentId;
+        if (!classIndex->Find(className, classId) || !studentIndex->Find(studentName, studentId)) return false;
+        if (tables.prerequisites.Complete(studentId, classId) && persistent) {
+            Enqueue({Mutation::Kind::Complete, 0, studentName, className});
+        }
+        return true;
+    }
+
+    // Names of a class's direct prerequisites
+    std::vector<std::string> GetPrerequisites(uint32_t classId) const {
+        Snapshot pin = Pin();
+        std::vector<std::string> names;
+        for (uint32_t p : tables.prerequisites.Prerequisites(classId)) names.push_back(pin.Classes()[p]);
+        return names;
+    }
+
+    // The prerequisite keeping a student out of a class, or empty if they are
+    // eligible (or either name is unknown)
+    std::string MissingPrerequisite(const std::string& className, const std::string& studentName) const {
+        uint32_t classId, studentId;
+        if (!classIndex->Find(className, classId) || !studentIndex->Find(studentName, studentId)) return "";
+        int64_t missing = tables.prerequisites.Missing(classId, studentId);
+        return missing < 0 ? "" : Pin().Classes()[static_cast<size_t>(missing)];
+    }
+
+    // Names on a class's waitlist, first in line first
+    std::vector<std::string> GetWaitlist(uint32_t classId) const {
+        Snapshot pin = Pin();
+        std::vector<std::string> names;
+        for (uint32_t studentId : tables.seats.Waitlist(classId)) names.push_back(pin.Students()[studentId]);
+        return names;
+    }
+
+    // Replace a student's attributes; false if there is no such student
+    bool SetStudentAttributes(const std::string& studentName, const StudentAttributes& row) {
+        std::lock_guard<std::mutex> lock(writeMutex);
+        uint32_t studentId;
+        if (!studentIndex->Find(studentName, studentId)) return false;
+        tables.attributes.Set(studentId, row);
+        if (persistent) Enqueue({Mutation::Kind::SetAttributes, 0, studentName, row.Encode()});
+        return true;
+    }
+
+    // A student's attributes; false if there is no such student
+    bool GetStudentAttributes(const std::string& studentName, StudentAttributes& row) const {
+        uint32_t studentId;
+        if (!studentIndex->Find(studentName, studentId)) return false;
+        row = tables.attributes.Get(studentId);
+        return true;
+    }
+
+    // The attribute columns, for scans and aggregates
+    const StudentAttributeStore& Attributes() const { return tables.attributes; }
+
+    bool FindClass(const std::string& className, uint32_t& classId) const {
+        return classIndex->Find(className, classId);
+    }
+
+    // Add an assessment worth maxPoints to a class
+    GradebookResult AddAssessment(const std::string& className, const std::string& assessment, float maxPoints) {
+        std::lock_guard<std::mutex> lock(writeMutex);
+        uint32_t classId;
+        if (!classIndex->Find(className, classId)) return GradebookResult::NoSuchClass;
+        if (!(maxPoints > 0)) return GradebookResult::OutOfRange;
+        if (tables.grades.AddAssessment(classId, assessment, maxPoints) < 0) return GradebookResult::DuplicateAssessment;
+        if (persistent) Enqueue({Mutation::Kind::AddAssessment, 0, className, assessment + '\t' + FormatFloat(maxPoints)});
+        return GradebookResult::Ok;
+    }
+
+    // Record an enrolled student's score; NaN clears it
+    GradebookResult SetGrade(const std::string& className, const std::string& assessment,
+                             const std::string& studentName, float score) {
+        std::lock_guard<std::mutex> lock(writeMutex);
+        uint32_t classId, studentId;
+        float maxPoints, previous;
+        if (!classIndex->Find(className, classId)) return GradebookResult::NoSuchClass;
+        if (!studentIndex->Find(studentName, studentId)) return GradebookResult::NoSuchStudent;
+        if (!tables.grades.IsMember(classId, studentId)) return GradebookResult::NotEnrolled;
+        if (!tables.grades.MaxPoints(classId, assessment, maxPoints)) return GradebookResult::NoSuchAssessment;
+        if (score < 0 || score > maxPoints) return GradebookResult::OutOfRange;
+        tables.grades.SetScore(classId, assessment, studentId, score, previous);
+        if (!std::isnan(previous)) aggregates.AddGrade(classId, Percent(previous, maxPoints), -1);
+        if (!std::isnan(score)) aggregates.AddGrade(classId, Percent(score, maxPoints));
+        if (persistent) {
+            Enqueue({Mutation::Kind::SetGrades, 0, className, assessment + '\t' + studentName + '\t' + FormatFloat(score)});
+        }
+        return GradebookResult::Ok;
+    }
+
+    // Curve every score of an assessment; the curved scores are saved as grades
+    GradebookResult CurveAssessment(const std::string& className, const std::string& assessment, CurveKind kind, float param) {
+        std::lock_guard<std::mutex> lock(writeMutex);
+        uint32_t classId;
+        if (!classIndex->Find(className, classId)) return GradebookResult::NoSuchClass;
+        Gradebook::CurveChange change;
+        if (!tables.grades.Curve(classId, assessment, kind, param, change)) return GradebookResult::NoSuchAssessment;
+        Snapshot pin = Pin();
+        std::string record = assessment;
+        for (size_t row = 0; row < change.members.size(); ++row) {
+            float before = change.before[row], after = change.after[row];
+            if (std::isnan(before) || before == after) continue;
+            aggregates.AddGrade(classId, Percent(before, change.maxPoints), -1);
+            aggregates.AddGrade(classId, Percent(after, change.maxPoints));
+            record += '\t' + pin.Students()[change.members[row]] + '\t' + FormatFloat(after);
+        }
+        if (persistent && record.size() > assessment.size()) Enqueue({Mutation::Kind::SetGrades, 0, className, record});
+        return GradebookResult::Ok;
+    }
+
+    // Grade percentages across classes, merged from per-class sketches (or,
+    // given an assessment name, from the sketches of assessments by that name).
+    // An empty classIds means every class.
+    KllSketch GradeSketch(const std::vector<uint32_t>& classIds, const std::string& assessment = "") const {
+        KllSketch merged;
+        tables.grades.Read([&](const Gradebook& grades) {
+            auto add = [&](uint32_t classId) {
+                const Gradebook::ClassBook* book = grades.Class(classId);
+                if (!book) return;
+                if (assessment.empty()) {
+                    merged.Merge(book->sketch);
+                } else {
+                    int a = book->FindAssessment(assessment);
+                    if (a >= 0) merged.Merge(book->assessments[a].sketch);
+                }
+            };
+            if (classIds.empty()) {
+                for (size_t c = 0; c < grades.Classes(); ++c) add(static_cast<uint32_t>(c));
+            } else {
+                for (uint32_t classId : classIds) add(classId);
+            }
+        });
+        return merged;
+    }
+
+    // The gradebook, for statistics and display
+    const Gradebook& Grades() const { return tables.grades; }
+
+    // Hold a session of a class on day, with every enrolled student marked
+    // absent until marked present. Returns the session index, or -1 if there
+    // is no such class.
+    int StartSession(const std::string& className, int32_t day) {
+        std::lock_guard<std::mutex> lock(writeMutex);
+        uint32_t classId;
+        if (!classIndex->Find(className, classId)) return -1;
+        return static_cast<int>(StartSessionLocked(classId, className, day));
+    }
+
+    // Mark students present or absent at the latest session held on day
+    AttendanceResult MarkAttendance(const std::string& className, int32_t day,
+                                    const std::vector<std::pair<std::string, bool>>& marks) {
+        std::lock_guard<std::mutex> lock(writeMutex);
+        uint32_t classId, studentId;
+        if (!classIndex->Find(className, classId)) return AttendanceResult::NoSuchClass;
+        int session = tables.attendance.FindSession(classId, day);
+        if (session < 0) return AttendanceResult::NoSuchSession;
+        AttendanceResult result = AttendanceResult::Ok;
+        std::string record = std::to_string(session);
+        for (const auto& mark : marks) {
+            if (!studentIndex->Find(mark.first, studentId)) {
+                result = AttendanceResult::NoSuchStudent;
+                continue;
+            }
+            int previous = tables.attendance.SetPresent(classId, static_cast<uint32_t>(session), studentId, mark.second);
+            if (previous < 0) {
+                result = AttendanceResult::NotEnrolled;
+                continue;
+            }
+            if (previous == static_cast<int>(mark.second)) continue;
+            aggregates.AddAttendance(classId, mark.second ? 1 : -1, 0);
+            record += '\t' + mark.first + (mark.second ? "\t1" : "\t0");
+        }
+        if (persistent && record.size() > std::to_string(session).size()) {
+            Enqueue({Mutation::Kind::SetAttendance, 0, className, record});
+        }
+        return result;
+    }
+
+    // Apply a batch of badge scans as one transaction: under a single write
+    // lock each scan resolves to a student and to the class's latest session on
+    // the scan's day (started if the class has none yet), and is marked
+    // present. Changes are queued as one SetAttendance record per session.
+    void ApplyScans(const std::vector<ScanEvent>& scans, ScanTotals& totals) {
+        struct Group {
+            uint32_t classId;
+            uint32_t session;
+            const std::string* className;
+            std::vector<uint32_t> students;
+            std::vector<const std::string*> names;
+        };
+        std::lock_guard<std::mutex> lock(writeMutex);
+        std::vector<Group> groups;
+        std::unordered_map<uint64_t, size_t> groupOf; // (class, day) -> group
+        for (const auto& scan : scans) {
+            uint32_t classId, studentId;
+            if (!classIndex->Find(scan.className, classId) || !studentIndex->Find(scan.studentName, studentId)) {
+                ++totals.unknown;
+                continue;
+            }
+            int32_t day = static_cast<int32_t>(scan.time >= 0 ? scan.time / 86400 : (scan.time - 86399) / 86400);
+            auto group = groupOf.find((uint64_t(classId) << 32) | static_cast<uint32_t>(day));
+            if (group == groupOf.end()) {
+                int session = tables.attendance.FindSession(classId, day);
+                if (session < 0) {
+                    session = static_cast<int>(StartSessionLocked(classId, scan.className, day));
+                    ++totals.sessionsStarted;
+                }
+                group = groupOf.emplace((uint64_t(classId) << 32) | static_cast<uint32_t>(day), groups.size()).first;
+                groups.push_back({classId, static_cast<uint32_t>(session), &scan.className, {}, {}});
+            }
+            groups[group->second].students.push_back(studentId);
+            groups[group->second].names.push_back(&scan.studentName);
+        }
+        std::vector<int> previous;
+        for (const Group& group : groups) {
+            tables.attendance.MarkPresent(group.classId, group.session, group.students, previous);
+            std::string record = std::to_string(group.session);
+            int64_t marked = 0;
+            for (size_t i = 0; i < previous.size(); ++i) {
+                if (previous[i] < 0) {
+                    ++totals.notEnrolled;
+                } else if (previous[i] == 1) {
+                    ++totals.alreadyPresent;
+                } else {
+                    ++marked;
+                    record += '\t' + *group.names[i] + "\t1";
+                }
+            }
+            if (marked == 0) continue;
+            totals.marked += static_cast<size_t>(marked);
+            aggregates.AddAttendance(group.classId, marked, 0);
+            if (persistent) Enqueue({Mutation::Kind::SetAttendance, 0, *group.className, record});
+        }
+    }
+
+    // Record live activity in a class at time (ms since the epoch); an empty
+    // studentName records a class-wide event. False if the class or student
+    // does not exist.
+    bool RecordEvent(const std::string& className, const std::string& studentName, const std::string& type, int64_t time) {
+        uint32_t classId, studentId = ClassEventStore::kNoStudent;
+        if (!classIndex->Find(className, classId)) return false;
+        if (!studentName.empty() && !studentIndex->Find(studentName, studentId)) return false;
+        events.Append(classId, time, type, studentId);
+        if (studentId != ClassEventStore::kNoStudent) engagement.Observe(classId, studentId, time, EngagementWindows::Weight(type));
+        // Age out old partitions at most once a minute
+        int64_t checked = retentionChecked.load();
+        if (eventRetentionMs > 0 && time - checked >= 60000 && retentionChecked.compare_exchange_strong(checked, time)) {
+            events.DropBefore(time - eventRetentionMs);
+        }
+        return true;
+    }
+
+    // Call fn(time, type, studentId) for a class's events in [from, to),
+    // optionally of one type; returns the number of matches
+    template <typename F>
+    size_t ScanEvents(uint32_t classId, int64_t from, int64_t to, const std::string& type, F fn) const {
+        return events.Scan(classId, from, to, type, fn);
+    }
+
+    ClassEventStore::Stats GetEventStats() const { return events.GetStats(); }
+
+    // The k enrolled students of a class who participated least in the last
+    // five minutes, lowest first
+    std::vector<EngagementWindows::Score> LeastEngaged(uint32_t classId, size_t k) const {
+        return engagement.LeastEngaged(classId, NowMs(), k);
+    }
+
+    // Give a class a teacher, room and weekly meetings, unless that would
+    // double-book the teacher, the room or an enrolled student (described in
+    // conflict). Each check is an O(log n) interval lookup.
+    ScheduleResult SetSchedule(const std::string& className, const ClassSchedule& schedule, TimetableConflict& conflict) {
+        std::lock_guard<std::mutex> lock(writeMutex);
+        uint32_t classId;
+        if (!classIndex->Find(className, classId)) return ScheduleResult::NoSuchClass;
+        Snapshot pin = Pin();
+        auto describe = [&](uint32_t studentId) { return pin.Students()[studentId]; };
+        if (!timetable.Reschedule(classId, tables.schedules.Get(classId), schedule, conflict, describe)) {
+            return ScheduleResult::Conflict;
+        }
+        tables.schedules.Set(classId, schedule);
+        if (persistent) Enqueue({Mutation::Kind::SetSchedule, 0, className, schedule.Encode()});
+        return ScheduleResult::Ok;
+    }
+
+    ClassSchedule GetSchedule(uint32_t classId) const { return tables.schedules.Get(classId); }
+
+    // Seats in a room the timetable solver may use; 0 removes it
+    void SetRoom(const std::string& room, uint32_t seats) {
+        std::lock_guard<std::mutex> lock(writeMutex);
+        tables.schedules.SetRoom(room, seats);
+        if (persistent) Enqueue({Mutation::Kind::SetRoom, 0, room, std::to_string(seats)});
+    }
+
+    // Weekly hours a teacher can teach; none means any time
+    void SetAvailability(const std::string& teacher, const std::vector<Meeting>& hours) {
+        std::lock_guard<std::mutex> lock(writeMutex);
+        tables.schedules.SetAvailability(teacher, hours);
+        if (persistent) Enqueue({Mutation::Kind::SetAvailability, 0, teacher, FormatMeetings(hours)});
+    }
+
+    // The term timetable to solve for every class of the latest version: its
+    // teacher and enrolled students, as many meetings as it has now (or
+    // defaultMeetings if none), over the declared rooms and a standard week
+    TimetableProblem BuildTimetableProblem(int defaultMeetings = 2) const {
+        Snapshot snapshot = Pin();
+        TimetableProblem problem;
+        problem.UseStandardWeek();
+        problem.studentsOf.resize(snapshot.Classes().size());
+        for (const auto& e : snapshot.Enrollments()) {
+            if (e.classId < problem.studentsOf.size()) problem.studentsOf[e.classId].push_back(e.studentId);
+        }
+        tables.schedules.Read([&](const ScheduleBook& book) {
+            for (size_t c = 0; c < snapshot.Classes().size(); ++c) {
+                const ClassSchedule* schedule = book.Class(static_cast<uint32_t>(c));
+                int meetings = schedule && !schedule->meetings.empty() ? static_cast<int>(schedule->meetings.size()) : defaultMeetings;
+                problem.classes.push_back({static_cast<uint32_t>(c), schedule ? schedule->teacher : std::string(),
+                                           static_cast<uint32_t>(problem.studentsOf[c].size()), meetings});
+            }
+            problem.rooms.assign(book.Rooms().begin(), book.Rooms().end());
+            problem.availability = book.Availability();
+        });
+        for (auto& students : problem.studentsOf) std::sort(students.begin(), students.end());
+        return problem;
+    }
+
+    // Search for a timetable for problem for the given seconds on up to
+    // maxThreads threads (0: every core)
+    TimetableSolution SolveTimetable(const TimetableProblem& problem, double seconds, unsigned maxThreads = 0) const {
+        return TimetableSolver(problem).Solve(seconds, maxThreads);
+    }
+
+    // Replace every solved class's schedule with the solution's, all or
+    // nothing. Enrollments made since the problem was built are still
+    // checked, so a clash with one is reported as a conflict.
+    ScheduleResult ApplyTimetable(const TimetableProblem& problem, const TimetableSolution& solution, TimetableConflict& conflict) {
+        std::lock_guard<std::mutex> lock(writeMutex);
+        Snapshot pin = Pin();
+        auto describe = [&](uint32_t studentId) { return pin.Students()[studentId]; };
+        std::vector<ClassSchedule> old, next;
+        for (size_t c = 0; c < problem.classes.size(); ++c) {
+            uint32_t classId = problem.classes[c].classId;
+            if (classId >= pin.Classes().size() || c >= solution.slotsOf.size()) return ScheduleResult::NoSuchClass;
+            old.push_back(tables.schedules.Get(classId));
+            next.push_back(solution.Schedule(problem, c));
+        }
+        // Clear the old bookings first so classes can trade slots
+        for (size_t c = 0; c < old.size(); ++c) timetable.Reschedule(problem.classes[c].classId, old[c], ClassSchedule(), conflict, describe);
+        size_t applied = 0;
+        for (; applied < next.size(); ++applied) {
+            if (!timetable.Reschedule(problem.classes[applied].classId, ClassSchedule(), next[applied], conflict, describe)) break;
+        }
+        if (applied < next.size()) {
+            TimetableConflict ignored;
+            for (size_t c = 0; c < applied; ++c) timetable.Reschedule(problem.classes[c].classId, next[c], ClassSchedule(), ignored, describe);
+            for (size_t c = 0; c < old.size(); ++c) timetable.Reschedule(problem.classes[c].classId, ClassSchedule(), old[c], ignored, describe);
+            return ScheduleResult::Conflict;
+        }
+        for (size_t c = 0; c < next.size(); ++c) {
+            tables.schedules.Set(problem.classes[c].classId, next[c]);
+            if (persistent) Enqueue({Mutation::Kind::SetSchedule, 0, pin.Classes()[problem.classes[c].classId], next[c].Encode()});
+        }
+        return ScheduleResult::Ok;
+    }
+
+    // Check every student's, teacher's and room's week for overlaps, students
+    // in parallel; maxThreads 0 uses every core
+    TimetableReport ValidateTimetable(unsigned maxThreads = 0) const {
+        Snapshot snapshot = Pin();
+        return ::ValidateTimetable(snapshot.Classes(), snapshot.Students(), snapshot.Enrollments(), tables.schedules, maxThreads);
+    }
+
+    // Attendance sessions, for per-student summaries and absence reports
+    const AttendanceBook& Attendance() const { return tables.attendance; }
+
+    // Live totals for one class, read in O(1)
+    ClassAggregates::Totals GetClassTotals(uint32_t classId) const { return aggregates.Get(classId); }
+
+    // Add a unit (a school, department, ...) under parent; an empty parent makes it top-level
+    OrganizationResult AddUnit(const std::string& name, const std::string& parent) {
+        std::lock_guard<std::mutex> lock(writeMutex);
+        uint32_t parentId = OrganizationTree::kRoot, unit;
+        if (!parent.empty() && !tables.organization.FindUnit(parent, parentId)) return OrganizationResult::NoSuchUnit;
+        if (tables.organization.AddUnit(name, parentId, unit) == OrganizationTree::Result::Exists) {
+            return OrganizationResult::DuplicateUnit;
+        }
+        if (persistent) Enqueue({Mutation::Kind::AddUnit, 0, name, parent});
+        return OrganizationResult::Ok;
+    }
+
+    // Move a class under a unit; an empty unit takes it out of the organization
+    OrganizationResult PlaceClass(const std::string& className, const std::string& unitName) {
+        std::lock_guard<std::mutex> lock(writeMutex);
+        uint32_t classId, unit = OrganizationTree::kRoot;
+        if (!classIndex->Find(className, classId)) return OrganizationResult::NoSuchClass;
+        if (!unitName.empty() && !tables.organization.FindUnit(unitName, unit)) return OrganizationResult::NoSuchUnit;
+        tables.organization.Place(classId, unit);
+        if (persistent) Enqueue({Mutation::Kind::PlaceClass, 0, className, unitName});
+        return OrganizationResult::Ok;
+    }
+
+    const OrganizationTree& Organization() const { return tables.organization; }
+
+    // Live totals over every class under a unit, in O(classes in the subtree)
+    ClassAggregates::Totals GetUnitTotals(uint32_t unit) const {
+        std::vector<uint32_t> classes = tables.organization.ClassesUnder(unit);
+        return aggregates.Get(classes.data(), classes.size());
+    }
+
+    // Names of the distinct students enrolled in any class under a unit, in
+    // name order; reads only the member lists of the subtree's classes
+    std::vector<std::string> StudentsUnder(uint32_t unit) const {
+        Snapshot pin = Pin();
+        std::vector<uint32_t> classes = tables.organization.ClassesUnder(unit), ids;
+        tables.grades.Read([&](const Gradebook& grades) {
+            for (uint32_t c : classes) {
+                if (const Gradebook::ClassBook* book = grades.Class(c)) ids.insert(ids.end(), book->members.begin(), book->members.end());
+            }
+        });
+        std::sort(ids.begin(), ids.end());
+        ids.erase(std::unique(ids.begin(), ids.end()), ids.end());
+        std::vector<std::string> names;
+        for (uint32_t id : ids) {
+            if (id < pin.Students().size()) names.push_back(pin.Students()[id]);
+        }
+        std::sort(names.begin(), names.end());
+        return names;
+    }
+
+    // Declare a secondary index on a student attribute; false if it already exists
+    bool AddAttributeIndex(StudentColumn column, AttributeIndex::Type type) {
+        return tables.attributes.AddIndex(column, type);
+    }
+
+    // Filter, group and aggregate students of the latest version; maxThreads 0 uses every core
+    QueryResult Query(const StudentQuery& query, unsigned maxThreads = 0) const {
+        Snapshot snapshot = Pin();
+        return tables.attributes.Read([&](const StudentAttributeStore& columns) {
+            return StudentQueryEngine::Run(columns, snapshot.Students(), query, maxThreads);
+        });
+    }
+
+    // Block until every change made before this call has been saved
+    void Flush() {
+        if (!persistent) return;
+        uint64_t ticket = Enqueue({Mutation::Kind::Barrier, 0, "", ""});
+        std::unique_lock<std::mutex> lock(persistMutex);
+        flushed.wait(lock, [&] { return durableTicket >= ticket; });
+    }
+
+    // Pin the latest version for a consistent multi-step read
+    Snapshot Pin() const {
+        size_t slot = epochs.Enter();
+        return Snapshot(&epochs, slot, current.load());
+    }
+
+    // Views on the latest version
+    ListView<std::string> GetClasses() const {
+        Snapshot snapshot = Pin();
+        const auto& list = snapshot.Classes();
+        return ListView<std::string>(std::move(snapshot), list);
+    }
+    ListView<std::string> GetStudents() const {
+        Snapshot snapshot = Pin();
+        const auto& list = snapshot.Students();
+        return ListView<std::string>(std::move(snapshot), list);
+    }
+
+    bool HasClass(const std::string& className) const {
+        uint32_t id;
+        return classIndex->Find(className, id);
+    }
+    bool HasStudent(const std::string& studentName) const {
+        uint32_t id;
+        return studentIndex->Find(studentName, id);
+    }
+
+    // Bloom filter metrics for the student index; false when it has no filter
+    bool GetStudentFilterStats(BloomFilteredIndex::Stats& stats) const {
+        if (!studentFilter) return false;
+        stats = studentFilter->GetStats();
+        return true;
+    }
+
+    // Page cache metrics; false when no memory budget is set
+    bool GetMemoryStats(PageCache::Stats& stats) const {
+        if (!pageCache) return false;
+        stats = pageCache->GetStats();
+        return true;
+    }
+
+    // Up to limit student names in [from, to) in name order; empty to means no upper bound
+    std::vector<std::string> ListStudents(const std::string& from, const std::string& to, size_t limit) const {
+        std::vector<std::string> names;
+        if (limit == 0) return names;
+        studentIndex->Scan(from, [&](const std::string& name, uint32_t) {
+            if (!to.empty() && name >= to) return false;
+            names.push_back(name);
+            return names.size() < limit;
+        });
+        return names;
+    }
+
+    // As above, but only students matching every condition in where. The
+    // matches come from the query engine (and so from any usable attribute
+    // index), then are ordered by name and cut to the range.
+    std::vector<std::string> ListStudents(const std::string& from, const std::string& to, size_t limit,
+                                          const std::vector<StudentPredicate>& where) const {
+        if (where.empty()) return ListStudents(from, to, limit);
+        StudentQuery query;
+        query.where = where;
+        query.project = {StudentColumn::Name};
+        QueryResult result = Query(query);
+        std::vector<std::string> names;
+        for (const auto& row : result.rows) {
+            const std::string& name = row[0];
+            if (name < from || (!to.empty() && name >= to)) continue;
+            names.push_back(name);
+            if (names.size() == limit) break;
+        }
+        return names;
+    }
+
+private:
+    bool persistent;
+    std::unique_ptr<RosterStore> store;
+    std::unique_ptr<PageCache> pageCache; // outlives epochs, whose retired versions release pages into it
+    std::atomic<const RosterVersion*> current{nullptr};
+    mutable EpochManager epochs;
+    std::mutex writeMutex;
+    std::unordered_map<uint64_t, size_t> enrollmentAt; // position in the latest version, by class << 32 | student; under writeMutex
+    std::unique_ptr<NameIndex> classIndex;
+    std::unique_ptr<NameIndex> studentIndex;
+    BloomFilteredIndex* studentFilter = nullptr; // owned by studentIndex when present
+    RosterTables tables;                         // attributes, grades and attendance; not versioned
+    ClassAggregates aggregates;                  // per-class totals, kept by deltas
+    ClassEventStore events;                      // live activity; saves itself
+    EngagementWindows engagement;                // participation windows fed by events
+    TimetableIndex timetable;                    // interval indexes; guarded by writeMutex
+    int64_t eventRetentionMs;
+    std::atomic<int64_t> retentionChecked{std::numeric_limits<int64_t>::min() / 2};
+
+    // Persistence thread state
+    MpscQueue<Mutation> pending;
+    std::atomic<uint64_t> nextTicket{1};
+    std::mutex persistMutex;               // guards the fields below; never held during I/O
+    std::condition_variable persistWake;
+    std::condition_variable flushed;
+    bool wakeRequested = false;
+    bool stopping = false;
+    uint64_t durableTicket = 0;
+    std::thread persister;
+
+    // Swap in a new version, retire the old one and queue the change for
+    // saving. Caller holds writeMutex.
+    void Publish(RosterVersion* next, Mutation change) {
+        const RosterVersion* previous = current.load();
+        next->version = previous->version + 1;
+        current.store(next);
+        epochs.Retire(previous);
+        if (persistent) Enqueue(std::move(change));
+    }
+
+    uint64_t Enqueue(Mutation change) {
+        change.ticket = nextTicket.fetch_add(1);
+        uint64_t ticket = change.ticket;
+        pending.Push(std::move(change));
+        {
+            std::lock_guard<std::mutex> lock(persistMutex);
+            wakeRequested = true;
+        }
+        persistWake.notify_one();
+        return ticket;
+    }
+
+    // Persistence thread: drain queued changes, hand them to the store as one
+    // batch, then release any Flush() waiting on it
+    void PersistLoop() {
+        for (;;) {
+            {
+                std::unique_lock<std::mutex> lock(persistMutex);
+                persistWake.wait(lock, [&] { return wakeRequested || stopping; });
+                if (stopping && !wakeRequested) return;
+                wakeRequested = false;
+            }
+
+            uint64_t lastTicket = 0;
+            unsigned dirty = kDirtyNone;
+            std::vector<Mutation> batch;
+            Mutation change;
+            while (pending.TryPop(change)) {
+                lastTicket = std::max(lastTicket, change.ticket);
+                dirty |= DirtyFlagsFor(change.kind);
+                batch.push_back(std::move(change));
+            }
+            if (lastTicket == 0) continue;
+
+            // The pinned version includes every change drained above
+            if (dirty != kDirtyNone) store->Save(*Pin().data, tables, batch, dirty);
+
+            {
+                std::lock_guard<std::mutex> lock(persistMutex);
+                durableTicket = std::max(durableTicket, lastTicket);
+            }
+            flushed.notify_all();
+        }
+    }
+
+    // Enroll a student who holds a seat in classId. Caller holds writeMutex.
+    EnrollResult EnrollLocked(uint32_t classId, uint32_t studentId, TimetableConflict* conflict) {
+        if (tables.grades.IsMember(classId, studentId)) return EnrollResult::AlreadyEnrolled;
+        // Rechecked here: prerequisites may have changed while the student waited for a seat
+        if (tables.prerequisites.Missing(classId, studentId) >= 0) return EnrollResult::MissingPrerequisite;
+        Snapshot pin = Pin();
+        const RosterVersion* base = pin.data;
+        const std::string& studentName = base->students[studentId];
+        ClassSchedule schedule = tables.schedules.Get(classId);
+        int64_t otherClass;
+        Meeting when;
+        if (!timetable.CheckStudent(classId, studentId, schedule.meetings, otherClass, when)) {
+            if (conflict) *conflict = {"student " + studentName, classId, static_cast<uint32_t>(otherClass), when};
+            return EnrollResult::ScheduleConflict;
+        }
+        timetable.AddMember(classId, studentId);
+        timetable.BookStudent(classId, studentId, schedule.meetings);
+        auto next = new RosterVersion(*base);
+        enrollmentAt[(uint64_t(classId) << 32) | studentId] = next->enrollments.size();
+        next->enrollments.push_back({classId, studentId});
+        Publish(next, {Mutation::Kind::Enroll, 0, base->classes[classId], studentName});
+        aggregates.AddEnrollment(classId);
+        tables.grades.AddMember(classId, studentId);
+        tables.attendance.AddMember(classId, studentId);
+        engagement.AddMember(classId, studentId);
+        return EnrollResult::Enrolled;
+    }
+
+    // A seat in classId was given up: pass it down the waitlist until someone
+    // can take it, or back to the pool. Returns who took it. Caller holds
+    // writeMutex.
+    std::vector<uint32_t> FreeSeatLocked(uint32_t classId) {
+        std::vector<uint32_t> seated;
+        Snapshot pin = Pin();
+        const std::string& className = pin.Classes()[classId];
+        uint32_t studentId;
+        while (tables.seats.HandOff(classId, studentId, [&](uint32_t next) {
+            if (persistent) Enqueue({Mutation::Kind::LeaveWaitlist, 0, className, pin.Students()[next]});
+        })) {
+            if (EnrollLocked(classId, studentId, nullptr) == EnrollResult::Enrolled) {
+                seated.push_back(studentId);
+                break;
+            }
+        }
+        return seated;
+    }
+
+    // Hold a session with every member absent. Caller holds writeMutex.
+    uint32_t StartSessionLocked(uint32_t classId, const std::string& className, int32_t day) {
+        uint32_t index = tables.attendance.AddSession(classId, day);
+        uint32_t members = tables.attendance.Read([&](const AttendanceBook& attendance) {
+            return attendance.Class(classId)->sessions[index].members;
+        });
+        aggregates.AddAttendance(classId, 0, members);
+        if (persistent) {
+            Enqueue({Mutation::Kind::AddSession, 0, className,
+                     std::to_string(index) + '\t' + std::to_string(day) + '\t' + std::to_string(members)});
+        }
+        return index;
+    }
+
+    // Scores enter the class average as a percentage of the assessment's points
+    static double Percent(float score, float maxPoints) { return score * 100.0 / maxPoints; }
+
+    // Bring an index in line with its roster list. Entries are inserted in
+    // roster order, so a persisted index holds a prefix of the list; one that
+    // is ahead of the list (its roster save was lost) is rebuilt from scratch.
+    static void SyncIndex(NameIndex& index, const PagedList<std::string>& list) {
+        if (index.Size() > list.size()) index.Clear();
+        for (size_t i = index.Size(); i < list.size(); ++i) {
+            if (!index.Insert(list[i], static_cast<uint32_t>(i))) {
+                std::cerr << "Warning: a saved name is too long for the index and cannot be looked up.\n";
+            }
+        }
+    }
+};
+
+// Turns a stream of badge-reader scans into Model batches. Input arrives in
+// arbitrary chunks and is split into lines, one scan per line:
+//
+//     <time> <class> <student>     (separated by tabs or commas)
+//
+// where time is seconds since the epoch or a UTC date-time such as
+// 2026-10-16T08:01:22 (seconds optional). Readers repeat themselves, so a
+// scan of a student into a class within the dedupe window of the last one
+// accepted is dropped. Accepted scans are applied kBatchScans at a time, each
+// batch as one Model transaction.
+class ScanIngester {
+public:
+    static constexpr size_t kBatchScans = 4096;
+    static constexpr size_t kChunkBytes = 1 << 20;
+
+    struct Stats {
+        size_t lines = 0;
+        size_t malformed = 0;
+        size_t duplicates = 0;
+        size_t batches = 0;
+        ScanTotals totals;
+    };
+
+    explicit ScanIngester(Model& model, int64_t windowSeconds = 300) : model(model), window(windowSeconds) {
+        batch.reserve(kBatchScans);
+    }
+
+    // Parse every complete line in data; a trailing partial line waits for the next chunk
+    void Feed(const char* data, size_t size) {
+        const char* end = data + size;
+        while (data < end) {
+            const char* newline = static_cast<const char*>(std::memchr(data, '\n', end - data));
+            if (!newline) {
+                partial.append(data, end);
+                return;
+            }
+            if (partial.empty()) {
+                ParseLine(data, newline);
+            } else {
+                partial.append(data, newline);
+                ParseLine(partial.data(), partial.data() + partial.size());
+                partial.clear();
+            }
+            data = newline + 1;
+        }
+    }
+
+    // Read a whole log file ("-" for standard input); false if it cannot be opened
+    bool FeedFile(const std::string& path) {
+        std::FILE* in = path == "-" ? stdin : std::fopen(path.c_str(), "rb");
+        if (!in) return false;
+        std::vector<char> chunk(kChunkBytes);
+        size_t got;
+        while ((got = std::fread(chunk.data(), 1, chunk.size(), in)) > 0) Feed(chunk.data(), got);
+        if (in != stdin) std::fclose(in);
+        return true;
+    }
+
+    // Take a final unterminated line and apply whatever is left
+    void Finish() {
+        if (!partial.empty()) {
+            std::string last;
+            last.swap(partial);
+            ParseLine(last.data(), last.data() + last.size());
+        }
+        Apply();
+    }
+
+    const Stats& GetStats() const { return stats; }
+
+private:
+    Model& model;
+    int64_t window;
+    std::string partial;
+    std::vector<ScanEvent> batch;
+    std::unordered_map<std::string, int64_t> lastSeen; // "class<TAB>student" -> last accepted scan
+    int64_t newest = std::numeric_limits<int64_t>::min();
+    size_t pruneAt = 1 << 16;
+    Stats stats;
+
+    void ParseLine(const char* begin, const char* end) {
+        if (end > begin && end[-1] == '\r') --end;
+        const char* fields[3][2];
+        size_t count = 0;
+        for (const char* start = begin; count < 3; ++count) {
+            const char* stop = count < 2 ? std::find_if(start, end, [](char c) { return c == '\t' || c == ','; }) : end;
+            fields[count][0] = start;
+            fields[count][1] = stop;
+            while (fields[count][0] < stop && std::isspace(static_cast<unsigned char>(*fields[count][0]))) ++fields[count][0];
+            while (fields[count][1] > fields[count][0] && std::isspace(static_cast<unsigned char>(fields[count][1][-1]))) --fields[count][1];
+            if (stop == end) {
+                ++count;
+                break;
+            }
+            start = stop + 1;
+        }
+        if (count == 1 && fields[0][0] == fields[0][1]) return; // blank line
+        ++stats.lines;
+        ScanEvent scan;
+        if (count != 3 || fields[1][0] == fields[1][1] || fields[2][0] == fields[2][1]
+            || !ParseTime(fields[0][0], fields[0][1], scan.time)) {
+            ++stats.malformed;
+            return;
+        }
+        scan.className.assign(fields[1][0], fields[1][1]);
+        scan.studentName.assign(fields[2][0], fields[2][1]);
+
+        auto seen = lastSeen.emplace(scan.className + '\t' + scan.studentName, scan.time);
+        if (!seen.second) {
+            if (scan.time - seen.first->second < window && seen.first->second - scan.time < window) {
+                ++stats.duplicates;
+                return;
+            }
+            seen.first->second = std::max(seen.first->second, scan.time);
+        }
+        newest = std::max(newest, scan.time);
+        if (lastSeen.size() > pruneAt) Prune();
+        batch.push_back(std::move(scan));
+        if (batch.size() == kBatchScans) Apply();
+    }
+
+    // Forget scans too old to suppress anything
+    void Prune() {
+        for (auto it = lastSeen.begin(); it != lastSeen.end();) {
+            if (newest - it->second >= window) it = lastSeen.erase(it);
+            else ++it;
+        }
+        pruneAt = std::max<size_t>(1 << 16, lastSeen.size() * 2);
+    }
+
+    void Apply() {
+        if (batch.empty()) return;
+        model.ApplyScans(batch, stats.totals);
+        ++stats.batches;
+        batch.clear();
+    }
+
+    // Epoch seconds, or YYYY-MM-DD[(T| )HH:MM[:SS]][Z]
+    static bool ParseTime(const char* begin, const char* end, int64_t& time) {
+        std::string text(begin, end);
+        char* stop = nullptr;
+        if (text.find('-', 1) == std::string::npos) {
+            time = std::strtoll(text.c_str(), &stop, 10);
+            return !text.empty() && *stop == '\0';
+        }
+        int32_t day;
+        if (!ParseDate(text.substr(0, 10), day)) return false;
+        time = int64_t(day) * 86400;
+        if (text.size() > 10 && text.back() == 'Z') text.pop_back();
+        if (text.size() == 10) return true;
+        unsigned hour = 0, minute = 0, second = 0;
+        char separator = 0, colon1 = 0, colon2 = ':';
+        int used = 0;
+        if (std::sscanf(text.c_str() + 10, "%c%2u%c%2u%n", &separator, &hour, &colon1, &minute, &used) != 4
+            || (separator != 'T' && separator != ' ') || colon1 != ':' || hour > 23 || minute > 59) {
+            return false;
+        }
+        const char* rest = text.c_str() + 10 + used;
+        if (*rest && (std::sscanf(rest, "%c%2u%n", &colon2, &second, &used) != 2 || colon2 != ':' || second > 60 || rest[used])) {
+            return false;
+        }
+        time += hour * 3600 + minute * 60 + second;
+        return true;
+    }
+};
+
+// View: Manages all console output and input UI
+class View {
+public:
+    View() = default;
+
+    // Display header with app name and top nav, three menu entries per row
+    void DisplayHeader(const std::vector<std::string>& menuItems) {
+        ClearScreen();
+        using namespace std;
+        cout << COLOR_BOLD;
+        cout << "=============================================\n";
+        cout << "                VCLASS 1.0                   \n";
+        cout << "=============================================\n" << COLOR_RESET;
+        cout << "\n";
+        cout << COLOR_GRAY;
+        for (size_t i = 0; i < menuItems.size(); ++i) {
+            string item = to_string(i + 1) + ". " + menuItems[i];
+            cout << left << setw(22) << item << right;
+            if (i % 3 == 2 || i + 1 == menuItems.size()) cout << "\n";
+        }
+        cout << COLOR_RESET << "\n";
+    }
+
+    // Prompt user for menu choice between 1 and optionCount
+    int PromptMainMenuChoice(int optionCount) {
+        std::cout << "Choose an option (1-" << optionCount << "): ";
+        int choice = 0;
+        while (!(std::cin >> choice) || choice < 1 || choice > optionCount) {
+            std::cout << "Invalid input. Enter 1-" << optionCount << ": ";
+            std::cin.clear();
+            std::cin.ignore(std::numeric_limits<std::streamsize>::max(), '\n');
+        }
+        std::cin.ignore(std::numeric_limits<std::streamsize>::max(), '\n'); // flush newline
+        return choice;
+    }
+
+    // Prompt for a non-empty string with a label, return result trimmed
+    std::string PromptNonEmptyString(const std::string& prompt) {
+        std::string input;
+        do {
+            std::cout << prompt;
+            std::getline(std::cin, input);
+            Trim(input);
+            if (input.empty()) std::cout << "Input cannot be empty. Try again.\n";
+        } while (input.empty());
+        return input;
+    }
+
+    // Prompt for a line that may be left blank, return result trimmed
+    std::string PromptString(const std::string& prompt) {
+        std::string input;
+        std::cout << prompt;
+        std::getline(std::cin, input);
+        Trim(input);
+        return input;
+    }
+
+    // Display a "card"-style box with title and content lines
+    void DisplayCard(const std::string& title, const std::vector<std::string>& lines, int cardWidth = 50) {
+        using namespace std;
+        const std::string topBot = "╭" + std::string(cardWidth - 2, '_') + "╮\n";
+        const std::string bottom = "╰" + std::string(cardWidth - 2, '_') + "╯\n";
+
+        std::cout << COLOR_GRAY << topBot << COLOR_RESET;
+
+        // Title line centered, truncated if too long
+        std::string shown = title;
+        if ((int)shown.size() > cardWidth - 2) shown = shown.substr(0, cardWidth - 5) + "...";
+        int titlePad = cardWidth - 2 - (int)shown.size();
+        std::cout << "│" << std::string(titlePad / 2, ' ')
+                  << COLOR_BOLD << shown << COLOR_RESET
+                  << std::string(titlePad - titlePad / 2, ' ') << "│\n";
+
+        std::cout << "│" << std::string(cardWidth - 2, ' ') << "│\n";
+
+        // Content lines wrapped and padded
+        for (const auto& line : lines) {
+            std::cout << "│ " << line;
+            int padding = cardWidth - 3 - line.size();
+            std::cout << std::string(padding > 0 ? padding : 0, ' ') << "│\n";
+        }
+
+        std::cout << COLOR_GRAY << bottom << COLOR_RESET;
+    }
+
+    // Display list of cards in a grid style (2 per row)
+    void DisplayCardsGrid(const std::vector<std::pair<std::string, std::vector<std::string>>>& cards) {
+        int cardsPerRow = 2;
+        int cardWidth = 50;
+        size_t count = cards.size();
+        for (size_t i = 0; i < count; i += cardsPerRow) {
+            // collect line-by-line output for all cards in row to print side by side
+            // cards have 7 lines each (top+title+blank+3 content+bot)
+
+            std::vector<std::string> lines[7];
+
+            for (int c = 0; c < cardsPerRow; ++c) {
+                size_t idx = i + c;
+                if (idx >= count) break;
+                const auto& card = cards[idx];
+
+                // Compose card lines
+                lines[0].push_back("╭" + std::string(cardWidth - 2, '_') + "╮");
+                std::string title = card.first;
+                if ((int)title.size() > cardWidth - 2) // truncate title if too long
+                    title = title.substr(0, cardWidth - 5) + "...";
+                int titlePadLeft = (cardWidth - 2 - (int)title.size()) / 2;
+                int titlePadRight = cardWidth - 2 - (int)title.size() - titlePadLeft;
+                std::string titleLine = "│" + std::string(titlePadLeft, ' ') + COLOR_BOLD + title + COLOR_RESET + std::string(titlePadRight, ' ') + "│";
+                lines[1].push_back(titleLine);
+                lines[2].push_back("│" + std::string(cardWidth - 2, ' ') + "│");
+
+                // Up to 3 content lines, pad shorter lines with spaces
+                int contentLines = 3;
+                for (int ln = 0; ln < contentLines; ++ln) {
+                    if (ln < (int)card.second.size()) {
+                        std::string content = card.second[ln];
+                        if ((int)content.size() > cardWidth - 3) // truncate content if too long
+                            content = content.substr(0, cardWidth - 6) + "...";
+                        int padRight = cardWidth - 3 - content.size();
+                        lines[3 + ln].push_back("│ " + content + std::string(padRight, ' ') + "│");
+                    } else {
+                        lines[3 + ln].push_back("│" + std::string(cardWidth - 2, ' ') + "│");
+                    }
+                }
+
+                lines[6].push_back("╰" + std::string(cardWidth - 2, '_') + "╯");
+            }
+
+            // Print lines side by side separated by 4 spaces
+            for (int lineNum = 0; lineNum < 7; ++lineNum) {
+                for (size_t cardIdx = 0; cardIdx < lines[lineNum].size(); ++cardIdx) {
+                    std::cout << COLOR_GRAY << lines[lineNum][cardIdx] << COLOR_RESET;
+                    if (cardIdx != lines[lineNum].size() - 1)
+                        std::cout << "    "; // spacing between cards
+                }
+                std::cout << "\n";
+            }
+            std::cout << "\n";
+        }
+    }
+
+    // Display rows as a plain table with a bold header, columns sized to fit
+    void DisplayTable(const std::vector<std::string>& header, const std::vector<std::vector<std::string>>& rows) {
+        std::vector<size_t> widths;
+        for (const auto& h : header) widths.push_back(h.size());
+        for (const auto& row : rows) {
+            for (size_t c = 0; c < row.size() && c < widths.size(); ++c) widths[c] = std::max(widths[c], row[c].size());
+        }
+        std::cout << COLOR_BOLD;
+        for (size_t c = 0; c < header.size(); ++c) std::cout << std::left << std::setw(widths[c] + 2) << header[c];
+        std::cout << COLOR_RESET << "\n" << COLOR_GRAY;
+        for (const auto& row : rows) {
+            for (size_t c = 0; c < row.size() && c < widths.size(); ++c) std::cout << std::setw(widths[c] + 2) << row[c];
+            std::cout << "\n";
+        }
+        std::cout << std::right << COLOR_RESET;
+    }
+
+    // Display hero section with big headline, subtext and prompt
+    void DisplayHero() {
+        std::cout << COLOR_BOLD;
+        std::cout << "\n======================== WELCOME TO VCLASS ========================\n\n";
+        std::cout << COLOR_RESET;
+        std::cout << COLOR_GRAY;
+        std::cout << "Create and manage your virtual classes and students with ease.\n\n";
+        std::cout << COLOR_RESET;
+    }
+
+    // Display footer
+    void DisplayFooter() {
+        std::cout << COLOR_GRAY << "====================================================================\n";
+        std::cout << "                   © 2024 VClass Virtual Classroom                  \n";
+        std::cout << "====================================================================" << COLOR_RESET << "\n\n";
+    }
+
+    // Pause prompt
+    void Pause() {
+        std::cout << "Press Enter to continue...";
+        std::cin.ignore(std::numeric_limits<std::streamsize>::max(), '\n');
+    }
+
+private:
+    static void Trim(std::string& s) {
+        const char* ws = " \t\n\r\f\v";
+        s.erase(s.find_last_not_of(ws) + 1);
+        s.erase(0, s.find_first_not_of(ws));
+    }
+};
+
+// Controller: orchestrates program flow
+class Controller {
+public:
+    explicit Controller(const ModelOptions& options = ModelOptions()): model(options), view() {}
+
+    void Run() {
+        const std::vector<std::string> menu = {
+            "Add Class", "Add Student", "View Classes",
+            "View Students", "Enroll Student", "Student Details",
+            "Query Students", "Gradebook", "Attendance",
+            "Live Activity", "Timetable", "Registration", "Organization",
+            "Stats", "Quit"
+        };
+        view.DisplayHero();
+        bool running = true;
+        while (running) {
+            view.DisplayHeader(menu);
+            int choice = view.PromptMainMenuChoice(static_cast<int>(menu.size()));
+            switch(choice) {
+                case 1: AddClassFlow(); break;
+                case 2: AddStudentFlow(); break;
+                case 3: ViewClassesFlow(); break;
+                case 4: ViewStudentsFlow(); break;
+                case 5: EnrollFlow(); break;
+                case 6: StudentDetailsFlow(); break;
+                case 7: QueryStudentsFlow(); break;
+                case 8: GradebookFlow(); break;
+                case 9: AttendanceFlow(); break;
+                case 10: LiveActivityFlow(); break;
+                case 11: TimetableFlow(); break;
+                case 12: RegistrationFlow(); break;
+                case 13: OrganizationFlow(); break;
+                case 14: StatsFlow(); break;
+                case 15: running = false; break;
+            }
+        }
+        view.DisplayFooter();
+    }
+
+private:
+    Model model;
+    View view;
+
+    void AddClassFlow() {
+        std::string name = view.PromptNonEmptyString("Enter new class name: ");
+        if (model.AddClass(name)) {
+            std::cout << "\nClass \"" << name << "\" added successfully.\n\n";
+        } else {
+            std::cout << "\nClass \"" << name << "\" already exists.\n\n";
+        }
+        view.Pause();
+    }
+
+    void AddStudentFlow() {
+        std::string name = view.PromptNonEmptyString("Enter new student name: ");
+        switch (model.AddStudent(name)) {
+            case AddStudentResult::Added: std::cout << "\nStudent \"" << name << "\" added successfully.\n\n"; break;
+            case AddStudentResult::AlreadyExists: std::cout << "\nStudent \"" << name << "\" already exists.\n\n"; break;
+            case AddStudentResult::NameTooLong: std::cout << "\nThat name is too long for the student index.\n\n"; break;
+        }
+        view.Pause();
+    }
+
+    void EnrollFlow() {
+        std::string className = view.PromptNonEmptyString("Enter class name: ");
+        std::string studentName = view.PromptNonEmptyString("Enter student name: ");
+        TimetableConflict conflict;
+        switch (model.Enroll(className, studentName, &conflict)) {
+            case EnrollResult::Enrolled:
+                std::cout << "\nStudent \"" << studentName << "\" enrolled in \"" << className << "\".\n\n";
+                break;
+            case EnrollResult::AlreadyEnrolled:
+                std::cout << "\nStudent \"" << studentName << "\" is already enrolled in \"" << className << "\".\n\n";
+                break;
+            case EnrollResult::NoSuchClass:
+                std::cout << "\nClass \"" << className << "\" does not exist.\n\n";
+                break;
+            case EnrollResult::NoSuchStudent:
+                std::cout << "\nStudent \"" << studentName << "\" does not exist.\n\n";
+                break;
+            case EnrollResult::ScheduleConflict:
+                std::cout << "\n" << DescribeConflict(conflict) << "\n\n";
+                break;
+            case EnrollResult::MissingPrerequisite:
+                std::cout << "\nStudent \"" << studentName << "\" has not passed \""
+                          << model.MissingPrerequisite(className, studentName) << "\", a prerequisite of \"" << className << "\".\n\n";
+                break;
+            case EnrollResult::Waitlisted:
+            case EnrollResult::AlreadyWaitlisted: {
+                uint32_t classId = 0;
+                model.FindClass(className, classId);
+                auto waitlist = model.GetWaitlist(classId);
+                size_t place = std::find(waitlist.begin(), waitlist.end(), studentName) - waitlist.begin() + 1;
+                std::cout << "\n\"" << className << "\" is full. Student \"" << studentName << "\" is number " << place
+                          << " on its waitlist and will be enrolled when a seat frees up.\n\n";
+                break;
+            }
+        }
+        view.Pause();
+    }
+
+    // Seats and waitlists per class; set a capacity, drop a student or see who is waiting
+    void RegistrationFlow() {
+        for (;;) {
+            auto classes = model.GetClasses();
+            std::vector<std::vector<std::string>> rows;
+            for (size_t c = 0; c < classes.size(); ++c) {
+                SeatBook::Seats seats = model.GetSeats(static_cast<uint32_t>(c));
+                std::string needs;
+                for (const auto& name : model.GetPrerequisites(static_cast<uint32_t>(c))) needs += (needs.empty() ? "" : ", ") + name;
+                rows.push_back({classes[c], seats.capacity ? std::to_string(seats.capacity) : "-",
+                                std::to_string(seats.taken), std::to_string(seats.waiting), needs.empty() ? "-" : needs});
+            }
+            std::cout << "\n--- Registration ---\n\n";
+            if (rows.empty()) std::cout << "No classes available.\n\n";
+            else view.DisplayTable({"Class", "Capacity", "Enrolled", "Waiting", "Requires"}, rows);
+            std::cout << "\n";
+
+            std::string action = view.PromptString("c = set capacity, d = drop a student, w = show a waitlist, p = prerequisites, "
+                                                   "t = record a passed class, Enter to go back: ");
+            if (action.empty()) return;
+            if (action == "t") {
+                std::string studentName = view.PromptNonEmptyString("Student name: ");
+                std::string className = view.PromptNonEmptyString("Passed class: ");
+                if (!model.RecordCompletion(studentName, className)) {
+                    std::cout << "\nNo such student or class.\n\n";
+                    view.Pause();
+                }
+                continue;
+            }
+            if (action != "c" && action != "d" && action != "w" && action != "p") continue;
+            std::string className = view.PromptNonEmptyString("Class name: ");
+            uint32_t classId;
+            if (!model.FindClass(className, classId)) {
+                std::cout << "\nClass \"" << className << "\" does not exist.\n\n";
+                view.Pause();
+                continue;
+            }
+            if (action == "c") {
+                std::string input = view.PromptNonEmptyString("Capacity (0 for unlimited): ");
+                std::vector<std::string> promoted;
+                model.SetCapacity(className, static_cast<uint32_t>(std::strtoul(input.c_str(), nullptr, 10)), &promoted);
+                if (promoted.empty()) continue;
+                std::cout << "\nEnrolled from the waitlist:";
+                for (const auto& name : promoted) std::cout << " " << name;
+                std::cout << "\n\n";
+            } else if (action == "p") {
+                std::string prerequisite = view.PromptNonEmptyString("Prerequisite class: ");
+                bool required = view.PromptString("Require it? (y = add, n = remove): ") != "n";
+                switch (model.SetPrerequisite(className, prerequisite, required)) {
+                    case PrerequisiteResult::Added:
+                    case PrerequisiteResult::Removed: continue;
+                    case PrerequisiteResult::NoSuchClass: std::cout << "\nClass \"" << prerequisite << "\" does not exist.\n\n"; break;
+                    case PrerequisiteResult::AlreadyRequired: std::cout << "\nIt is already a prerequisite.\n\n"; break;
+                    case PrerequisiteResult::NotRequired: std::cout << "\nIt is not a prerequisite.\n\n"; break;
+                    case PrerequisiteResult::Cycle:
+                        std::cout << "\n\"" << prerequisite << "\" already depends on \"" << className << "\"; that would be a cycle.\n\n";
+                        break;
+                }
+            } else if (action == "d") {
+                std::string studentName = view.PromptNonEmptyString("Student name: ");
+                std::string promoted;
+                switch (model.Drop(className, studentName, &promoted)) {
+                    case DropResult::Dropped:
+                        std::cout << "\nStudent \"" << studentName << "\" dropped \"" << className << "\".\n";
+                        if (!promoted.empty()) std::cout << "Student \"" << promoted << "\" was enrolled from the waitlist.\n";
+                        std::cout << "\n";
+                        break;
+                    case DropResult::LeftWaitlist:
+                        std::cout << "\nStudent \"" << studentName << "\" left the waitlist.\n\n";
+                        break;
+                    case DropResult::NoSuchClass: std::cout << "\nThat class no longer exists.\n\n"; break;
+                    case DropResult::NoSuchStudent: std::cout << "\nStudent \"" << studentName << "\" does not exist.\n\n"; break;
+                    case DropResult::NotEnrolled:
+                        std::cout << "\nStudent \"" << studentName << "\" is neither enrolled in nor waiting for \"" << className << "\".\n\n";
+                        break;
+                }
+            } else {
+                auto waitlist = model.GetWaitlist(classId);
+                std::vector<std::vector<std::string>> waiting;
+                for (size_t i = 0; i < waitlist.size(); ++i) waiting.push_back({std::to_string(i + 1), waitlist[i]});
+                std::cout << "\n";
+                if (waiting.empty()) std::cout << "Nobody is waiting for " << className << ".\n";
+                else view.DisplayTable({"#", "Student"}, waiting);
+                std::cout << "\n";
+            }
+            view.Pause();
+        }
+    }
+
+    // Show a student's attributes and let the user change them; blank keeps a value
+    void StudentDetailsFlow() {
+        std::string name = view.PromptNonEmptyString("Enter student name: ");
+        StudentAttributes row;
+        if (!model.GetStudentAttributes(name, row)) {
+            std::cout << "\nStudent \"" << name << "\" does not exist.\n\n";
+            view.Pause();
+            return;
+        }
+        std::cout << "\n";
+        view.DisplayCard(name, DescribeAttributes(row));
+        std::cout << "\nEnter new values, or leave blank to keep the current one.\n";
+
+        std::string input = view.PromptString("Grade level (1-12, 0 for none): ");
+        if (!input.empty()) {
+            int grade = std::atoi(input.c_str());
+            if (grade >= 0 && grade <= 12) row.gradeLevel = static_cast<uint8_t>(grade);
+            else std::cout << "Grade level must be 0-12; kept the current one.\n";
+        }
+        input = view.PromptString("Cohort (- for none): ");
+        if (!input.empty()) row.cohort = input == "-" ? "" : input;
+        input = view.PromptString("Status (active, on leave, graduated, withdrawn): ");
+        if (!input.empty() && !ParseStatus(input, row.status)) {
+            std::cout << "Unknown status; kept the current one.\n";
+        }
+        input = view.PromptString("Enrollment date (YYYY-MM-DD): ");
+        if (!input.empty() && !ParseDate(input, row.enrollmentDay)) {
+            std::cout << "Dates look like 2025-09-01; kept the current one.\n";
+        }
+        input = view.PromptString("GPA (0.0-4.0, - for none): ");
+        if (input == "-") {
+            row.gpa = std::numeric_limits<float>::quiet_NaN();
+        } else if (!input.empty()) {
+            char* end = nullptr;
+            float gpa = std::strtof(input.c_str(), &end);
+            if (*end == '\0' && gpa >= 0.0f && gpa <= 4.0f) row.gpa = gpa;
+            else std::cout << "GPA must be between 0.0 and 4.0; kept the current one.\n";
+        }
+
+        if (model.SetStudentAttributes(name, row)) {
+            std::cout << "\nDetails for \"" << name << "\" saved.\n\n";
+        }
+        view.Pause();
+    }
+
+    // Read comma-separated conditions; on a malformed one, explain and return false
+    bool PromptConditions(const std::string& prompt, std::vector<StudentPredicate>& where) {
+        std::stringstream conditions(view.PromptString(prompt));
+        std::string condition;
+        while (std::getline(conditions, condition, ',')) {
+            StudentPredicate predicate;
+            if (condition.find_first_not_of(" \t") == std::string::npos) continue;
+            if (!ParsePredicate(condition, predicate)) {
+                std::cout << "\nCould not understand \"" << condition << "\". Conditions look like gpa>3.0,"
+                          << " cohort=2026, status!=withdrawn or enrolled>=2025-09-01.\n\n";
+                view.Pause();
+                return false;
+            }
+            where.push_back(predicate);
+        }
+        return true;
+    }
+
+    // Build a StudentQuery from a few prompts and show the result as a table
+    void QueryStudentsFlow() {
+        StudentQuery query;
+        if (!PromptConditions("Where (e.g. status=active, gpa>3.0; blank for all): ", query.where)) return;
+
+        std::string input = view.PromptString("Group by (grade, cohort, status; blank to list students): ");
+        if (!input.empty()) {
+            if (!ParseColumn(input, query.groupBy) || query.groupBy == StudentColumn::Name
+                || query.groupBy == StudentColumn::Gpa || query.groupBy == StudentColumn::EnrollmentDate) {
+                std::cout << "\nStudents can be grouped by grade, cohort or status.\n\n";
+                view.Pause();
+                return;
+            }
+            query.grouped = true;
+            input = view.PromptString("Aggregate (count, or avg/min/max/sum of gpa, grade or enrolled) [count]: ");
+            std::istringstream words(input);
+            std::string function, column;
+            words >> function >> column;
+            static const std::map<std::string, StudentQuery::Aggregate> functions = {
+                {"count", StudentQuery::Aggregate::Count}, {"avg", StudentQuery::Aggregate::Average},
+                {"min", StudentQuery::Aggregate::Min}, {"max", StudentQuery::Aggregate::Max},
+                {"sum", StudentQuery::Aggregate::Sum}
+            };
+            auto found = functions.find(function.empty() ? "count" : function);
+            bool valid = found != functions.end();
+            if (valid) query.aggregate = found->second;
+            if (valid && query.aggregate != StudentQuery::Aggregate::Count) {
+                valid = ParseColumn(column, query.aggregateColumn) && (query.aggregateColumn == StudentColumn::Gpa
+                    || query.aggregateColumn == StudentColumn::GradeLevel || query.aggregateColumn == StudentColumn::EnrollmentDate);
+            }
+            if (!valid) {
+                std::cout << "\nAggregates look like count, avg gpa or max grade.\n\n";
+                view.Pause();
+                return;
+            }
+        }
+
+        input = view.PromptString(query.grouped ? "Order by (key or value, add desc) [key]: "
+                                                : "Order by (name, grade, cohort, status, enrolled, gpa; add desc) [name]: ");
+        std::istringstream order(input);
+        std::string orderColumn, direction;
+        order >> orderColumn >> direction;
+        query.descending = direction == "desc";
+        if (query.grouped) {
+            query.orderByAggregate = orderColumn == "value";
+        } else if (!orderColumn.empty() && !ParseColumn(orderColumn, query.orderBy)) {
+            std::cout << "\nUnknown column \"" << orderColumn << "\"; ordering by name.\n";
+        }
+        input = view.PromptString("Limit (blank for no limit): ");
+        query.limit = static_cast<size_t>(std::max(0, std::atoi(input.c_str())));
+
+        QueryResult result = model.Query(query);
+        std::cout << "\n" << result.matched << " students matched"
+                  << (result.index.empty() ? std::string(" (full scan)") : " (using " + result.index + " index)") << ".\n\n";
+        if (!result.rows.empty()) {
+            view.DisplayTable(result.header, result.rows);
+            std::cout << "\n";
+        }
+        view.Pause();
+    }
+
+    // Three card lines summarizing a student's attributes
+    static std::vector<std::string> DescribeAttributes(const StudentAttributes& row) {
+        std::ostringstream gpa;
+        if (std::isnan(row.gpa)) gpa << "-";
+        else gpa << std::fixed << std::setprecision(2) << row.gpa;
+        return {
+            "Grade: " + (row.gradeLevel ? std::to_string(row.gradeLevel) : std::string("-"))
+                + "   Cohort: " + (row.cohort.empty() ? std::string("-") : row.cohort),
+            std::string("Status: ") + StatusName(row.status) + "   GPA: " + gpa.str(),
+            "Enrolled: " + (row.enrollmentDay ? FormatDate(row.enrollmentDay) : std::string("-"))
+        };
+    }
+
+    // A class's assessments as cards with live statistics, plus grade entry and curves
+    void GradebookFlow() {
+        std::string className = view.PromptNonEmptyString("Enter class name: ");
+        uint32_t classId;
+        if (!model.FindClass(className, classId)) {
+            std::cout << "\nClass \"" << className << "\" does not exist.\n\n";
+            view.Pause();
+            return;
+        }
+        for (;;) {
+            std::vector<std::pair<std::string, std::vector<std::string>>> cards;
+            size_t members = 0;
+            model.Grades().Read([&](const Gradebook& grades) {
+                const Gradebook::ClassBook* book = grades.Class(classId);
+                if (!book) return;
+                members = book->members.size();
+                for (const auto& assessment : book->assessments) {
+                    ColumnStats stats = ComputeColumnStats(assessment.scores.data(), assessment.scores.size(), assessment.maxPoints);
+                    std::vector<std::string> lines = DescribeStats(stats);
+                    if (stats.count > 0) {
+                        // The sketch holds percentages; show points like the other figures
+                        std::ostringstream percentiles;
+                        percentiles << std::fixed << std::setprecision(1)
+                                    << "  Med " << assessment.sketch.Quantile(0.5) * assessment.maxPoints / 100
+                                    << "  P90 " << assessment.sketch.Quantile(0.9) * assessment.maxPoints / 100;
+                        lines[1] += percentiles.str();
+                    }
+                    cards.emplace_back(assessment.name + " (/" + FormatFloat(assessment.maxPoints) + ")", lines);
+                }
+            });
+            std::cout << "\n--- Gradebook: " << className << " (" << members << " students) ---\n";
+            if (cards.empty()) std::cout << "\nNo assessments yet.\n\n";
+            else view.DisplayCardsGrid(cards);
+
+            std::string action = view.PromptString("a = add assessment, g = enter grade, c = curve, Enter to go back: ");
+            if (action.empty()) return;
+            GradebookResult result = GradebookResult::Ok;
+            if (action == "a") {
+                std::string name = view.PromptNonEmptyString("Assessment name: ");
+                std::string points = view.PromptString("Maximum points [100]: ");
+                result = model.AddAssessment(className, name, points.empty() ? 100.0f : std::strtof(points.c_str(), nullptr));
+            } else if (action == "g") {
+                std::string assessment = view.PromptNonEmptyString("Assessment name: ");
+                std::string student = view.PromptNonEmptyString("Student name: ");
+                std::string score = view.PromptNonEmptyString("Score (- to clear): ");
+                float value = score == "-" ? Gradebook::kUngraded : std::strtof(score.c_str(), nullptr);
+                result = model.SetGrade(className, assessment, student, value);
+            } else if (action == "c") {
+                std::string assessment = view.PromptNonEmptyString("Assessment name: ");
+                std::string kind = view.PromptNonEmptyString("Curve (add N points, scale to mean N, sqrt): ");
+                std::istringstream words(kind);
+                std::string word;
+                float param = 0;
+                words >> word;
+                while (words >> std::ws && !words.eof() && !(words >> param)) {
+                    words.clear();
+                    words >> kind; // skip "N points" / "to mean" filler
+                }
+                CurveKind curve = word == "sqrt" ? CurveKind::SquareRoot
+                                : word == "scale" ? CurveKind::ScaleToMean : CurveKind::AddPoints;
+                if (word != "sqrt" && word != "scale" && word != "add") {
+                    std::cout << "Curves are \"add 5\", \"scale 75\" or \"sqrt\".\n";
+                    continue;
+                }
+                result = model.CurveAssessment(className, assessment, curve, param);
+            } else {
+                continue;
+            }
+            switch (result) {
+                case GradebookResult::Ok: break;
+                case GradebookResult::NoSuchClass: std::cout << "\nThat class no longer exists.\n\n"; break;
+                case GradebookResult::NoSuchStudent: std::cout << "\nNo such student.\n\n"; break;
+                case GradebookResult::NotEnrolled: std::cout << "\nThat student is not enrolled in " << className << ".\n\n"; break;
+                case GradebookResult::NoSuchAssessment: std::cout << "\nNo such assessment.\n\n"; break;
+                case GradebookResult::DuplicateAssessment: std::cout << "\nThat assessment already exists.\n\n"; break;
+                case GradebookResult::OutOfRange: std::cout << "\nScores and points must lie between 0 and the maximum.\n\n"; break;
+            }
+            if (result != GradebookResult::Ok) view.Pause();
+        }
+    }
+
+    // Per-student attendance for one class, with students who missed three or
+    // more sessions this month; take a session or correct a single mark
+    void AttendanceFlow() {
+        const size_t maxCards = 24;
+        std::string className = view.PromptNonEmptyString("Enter class name: ");
+        uint32_t classId;
+        if (!model.FindClass(className, classId)) {
+            std::cout << "\nClass \"" << className << "\" does not exist.\n\n";
+            view.Pause();
+            return;
+        }
+        for (;;) {
+            auto students = model.GetStudents();
+            std::vector<std::pair<std::string, std::vector<std::string>>> cards;
+            std::vector<uint32_t> absentees;
+            size_t members = 0, sessions = 0;
+            int32_t monthStart, monthEnd;
+            MonthBounds(Today(), monthStart, monthEnd);
+            model.Attendance().Read([&](const AttendanceBook& attendance) {
+                const AttendanceBook::ClassSessions* book = attendance.Class(classId);
+                if (!book) return;
+                members = book->members.size();
+                sessions = book->sessions.size();
+                for (size_t row = 0; row < members && row < maxCards; ++row) {
+                    AttendanceBook::StudentSummary summary = attendance.Summarize(classId, book->members[row]);
+                    std::ostringstream rate;
+                    rate << "Attended " << summary.attended << " of " << summary.sessions;
+                    if (summary.sessions) rate << std::fixed << std::setprecision(0) << " (" << summary.attended * 100.0 / summary.sessions << "%)";
+                    cards.emplace_back(students[book->members[row]], std::vector<std::string>{
+                        rate.str(),
+                        "Current streak: " + std::to_string(summary.currentStreak),
+                        "Longest absence: " + std::to_string(summary.longestAbsence)
+                    });
+                }
+                absentees = attendance.FrequentAbsentees(classId, monthStart, monthEnd, 3);
+            });
+            std::cout << "\n--- Attendance: " << className << " (" << members << " students, " << sessions << " sessions) ---\n";
+            if (cards.empty()) {
+                std::cout << "\nNo students enrolled yet.\n\n";
+            } else {
+                view.DisplayCardsGrid(cards);
+                if (members > cards.size()) std::cout << "...and " << members - cards.size() << " more.\n\n";
+            }
+            std::cout << "Absent 3+ times this month:";
+            for (size_t i = 0; i < absentees.size(); ++i) std::cout << (i ? ", " : " ") << students[absentees[i]];
+            std::cout << (absentees.empty() ? " nobody.\n\n" : ".\n\n");
+
+            std::string action = view.PromptString("t = take attendance, m = mark one student, i = import scan log, Enter to go back: ");
+            if (action.empty()) return;
+            if (action == "i") {
+                ImportScansFlow();
+                continue;
+            }
+            if (action != "t" && action != "m") continue;
+            int32_t day = Today();
+            std::string date = view.PromptString("Session date (YYYY-MM-DD, blank for today): ");
+            if (!date.empty() && !ParseDate(date, day)) {
+                std::cout << "Dates look like 2025-09-01.\n";
+                continue;
+            }
+            std::vector<std::pair<std::string, bool>> marks;
+            if (action == "t") {
+                if (model.StartSession(className, day) < 0) return;
+                std::stringstream names(view.PromptString("Students present (comma-separated, blank for none): "));
+                std::string name;
+                while (std::getline(names, name, ',')) {
+                    name.erase(name.find_last_not_of(" \t") + 1);
+                    name.erase(0, name.find_first_not_of(" \t"));
+                    if (!name.empty()) marks.emplace_back(name, true);
+                }
+            } else {
+                std::string name = view.PromptNonEmptyString("Student name: ");
+                std::string mark = view.PromptNonEmptyString("Present or absent (p/a): ");
+                marks.emplace_back(name, mark == "p" || mark == "present");
+            }
+            switch (model.MarkAttendance(className, day, marks)) {
+                case AttendanceResult::Ok: continue;
+                case AttendanceResult::NoSuchClass: std::cout << "\nThat class no longer exists.\n\n"; break;
+                case AttendanceResult::NoSuchStudent: std::cout << "\nSome names are not students; the rest were marked.\n\n"; break;
+                case AttendanceResult::NotEnrolled:
+                    std::cout << "\nSome students were not enrolled in " << className << " by that session; the rest were marked.\n\n";
+                    break;
+                case AttendanceResult::NoSuchSession: std::cout << "\nNo session of " << className << " on " << FormatDate(day) << ".\n\n"; break;
+            }
+            view.Pause();
+        }
+    }
+
+    // A class's activity over the last hour by type, its latest events, and a
+    // way to record one
+    void LiveActivityFlow() {
+        const size_t recentShown = 10;
+        std::string className = view.PromptNonEmptyString("Enter class name: ");
+        uint32_t classId;
+        if (!model.FindClass(className, classId)) {
+            std::cout << "\nClass \"" << className << "\" does not exist.\n\n";
+            view.Pause();
+            return;
+        }
+        for (;;) {
+            auto students = model.GetStudents();
+            int64_t now = NowMs();
+            std::map<std::string, size_t> byType;
+            std::deque<std::vector<std::string>> recent;
+            model.ScanEvents(classId, now - 3600 * 1000, now + 1, "", [&](int64_t time, const std::string& type, uint32_t studentId) {
+                ++byType[type];
+                std::string who = studentId < students.size() ? students[studentId] : std::string("-");
+                recent.push_back({FormatTimestamp(time), type, who});
+                if (recent.size() > recentShown) recent.pop_front();
+            });
+            std::cout << "\n--- Live Activity: " << className << " ---\n\n";
+            std::vector<std::string> quiet;
+            for (const auto& score : model.LeastEngaged(classId, 5)) {
+                quiet.push_back(students[score.studentId] + ": " + std::to_string(score.sliding)
+                                + " (previous 5 min: " + std::to_string(score.lastTumbling) + ")");
+            }
+            if (!quiet.empty()) {
+                view.DisplayCard("Least Engaged, Last 5 Minutes", quiet);
+                std::cout << "\n";
+            }
+            if (byType.empty()) {
+                std::cout << "No activity in the last hour.\n\n";
+            } else {
+                std::vector<std::string> lines;
+                for (const auto& count : byType) lines.push_back(count.first + ": " + std::to_string(count.second));
+                view.DisplayCard("Last Hour", lines);
+                std::cout << "\n";
+                view.DisplayTable({"Time", "Event", "Student"}, {recent.begin(), recent.end()});
+                std::cout << "\n";
+            }
+            std::string action = view.PromptString("r = record event, Enter to go back: ");
+            if (action.empty()) return;
+            if (action != "r") continue;
+            std::string type = view.PromptNonEmptyString("Event (join, leave, hand, chat, reaction, ...): ");
+            std::string student = view.PromptString("Student (blank for the whole class): ");
+            if (!model.RecordEvent(className, student, type, NowMs())) {
+                std::cout << "\nNo such student.\n\n";
+                view.Pause();
+            }
+        }
+    }
+
+    // Every class's schedule; set one, or check the whole timetable
+    void TimetableFlow() {
+        const size_t maxShown = 20;
+        for (;;) {
+            auto classes = model.GetClasses();
+            std::vector<std::vector<std::string>> rows;
+            for (size_t c = 0; c < classes.size(); ++c) {
+                ClassSchedule schedule = model.GetSchedule(static_cast<uint32_t>(c));
+                rows.push_back({classes[c], schedule.teacher.empty() ? "-" : schedule.teacher,
+                                schedule.room.empty() ? "-" : schedule.room,
+                                schedule.meetings.empty() ? "-" : FormatMeetings(schedule.meetings)});
+            }
+            std::cout << "\n--- Timetable ---\n\n";
+            if (rows.empty()) std::cout << "No classes available.\n\n";
+            else view.DisplayTable({"Class", "Teacher", "Room", "Meets"}, rows);
+            std::cout << "\n";
+
+            std::string action = view.PromptString("s = schedule a class, v = validate timetable, r = room seats, "
+                                                   "h = teacher hours, a = auto-schedule, Enter to go back: ");
+            if (action.empty()) return;
+            if (action == "r") {
+                std::string room = view.PromptNonEmptyString("Room: ");
+                std::string seats = view.PromptNonEmptyString("Seats (0 to remove): ");
+                model.SetRoom(room, static_cast<uint32_t>(std::strtoul(seats.c_str(), nullptr, 10)));
+                continue;
+            }
+            if (action == "h") {
+                std::string teacher = view.PromptNonEmptyString("Teacher: ");
+                std::vector<Meeting> hours;
+                if (!ParseMeetings(view.PromptString("Available (e.g. Mon 08:00-12:00, Tue 08:00-16:00; blank for any time): "), hours)) {
+                    std::cout << "\nHours look like \"Mon 08:00-12:00\", separated by commas, and must not overlap.\n\n";
+                    view.Pause();
+                    continue;
+                }
+                model.SetAvailability(teacher, hours);
+                continue;
+            }
+            if (action == "a") {
+                AutoScheduleFlow();
+                continue;
+            }
+            if (action == "v") {
+                TimetableReport report = model.ValidateTimetable();
+                std::ostringstream summary;
+                summary << std::fixed << std::setprecision(2) << report.studentsChecked << " students checked in "
+                        << report.milliseconds << " ms on " << report.threads << " thread(s)";
+                std::cout << "\n" << summary.str() << ".\n";
+                if (report.conflicts.empty()) std::cout << "No double bookings.\n";
+                for (size_t i = 0; i < report.conflicts.size() && i < maxShown; ++i) {
+                    std::cout << "  " << DescribeConflict(report.conflicts[i]) << "\n";
+                }
+                if (report.conflicts.size() > maxShown) std::cout << "  ...and " << report.conflicts.size() - maxShown << " more.\n";
+                std::cout << "\n";
+                view.Pause();
+                continue;
+            }
+            if (action != "s") continue;
+            std::string className = view.PromptNonEmptyString("Class name: ");
+            uint32_t classId;
+            if (!model.FindClass(className, classId)) {
+                std::cout << "\nClass \"" << className << "\" does not exist.\n\n";
+                view.Pause();
+                continue;
+            }
+            ClassSchedule schedule = model.GetSchedule(classId);
+            std::cout << "Leave blank to keep the current value, - to clear it.\n";
+            std::string input = view.PromptString("Teacher: ");
+            if (!input.empty()) schedule.teacher = input == "-" ? "" : input;
+            input = view.PromptString("Room: ");
+            if (!input.empty()) schedule.room = input == "-" ? "" : input;
+            input = view.PromptString("Meetings (e.g. Mon 09:00-10:30, Wed 09:00-10:30): ");
+            if (input == "-") {
+                schedule.meetings.clear();
+            } else if (!input.empty() && !ParseMeetings(input, schedule.meetings)) {
+                std::cout << "\nMeetings look like \"Mon 09:00-10:30\", separated by commas, and must not overlap.\n\n";
+                view.Pause();
+                continue;
+            }
+            TimetableConflict conflict;
+            switch (model.SetSchedule(className, schedule, conflict)) {
+                case ScheduleResult::Ok: continue;
+                case ScheduleResult::NoSuchClass: std::cout << "\nThat class no longer exists.\n\n"; break;
+                case ScheduleResult::Conflict: std::cout << "\n" << DescribeConflict(conflict) << "\n\n"; break;
+            }
+            view.Pause();
+        }
+    }
+
+    // Solve the whole term's timetable against the declared rooms, show how
+    // the best solution improved, and offer to apply it
+    void AutoScheduleFlow() {
+        TimetableProblem problem = model.BuildTimetableProblem();
+        if (problem.classes.empty() || problem.rooms.empty()) {
+            std::cout << "\nAdd classes and at least one room (r) first.\n\n";
+            view.Pause();
+            return;
+        }
+        std::string input = view.PromptString("Seconds to search (default 5): ");
+        double seconds = input.empty() ? 5.0 : std::strtod(input.c_str(), nullptr);
+        if (!(seconds > 0)) seconds = 5.0;
+        std::cout << "\nSearching...\n";
+        TimetableSolution solution = model.SolveTimetable(problem, seconds);
+
+        std::vector<std::vector<std::string>> rows;
+        for (const auto& step : solution.timeline) {
+            std::ostringstream at;
+            at << std::fixed << std::setprecision(1) << step.milliseconds;
+            rows.push_back({at.str(), std::to_string(step.violations), std::to_string(step.penalty), std::to_string(step.thread)});
+        }
+        const size_t maxShown = 15;
+        if (rows.size() > maxShown) rows.erase(rows.begin() + 1, rows.end() - (maxShown - 1));
+        std::cout << "\n";
+        view.DisplayTable({"ms", "Violations", "Penalty", "Thread"}, rows);
+        std::cout << "\n" << solution.moves << " moves on " << solution.threads << " thread(s).\n\n";
+
+        auto classes = model.GetClasses();
+        std::vector<std::vector<std::string>> proposed;
+        for (size_t c = 0; c < problem.classes.size(); ++c) {
+            ClassSchedule schedule = solution.Schedule(problem, c);
+            proposed.push_back({classes[problem.classes[c].classId], schedule.teacher.empty() ? "-" : schedule.teacher,
+                                schedule.room, FormatMeetings(schedule.meetings)});
+        }
+        view.DisplayTable({"Class", "Teacher", "Room", "Meets"}, proposed);
+        std::cout << "\n";
+        if (solution.violations > 0) {
+            std::cout << "The best timetable found still breaks " << solution.violations
+                      << " constraint(s); add rooms, widen teacher hours or search longer.\n\n";
+            view.Pause();
+            return;
+        }
+        if (view.PromptString("Apply this timetable? (y/n): ") != "y") return;
+        TimetableConflict conflict;
+        switch (model.ApplyTimetable(problem, solution, conflict)) {
+            case ScheduleResult::Ok: std::cout << "\nTimetable applied.\n\n"; break;
+            case ScheduleResult::NoSuchClass: std::cout << "\nThe classes changed while solving; try again.\n\n"; break;
+            case ScheduleResult::Conflict: std::cout << "\n" << DescribeConflict(conflict) << "\n\n"; break;
+        }
+        view.Pause();
+    }
+
+    std::string DescribeConflict(const TimetableConflict& conflict) {
+        auto classes = model.GetClasses();
+        auto name = [&](uint32_t classId) { return classId < classes.size() ? classes[classId] : std::string("?"); };
+        if (conflict.classId == conflict.otherClass) {
+            return name(conflict.classId) + " would meet twice at once: " + FormatMeetings({conflict.when})
+                 + " overlaps another of its meetings.";
+        }
+        return "Double booking for " + conflict.resource + ": " + name(conflict.classId) + " ("
+             + FormatMeetings({conflict.when}) + ") overlaps " + name(conflict.otherClass) + ".";
+    }
+
+    // Import a badge-reader log; scans may be for any class
+    void ImportScansFlow() {
+        std::string path = view.PromptNonEmptyString("Scan log file: ");
+        ScanIngester ingester(model);
+        if (!ingester.FeedFile(path)) {
+            std::cout << "\nCould not open \"" << path << "\".\n\n";
+            view.Pause();
+            return;
+        }
+        ingester.Finish();
+        std::cout << "\n";
+        view.DisplayCard("Scan Import", DescribeIngest(ingester.GetStats()));
+        std::cout << "\n";
+        view.Pause();
+    }
+
+    static std::vector<std::string> DescribeIngest(const ScanIngester::Stats& stats) {
+        return {
+            std::to_string(stats.lines) + " scans in " + std::to_string(stats.batches) + " batches",
+            "Marked present: " + std::to_string(stats.totals.marked),
+            "Repeats dropped: " + std::to_string(stats.duplicates + stats.totals.alreadyPresent),
+            "Sessions started: " + std::to_string(stats.totals.sessionsStarted),
+            "Unknown or not enrolled: " + std::to_string(stats.totals.unknown + stats.totals.notEnrolled),
+            "Malformed lines: " + std::to_string(stats.malformed)
+        };
+    }
+
+    // Three card lines for an assessment's statistics; the last is a
+    // histogram over tenths of the maximum, darker characters for more scores
+    static std::vector<std::string> DescribeStats(const ColumnStats& stats) {
+        if (stats.count == 0) return {"No scores yet."};
+        std::ostringstream summary, range;
+        summary << std::fixed << std::setprecision(1) << "Mean " << stats.mean << "  SD " << std::sqrt(stats.variance)
+                << "  n=" << stats.count;
+        range << std::fixed << std::setprecision(1) << "Min " << stats.min << "  Max " << stats.max;
+        const char ramp[] = " .:-=+*#%@";
+        uint32_t peak = *std::max_element(stats.histogram, stats.histogram + 10);
+        std::string bars = "0% |";
+        for (uint32_t count : stats.histogram) bars += ramp[count == 0 ? 0 : 1 + (count * 8) / peak];
+        bars += "| 100%";
+        return {summary.str(), range.str(), bars};
+    }
+
+    // The organization chart with live totals per unit; each unit's totals
+    // and student list cover only the classes beneath it
+    void OrganizationFlow() {
+        for (;;) {
+            std::vector<OrganizationTree::Node> chart = model.Organization().Chart(OrganizationTree::kRoot);
+            std::vector<std::vector<std::string>> rows;
+            for (const auto& node : chart) {
+                if (node.unit == OrganizationTree::kRoot) continue;
+                ClassAggregates::Totals totals = model.GetUnitTotals(node.unit);
+                std::ostringstream grade, attendance;
+                if (std::isnan(totals.averageGrade)) grade << "-";
+                else grade << std::fixed << std::setprecision(1) << totals.averageGrade;
+                if (std::isnan(totals.attendanceRate)) attendance << "-";
+                else attendance << std::fixed << std::setprecision(1) << totals.attendanceRate * 100 << "%";
+                rows.push_back({std::string(2 * (node.depth - 1), ' ') + node.name, std::to_string(node.classes),
+                                std::to_string(totals.enrolled), grade.str(), attendance.str()});
+            }
+            size_t unplaced = chart[0].ownClasses;
+            std::cout << "\n--- Organization ---\n\n";
+            if (rows.empty()) std::cout << "No units yet.\n";
+            else view.DisplayTable({"Unit", "Classes", "Enrollments", "Avg Grade", "Attendance"}, rows);
+            if (unplaced) std::cout << "\n" << unplaced << " classes are not in any unit.\n";
+            std::cout << "\n";
+
+            std::string action = view.PromptString("u = add a unit, p = place a class, s = students under a unit, Enter to go back: ");
+            if (action.empty()) return;
+            if (action == "u") {
+                std::string name = view.PromptNonEmptyString("Unit name: ");
+                std::string parent = view.PromptString("Inside unit (blank for top level): ");
+                switch (model.AddUnit(name, parent)) {
+                    case OrganizationResult::Ok: continue;
+                    case OrganizationResult::NoSuchUnit: std::cout << "\nUnit \"" << parent << "\" does not exist.\n\n"; break;
+                    case OrganizationResult::DuplicateUnit: std::cout << "\nUnit \"" << name << "\" already exists.\n\n"; break;
+                    case OrganizationResult::NoSuchClass: break;
+                }
+            } else if (action == "p") {
+                std::string className = view.PromptNonEmptyString("Class name: ");
+                std::string unit = view.PromptString("Unit (blank to take it out of every unit): ");
+                switch (model.PlaceClass(className, unit)) {
+                    case OrganizationResult::Ok: continue;
+                    case OrganizationResult::NoSuchClass: std::cout << "\nClass \"" << className << "\" does not exist.\n\n"; break;
+                    case OrganizationResult::NoSuchUnit: std::cout << "\nUnit \"" << unit << "\" does not exist.\n\n"; break;
+                    case OrganizationResult::DuplicateUnit: break;
+                }
+            } else if (action == "s") {
+                std::string name = view.PromptNonEmptyString("Unit name: ");
+                uint32_t unit;
+                if (!model.Organization().FindUnit(name, unit)) {
+                    std::cout << "\nUnit \"" << name << "\" does not exist.\n\n";
+                } else {
+                    std::vector<std::string> students = model.StudentsUnder(unit);
+                    std::vector<std::vector<std::string>> listed;
+                    for (size_t i = 0; i < students.size(); ++i) listed.push_back({std::to_string(i + 1), students[i]});
+                    std::cout << "\n";
+                    if (listed.empty()) std::cout << "No students are enrolled in classes under " << name << ".\n";
+                    else view.DisplayTable({"#", "Student"}, listed);
+                    std::cout << "\n";
+                }
+            } else {
+                continue;
+            }
+            view.Pause();
+        }
+    }
+
+    void ViewClassesFlow() {
+        // Totals are maintained as the roster changes, so each card is O(1)
+        auto classes = model.GetClasses();
+        if (classes.empty()) {
+            std::cout << "\nNo classes available.\n\n";
+        } else {
+            std::vector<std::pair<std::string, std::vector<std::string>>> cards;
+            for (size_t i = 0; i < classes.size(); ++i) {
+                ClassAggregates::Totals totals = model.GetClassTotals(static_cast<uint32_t>(i));
+                std::ostringstream grade, attendance;
+                if (std::isnan(totals.averageGrade)) grade << "-";
+                else grade << std::fixed << std::setprecision(1) << totals.averageGrade;
+                if (std::isnan(totals.attendanceRate)) attendance << "-";
+                else attendance << std::fixed << std::setprecision(1) << totals.attendanceRate * 100 << "%";
+                SeatBook::Seats seats = model.GetSeats(static_cast<uint32_t>(i));
+                // The grid shows three lines, so seats share the enrollment line
+                std::string enrolled = std::to_string(totals.enrolled) + " students enrolled.";
+                if (seats.capacity) {
+                    enrolled = "Seats: " + std::to_string(seats.taken) + "/" + std::to_string(seats.capacity)
+                             + " enrolled, " + std::to_string(seats.waiting) + " waiting";
+                }
+                cards.emplace_back(classes[i], std::vector<std::string>{
+                    enrolled,
+                    "Average grade: " + grade.str(),
+                    "Attendance: " + attendance.str()
+                });
+            }
+            std::cout << "\n--- Classes ---\n";
+            view.DisplayCardsGrid(cards);
+        }
+        view.Pause();
+    }
+
+    void StatsFlow() {
+        std::cout << "\n";
+        BloomFilteredIndex::Stats filter;
+        if (model.GetStudentFilterStats(filter)) {
+            std::ostringstream observed, estimated;
+            observed << std::fixed << std::setprecision(3) << filter.ObservedRate() * 100 << "%";
+            estimated << std::fixed << std::setprecision(3) << filter.estimatedRate * 100 << "%";
+            view.DisplayCard("Student Bloom Filter", {
+                "Names: " + std::to_string(filter.keys) + " in " + std::to_string(filter.bits / 8192) + " KB",
+                "Lookups: " + std::to_string(filter.lookups),
+                "Skipped index: " + std::to_string(filter.skipped),
+                "False positives: " + std::to_string(filter.falsePositives),
+                "Observed FP rate: " + observed.str(),
+                "Estimated FP rate: " + estimated.str()
+            });
+        } else {
+            std::cout << "Student index is in memory; no Bloom filter in use.\n";
+        }
+        std::cout << "\n";
+        PageCache::Stats memory;
+        if (model.GetMemoryStats(memory)) {
+            view.DisplayCard("Roster Memory Budget", {
+                "Resident: " + std::to_string(memory.residentBytes / 1024) + " KB of "
+                    + std::to_string(memory.budgetBytes / 1024) + " KB",
+                "Evictable pages: " + std::to_string(memory.trackedPages),
+                "Pages spilled: " + std::to_string(memory.evictions),
+                "Page faults: " + std::to_string(memory.faults),
+                "Spill file: " + std::to_string(memory.spillFileBytes / 1024) + " KB"
+            });
+        } else {
+            std::cout << "No memory budget set; roster pages stay resident.\n";
+        }
+        std::cout << "\n";
+        std::vector<size_t> byStatus = model.Attributes().CountByStatus();
+        size_t graded = 0;
+        double averageGpa = model.Attributes().AverageGpa(graded);
+        std::ostringstream gpa;
+        gpa << std::fixed << std::setprecision(2) << averageGpa;
+        view.DisplayCard("Student Attributes", {
+            "Active: " + std::to_string(byStatus[0]) + "   On leave: " + std::to_string(byStatus[1]),
+            "Graduated: " + std::to_string(byStatus[2]) + "   Withdrawn: " + std::to_string(byStatus[3]),
+            "Average GPA: " + (graded ? gpa.str() : std::string("-"))
+                + " over " + std::to_string(graded) + " students"
+        });
+        std::cout << "\n";
+        KllSketch grades = model.GradeSketch({});
+        if (grades.Count() > 0) {
+            std::ostringstream percentiles;
+            percentiles << std::fixed << std::setprecision(1) << "P25 " << grades.Quantile(0.25) << "%  Median "
+                        << grades.Quantile(0.5) << "%  P90 " << grades.Quantile(0.9) << "%";
+            view.DisplayCard("Grade Percentiles (all classes)", {
+                percentiles.str(),
+                std::to_string(grades.Count()) + " grades, merged from per-class sketches",
+                "Sketch keeps " + std::to_string(grades.Retained()) + " values"
+            });
+        } else {
+            std::cout << "No grades recorded yet.\n";
+        }
+        std::cout << "\n";
+        size_t sessions = 0, marks = 0, attendanceBytes = 0;
+        model.Attendance().Read([&](const AttendanceBook& attendance) {
+            for (size_t c = 0; c < attendance.Classes(); ++c) {
+                for (const auto& session : attendance.Class(static_cast<uint32_t>(c))->sessions) {
+                    ++sessions;
+                    marks += session.members;
+                }
+            }
+            attendanceBytes = attendance.MemoryBytes();
+        });
+        view.DisplayCard("Attendance", {
+            std::to_string(sessions) + " sessions, " + std::to_string(marks) + " marks",
+            "Bitmaps: " + std::to_string(attendanceBytes / 1024) + " KB"
+        });
+        std::cout << "\n";
+        ClassEventStore::Stats events = model.GetEventStats();
+        view.DisplayCard("Live Activity", {
+            std::to_string(events.events) + " events of " + std::to_string(events.types) + " types",
+            std::to_string(events.partitions) + " hourly partitions, " + std::to_string(events.bytes / 1024) + " KB"
+        });
+        std::cout << "\n";
+        auto indexes = model.Attributes().ListIndexes();
+        if (indexes.empty()) {
+            std::cout << "No attribute indexes declared; queries scan the columns.\n";
+        } else {
+            std::vector<std::string> lines;
+            for (const auto& index : indexes) {
+                lines.push_back(std::string(IndexTypeName(std::get<1>(index))) + " on " + ColumnName(std::get<0>(index))
+                    + ": " + std::to_string(std::get<2>(index)) + " lookups");
+            }
+            view.DisplayCard("Attribute Indexes", lines);
+        }
+        std::cout << "\n";
+        view.Pause();
+    }
+
+    // Students in name order, optionally limited to a range, one page at a time
+    void ViewStudentsFlow() {
+        const size_t pageSize = 10;
+        std::string from = view.PromptString("Show students from (blank for first): ");
+        std::string to = view.PromptString("Up to, not including (blank for last): ");
+        std::vector<StudentPredicate> where;
+        if (!PromptConditions("Only students where (e.g. cohort=2026; blank for all): ", where)) return;
+        for (int page = 1;; ++page) {
+            // One extra name tells us whether another page follows, and where it starts
+            std::vector<std::string> students = model.ListStudents(from, to, pageSize + 1, where);
+            if (students.empty()) {
+                std::cout << (page == 1 ? "\nNo students enrolled.\n\n" : "\nNo more students.\n\n");
+                break;
+            }
+            bool more = students.size() > pageSize;
+            if (more) {
+                from = students.back();
+                students.pop_back();
+            }
+            std::vector<std::pair<std::string, std::vector<std::string>>> cards;
+            for (const auto& s : students) {
+                StudentAttributes row;
+                model.GetStudentAttributes(s, row);
+                cards.emplace_back(s, DescribeAttributes(row));
+            }
+            std::cout << "\n--- Students (page " << page << ") ---\n";
+            view.DisplayCardsGrid(cards);
+            if (!more) break;
+            if (view.PromptString("Enter for next page, q to stop: ") == "q") return;
+        }
+        view.Pause();
+    }
+};
+
+// Crash test for snapshot files: a child process saves numbered snapshots in
+// a loop and reports each one that finished; the parent SIGKILLs it after a
+// random delay and checks that recovery yields a complete body, either the
+// last one reported or the one in flight. The first half of the trials saves
+// one file with WriteSnapshotFile, the second half two files together with
+// WriteSnapshotBatch, which must then agree. Runs in a scratch directory,
+// crash_test. Returns the number of failed trials.
+int RunCrashTest(int trials) {
+#ifdef _WIN32
+    (void)trials;
+    std::cerr << "The crash test needs fork() and is not available on Windows.\n";
+    return 1;
+#else
+    // Line-oriented bodies, like every snapshot, of varying length and with
+    // every byte depending on the generation, so a body mixing two saves or
+    // cut short never parses back
+    auto make = [](uint64_t generation) {
+        std::string body = "generation=" + std::to_string(generation) + "\n";
+        uint64_t seed = generation * 0x9E3779B97F4A7C15ull + 1;
+        size_t length = 1024 + static_cast<size_t>(generation * 7919 % (256 * 1024));
+        while (body.size() < length) {
+            seed ^= seed << 13; seed ^= seed >> 7; seed ^= seed << 17;
+            body += seed % 64 == 0 ? '\n' : static_cast<char>('a' + seed % 26);
+        }
+        return body + "\n";
+    };
+    auto parse = [&](const std::string& body, uint64_t& generation) {
+        if (body.compare(0, 11, "generation=") != 0) return false;
+        generation = std::strtoull(body.c_str() + 11, nullptr, 10);
+        return body == make(generation);
+    };
+
+    std::filesystem::create_directories("crash_test");
+    std::filesystem::current_path("crash_test");
+    uint64_t seed = static_cast<uint64_t>(std::chrono::steady_clock::now().time_since_epoch().count()) | 1;
+    auto next = [&]() { seed ^= seed << 13; seed ^= seed >> 7; seed ^= seed << 17; return seed; };
+
+    // recover sets the generation on disk (0 for none) and returns false for
+    // anything that is not one complete save
+    auto run = [&](const std::string& what, int count, const std::function<bool(uint64_t)>& save,
+                   const std::function<bool(uint64_t&)>& recover) {
+        int failures = 0;
+        uint64_t committed = 0; // generation known to be on disk; 0 = none yet
+        if (!recover(committed)) committed = 0;
+        for (int trial = 1; trial <= count; ++trial) {
+            int acks[2];
+            if (pipe(acks) != 0) {
+                std::cerr << "pipe() failed.\n";
+                return count;
+            }
+            std::cout.flush();
+            pid_t child = fork();
+            if (child < 0) {
+                std::cerr << "fork() failed.\n";
+                return count;
+            }
+            if (child == 0) {
+                close(acks[0]);
+                for (uint64_t generation = committed + 1;; ++generation) {
+                    if (!save(generation)) _exit(2);
+                    if (write(acks[1], &generation, sizeof generation) != sizeof generation) _exit(3);
+                }
+            }
+            close(acks[1]);
+            usleep(static_cast<useconds_t>(next() % 50000));
+            kill(child, SIGKILL);
+            int status;
+            waitpid(child, &status, 0);
+            uint64_t acked = committed, generation;
+            while (read(acks[0], &generation, sizeof generation) == sizeof generation) acked = generation;
+            close(acks[0]);
+
+            // Disk may hold the last reported save or the one after it, whole
+            uint64_t found = 0;
+            bool ok = recover(found) && (found == acked || found == acked + 1);
+            if (!ok) {
+                ++failures;
+                std::cout << what << " trial " << trial << ": FAILED, last reported save " << acked << ", recovered "
+                          << (found ? std::to_string(found) : std::string("nothing usable")) << "\n";
+            }
+            committed = found ? found : acked;
+        }
+        std::cout << count - failures << " of " << count << " " << what << " trials recovered a complete save.\n";
+        return failures;
+    };
+
+    std::string body;
+    int failures = run("single-file", (trials + 1) / 2,
+        [&](uint64_t generation) { return WriteSnapshotFile("snapshot.txt", make(generation)); },
+        [&](uint64_t& found) {
+            found = 0;
+            return !RecoverSnapshotFile("snapshot.txt", body) || parse(body, found);
+        });
+    failures += run("two-file batch", trials / 2,
+        [&](uint64_t generation) {
+            return WriteSnapshotBatch("batch.commit", {{"first.txt", make(generation)}, {"second.txt", make(generation)}});
+        },
+        [&](uint64_t& found) {
+            RecoverSnapshotBatch("batch.commit", {"first.txt", "second.txt"});
+            uint64_t first = 0, second = 0;
+            bool ok = !RecoverSnapshotFile("first.txt", body) || parse(body, first);
+            ok = (!RecoverSnapshotFile("second.txt", body) || parse(body, second)) && ok;
+            found = first;
+            return ok && first == second;
+        });
+    return failures;
+#endif
+}
+
+// Contention benchmark: N reader threads list and look up names while M writer
+// threads add new ones, all against an in-memory Model.
+void RunContentionBenchmark(int readers, int writers, int seconds) {
+    using Clock = std::chrono::steady_clock;
+    ModelOptions options;
+    options.store = StoreKind::Memory;
+    Model model(options);
+    for (int i = 0; i < 1000; ++i) model.AddStudent("Seed Student " + std::to_string(i));
+
+    std::atomic<bool> stop(false);
+    std::atomic<long long> reads(0), writes(0), worstReadNs(0);
+    std::vector<std::thread> threads;
+
+    for (int r = 0; r < readers; ++r) {
+        threads.emplace_back([&, r]() {
+            long long localReads = 0, localWorst = 0;
+            int i = r;
+            while (!stop.load(std::memory_order_relaxed)) {
+                auto start = Clock::now();
+                if (i % 8 == 0) {
+                    auto students = model.GetStudents();
+                    if (!students.empty() && students[0].empty()) break;
+                } else {
+                    model.HasStudent("Seed Student " + std::to_string(i % 1000));
+                }
+                long long ns = std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - start).count();
+                localWorst = std::max(localWorst, ns);
+                ++localReads;
+                ++i;
+            }
+            reads += localReads;
+            long long seen = worstReadNs.load();
+            while (localWorst > seen && !worstReadNs.compare_exchange_weak(seen, localWorst)) {}
+        });
+    }
+    for (int w = 0; w < writers; ++w) {
+        threads.emplace_back([&, w]() {
+            long long localWrites = 0;
+            while (!stop.load(std::memory_order_relaxed)) {
+                model.AddStudent("Writer " + std::to_string(w) + " Student " + std::to_string(localWrites));
+                ++localWrites;
+            }
+            writes += localWrites;
+        });
+    }
+
+    std::this_thread::sleep_for(std::chrono::seconds(seconds));
+    stop = true;
+    for (auto& t : threads) t.join();
+
+    std::cout << "Readers: " << readers << "  Writers: " << writers << "  Duration: " << seconds << "s\n";
+    std::cout << "Reads/sec:  " << reads / seconds << "\n";
+    std::cout << "Writes/sec: " << writes / seconds << "\n";
+    std::cout << "Worst read latency: " << worstReadNs / 1000 << " us\n";
+}
+
+// Gradebook benchmark: statistics for every assessment of one class, recomputed repeatedly
+void RunGradebookBenchmark(size_t students, size_t assessments, int repeats) {
+    using Clock = std::chrono::steady_clock;
+    std::vector<std::vector<float>> columns(assessments, std::vector<float>(students));
+    uint64_t seed = 0x9E3779B97F4A7C15ull;
+    for (auto& column : columns) {
+        for (float& score : column) {
+            seed ^= seed << 13; seed ^= seed >> 7; seed ^= seed << 17;
+            score = seed % 20 == 0 ? Gradebook::kUngraded : static_cast<float>(seed % 1001) / 10.0f;
+        }
+    }
+    double checksum = 0;
+    auto start = Clock::now();
+    for (int r = 0; r < repeats; ++r) {
+        for (const auto& column : columns) checksum += ComputeColumnStats(column.data(), column.size(), 100.0f).mean;
+    }
+    double us = std::chrono::duration<double, std::micro>(Clock::now() - start).count() / repeats;
+    std::cout << "Students: " << students << "  Assessments: " << assessments
+              << "  SIMD: " << (VCLASS_SSE2 ? "SSE2" : "none") << "\n";
+    std::cout << "All stats recomputed in " << std::fixed << std::setprecision(1) << us << " us"
+              << " (checksum " << std::setprecision(3) << checksum / repeats << ")\n";
+}
+
+// Sketch benchmark: district-wide percentiles by merging per-class sketches,
+// against sorting every grade
+void RunSketchBenchmark(size_t classes, size_t gradesPerClass) {
+    using Clock = std::chrono::steady_clock;
+    std::vector<KllSketch> sketches(classes);
+    std::vector<float> all;
+    all.reserve(classes * gradesPerClass);
+    uint64_t seed = 0x853C49E6748FEA9Bull;
+    for (size_t c = 0; c < classes; ++c) {
+        float classMean = 60.0f + static_cast<float>(c % 30);
+        for (size_t g = 0; g < gradesPerClass; ++g) {
+            seed ^= seed << 13; seed ^= seed >> 7; seed ^= seed << 17;
+            float grade = std::min(100.0f, std::max(0.0f, classMean + static_cast<float>(seed % 4001) / 100.0f - 20.0f));
+            sketches[c].Update(grade);
+            all.push_back(grade);
+        }
+    }
+
+    auto start = Clock::now();
+    KllSketch district;
+    for (const auto& sketch : sketches) district.Merge(sketch);
+    float median = district.Quantile(0.5), p90 = district.Quantile(0.9);
+    double mergeMs = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+
+    start = Clock::now();
+    std::sort(all.begin(), all.end());
+    float exactMedian = all[all.size() / 2], exactP90 = all[static_cast<size_t>(all.size() * 0.9)];
+    double sortMs = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+
+    auto rank = [&](float value) {
+        return static_cast<double>(std::lower_bound(all.begin(), all.end(), value) - all.begin()) / all.size();
+    };
+    std::cout << "Classes: " << classes << "  Grades: " << all.size() << "\n" << std::fixed << std::setprecision(2);
+    std::cout << "Merged sketches: " << mergeMs << " ms, median " << median << " (rank " << rank(median)
+              << "), p90 " << p90 << " (rank " << rank(p90) << "), " << district.Retained() << " values kept\n";
+    std::cout << "Exact sort:      " << sortMs << " ms, median " << exactMedian << ", p90 " << exactP90 << "\n";
+}
+
+// Attendance benchmark: one class of the given size over a year of sessions,
+// about one absence in sixteen, then the report queries over the bitmaps
+void RunAttendanceBenchmark(size_t students, size_t sessions) {
+    using Clock = std::chrono::steady_clock;
+    AttendanceBook attendance;
+    uint64_t seed = 0x2545F4914F6CDD1Dull;
+    auto next = [&]() { seed ^= seed << 13; seed ^= seed >> 7; seed ^= seed << 17; return seed; };
+    for (size_t i = 0; i < students; ++i) attendance.AddMember(0, static_cast<uint32_t>(i));
+    const int32_t firstDay = DaysFromCivil(2025, 9, 1);
+    std::vector<uint64_t> present((students + 63) / 64);
+    for (size_t s = 0; s < sessions; ++s) {
+        for (uint64_t& word : present) word = next() | next() | next() | next();
+        // Five sessions a week
+        int32_t day = firstDay + static_cast<int32_t>(s / 5 * 7 + s % 5);
+        attendance.RestoreSession(0, static_cast<uint32_t>(s), day, static_cast<uint32_t>(students), present);
+    }
+
+    int32_t lastDay = attendance.Class(0)->sessions.back().day, monthStart, monthEnd;
+    MonthBounds(lastDay, monthStart, monthEnd);
+    auto start = Clock::now();
+    std::vector<uint32_t> absentees = attendance.FrequentAbsentees(0, monthStart, monthEnd, 3);
+    double absentMs = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+
+    start = Clock::now();
+    uint64_t attended = 0, longest = 0;
+    for (size_t i = 0; i < students; ++i) {
+        AttendanceBook::StudentSummary summary = attendance.Summarize(0, static_cast<uint32_t>(i));
+        attended += summary.attended;
+        longest = std::max<uint64_t>(longest, summary.longestAbsence);
+    }
+    double summaryMs = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+
+    start = Clock::now();
+    uint64_t total = 0;
+    for (const auto& session : attendance.Class(0)->sessions) total += AttendanceBook::Attended(session);
+    double rateMs = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+
+    std::cout << "Students: " << students << "  Sessions: " << sessions << "\n" << std::fixed << std::setprecision(2);
+    std::cout << "Bitmaps: " << attendance.MemoryBytes() / 1048576.0 << " MB ("
+              << static_cast<double>(attendance.MemoryBytes()) / students << " bytes per student)\n";
+    std::cout << "Class attendance rate: " << rateMs << " ms, " << total * 100.0 / (students * sessions) << "%\n";
+    std::cout << "Absent 3+ times in " << FormatDate(monthStart).substr(0, 7) << ": " << absentMs << " ms, "
+              << absentees.size() << " students\n";
+    std::cout << "Every student's summary: " << summaryMs << " ms (" << summaryMs * 1e6 / students
+              << " ns each), longest absence " << longest << ", checksum " << attended << "\n";
+}
+
+// Ingestion benchmark: a school day as a scan log. Classes meet in one of
+// eight periods and every student badges in during the first ten minutes,
+// a fifth of them twice; the log is then parsed, deduplicated and applied to
+// an in-memory roster.
+void RunIngestBenchmark(size_t classes, size_t classSize) {
+    using Clock = std::chrono::steady_clock;
+    ModelOptions options;
+    options.store = StoreKind::Memory;
+    Model model(options);
+    for (size_t c = 0; c < classes; ++c) {
+        std::string className = "Class " + std::to_string(c);
+        model.AddClass(className);
+        for (size_t i = 0; i < classSize; ++i) {
+            std::string student = "Student " + std::to_string(c * classSize + i);
+            model.AddStudent(student);
+            model.Enroll(className, student);
+        }
+    }
+
+    uint64_t seed = 0x9E3779B97F4A7C15ull;
+    auto next = [&]() { seed ^= seed << 13; seed ^= seed >> 7; seed ^= seed << 17; return seed; };
+    std::string log;
+    const int64_t morning = int64_t(DaysFromCivil(2026, 10, 16)) * 86400 + 8 * 3600;
+    size_t events = 0;
+    for (size_t period = 0; period < 8; ++period) {
+        int64_t start = morning + static_cast<int64_t>(period) * 3600;
+        for (size_t c = period; c < classes; c += 8) {
+            for (size_t i = 0; i < classSize; ++i) {
+                int64_t time = start + static_cast<int64_t>(next() % 600);
+                std::string line = std::to_string(time) + "\tClass " + std::to_string(c) + "\tStudent "
+                                 + std::to_string(c * classSize + i) + "\n";
+                log += line;
+                ++events;
+                if (next() % 5 == 0) {
+                    log += std::to_string(time + static_cast<int64_t>(next() % 30)) + line.substr(line.find('\t'));
+                    ++events;
+                }
+            }
+        }
+    }
+
+    ScanIngester ingester(model);
+    auto begin = Clock::now();
+    for (size_t offset = 0; offset < log.size(); offset += ScanIngester::kChunkBytes) {
+        ingester.Feed(log.data() + offset, std::min(ScanIngester::kChunkBytes, log.size() - offset));
+    }
+    ingester.Finish();
+    double seconds = std::chrono::duration<double>(Clock::now() - begin).count();
+    const ScanIngester::Stats& stats = ingester.GetStats();
+    std::cout << "Classes: " << classes << "  Students: " << classes * classSize << "  Scans: " << events
+              << " (" << log.size() / 1024 << " KB)\n";
+    std::cout << std::fixed << std::setprecision(1) << "Ingested in " << seconds * 1000 << " ms: "
+              << static_cast<long long>(events / seconds) << " scans/sec, " << stats.batches << " batches\n";
+    std::cout << "Marked " << stats.totals.marked << ", dropped " << stats.duplicates << " repeats, "
+              << stats.totals.alreadyPresent << " already present, " << stats.totals.sessionsStarted << " sessions started\n";
+}
+
+// Event store benchmark: a school day of live activity in many classes, then
+// the dashboard queries and a retention pass
+void RunEventBenchmark(size_t classes, int hours) {
+    using Clock = std::chrono::steady_clock;
+    ClassEventStore events;
+    const char* types[] = {"join", "leave", "hand", "chat", "chat", "chat", "reaction", "reaction"};
+    uint64_t seed = 0xDA942042E4DD58B5ull;
+    auto next = [&]() { seed ^= seed << 13; seed ^= seed >> 7; seed ^= seed << 17; return seed; };
+    const int64_t morning = int64_t(DaysFromCivil(2026, 10, 16)) * 86400000 + 8 * 3600000;
+    const int64_t end = morning + int64_t(hours) * 3600000;
+    // Every class sees an event every 300 ms on average, a few arriving late
+    std::vector<int64_t> clocks(classes, morning);
+    size_t appended = 0;
+    auto start = Clock::now();
+    for (bool more = true; more;) {
+        more = false;
+        for (size_t c = 0; c < classes; ++c) {
+            if (clocks[c] >= end) continue;
+            more = true;
+            clocks[c] += static_cast<int64_t>(next() % 600);
+            int64_t time = clocks[c] - (next() % 50 == 0 ? static_cast<int64_t>(next() % 5000) : 0);
+            events.Append(static_cast<uint32_t>(c), time, types[next() % 8], static_cast<uint32_t>(next() % 30));
+            ++appended;
+        }
+    }
+    double appendSec = std::chrono::duration<double>(Clock::now() - start).count();
+    ClassEventStore::Stats stats = events.GetStats();
+
+    start = Clock::now();
+    size_t window = events.Scan(0, end - 5 * 60000, end, "", [](int64_t, const std::string&, uint32_t) {});
+    double windowUs = std::chrono::duration<double, std::micro>(Clock::now() - start).count();
+    start = Clock::now();
+    size_t hands = events.Scan(0, morning, end, "hand", [](int64_t, const std::string&, uint32_t) {});
+    double handsUs = std::chrono::duration<double, std::micro>(Clock::now() - start).count();
+    start = Clock::now();
+    size_t dropped = events.DropBefore(end - 3600000);
+    double dropUs = std::chrono::duration<double, std::micro>(Clock::now() - start).count();
+
+    std::cout << "Classes: " << classes << "  Hours: " << hours << "  Events: " << appended << "\n" << std::fixed << std::setprecision(2);
+    std::cout << "Appended at " << static_cast<long long>(appended / appendSec) << " events/sec, "
+              << static_cast<double>(stats.bytes) / stats.events << " bytes/event in " << stats.partitions << " partitions\n";
+    std::cout << "Last 5 minutes of one class: " << window << " events in " << windowUs << " us\n";
+    std::cout << "Raised hands in one class all day: " << hands << " in " << handsUs << " us\n";
+    std::cout << "Retention kept the last hour: dropped " << dropped << " partitions in " << dropUs << " us\n";
+}
+
+// Engagement benchmark: events for one large class streamed through the
+// windows, then the least-engaged query
+void RunEngagementBenchmark(size_t students, size_t eventCount) {
+    using Clock = std::chrono::steady_clock;
+    EngagementWindows windows;
+    for (size_t i = 0; i < students; ++i) windows.AddMember(0, static_cast<uint32_t>(i));
+    uint64_t seed = 0x5851F42D4C957F2Dull;
+    auto next = [&]() { seed ^= seed << 13; seed ^= seed >> 7; seed ^= seed << 17; return seed; };
+    std::vector<std::pair<int64_t, uint32_t>> feed(eventCount);
+    int64_t time = int64_t(DaysFromCivil(2026, 10, 16)) * 86400000 + 9 * 3600000;
+    for (auto& event : feed) {
+        time += static_cast<int64_t>(next() % 20);
+        // A skewed population: low IDs speak up far more often
+        uint32_t student = static_cast<uint32_t>(next() % students);
+        event = {time, static_cast<uint32_t>(next() % 2 ? student / 4 : student)};
+    }
+    auto start = Clock::now();
+    for (const auto& event : feed) windows.Observe(0, event.second, event.first, 1 + static_cast<uint32_t>(event.first % 3));
+    double observeSec = std::chrono::duration<double>(Clock::now() - start).count();
+    start = Clock::now();
+    std::vector<EngagementWindows::Score> lowest = windows.LeastEngaged(0, time, 10);
+    double queryMs = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+
+    std::cout << "Students: " << students << "  Events: " << eventCount << " over "
+              << (time - feed.front().first) / 60000 << " minutes\n" << std::fixed << std::setprecision(2);
+    std::cout << "Observed at " << static_cast<long long>(eventCount / observeSec) << " events/sec ("
+              << observeSec * 1e9 / eventCount << " ns each)\n";
+    std::cout << "10 least engaged in " << queryMs << " ms:";
+    for (const auto& score : lowest) std::cout << " " << score.studentId << "=" << score.sliding;
+    std::cout << "\n";
+}
+
+// Timetable benchmark: a synthetic term of classes in 30 weekly periods,
+// students choosing six each; enrollment checks through the interval indexes,
+// then whole-timetable validation on one thread and on every core
+void RunTimetableBenchmark(size_t students, size_t classes) {
+    using Clock = std::chrono::steady_clock;
+    uint64_t seed = 0x6A09E667F3BCC909ull;
+    auto next = [&]() { seed ^= seed << 13; seed ^= seed >> 7; seed ^= seed << 17; return seed; };
+    PagedList<std::string> classNames, studentNames;
+    PagedList<Enrollment> enrollments;
+    ScheduleBook schedules;
+    for (size_t c = 0; c < classes; ++c) {
+        classNames.push_back("Class " + std::to_string(c));
+        ClassSchedule schedule;
+        schedule.teacher = "Teacher " + std::to_string(c % std::max<size_t>(1, classes / 4));
+        schedule.room = "Room " + std::to_string(c % std::max<size_t>(1, classes / 6));
+        // Two or three periods a week, 50 minutes each
+        int period = static_cast<int>(next() % 30);
+        for (int m = 0; m < 2 + static_cast<int>(c % 2); ++m) {
+            int slot = (period + m * 11) % 30;
+            int start = (slot / 6) * 1440 + 8 * 60 + (slot % 6) * 60;
+            schedule.meetings.push_back({start, start + 50});
+        }
+        std::sort(schedule.meetings.begin(), schedule.meetings.end(), [](const Meeting& a, const Meeting& b) { return a.start < b.start; });
+        schedules.Set(static_cast<uint32_t>(c), schedule);
+    }
+
+    TimetableIndex index;
+    size_t accepted = 0, rejected = 0;
+    auto start = Clock::now();
+    for (size_t s = 0; s < students; ++s) {
+        studentNames.push_back("Student " + std::to_string(s));
+        for (int pick = 0; pick < 6; ++pick) {
+            uint32_t classId = static_cast<uint32_t>(next() % classes);
+            const ClassSchedule& schedule = *schedules.Class(classId);
+            int64_t other;
+            Meeting when;
+            if (!index.CheckStudent(classId, static_cast<uint32_t>(s), schedule.meetings, other, when)) {
+                ++rejected;
+                // Keep some conflicts in the term so validation has work to report
+                if (next() % 4) continue;
+            } else {
+                ++accepted;
+                index.BookStudent(classId, static_cast<uint32_t>(s), schedule.meetings);
+            }
+            enrollments.push_back({classId, static_cast<uint32_t>(s)});
+        }
+    }
+    double checkMs = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+    std::cout << "Students: " << students << "  Classes: " << classes << "  Enrollments: " << enrollments.size() << "\n"
+              << std::fixed << std::setprecision(2);
+    std::cout << "Enrollment checks: " << accepted + rejected << " in " << checkMs << " ms ("
+              << checkMs * 1e6 / (accepted + rejected) << " ns each), " << rejected << " overlaps caught\n";
+    unsigned cores = std::max(1u, std::thread::hardware_concurrency());
+    for (unsigned threads : {1u, cores}) {
+        TimetableReport report = ValidateTimetable(classNames, studentNames, enrollments, schedules, threads);
+        std::cout << "Validation on " << report.threads << " thread(s): " << report.milliseconds << " ms, "
+                  << report.conflicts.size() << " double bookings\n";
+    }
+}
+
+// Solver benchmark: a synthetic term (programs of ten classes, each student
+// taking six from one program, a teacher per four classes with hours on four
+// weekdays, rooms of 20-60 seats) solved on
+// one thread and then on every core, printing how the best timetable improved
+void RunSolverBenchmark(size_t classes, double seconds) {
+    uint64_t seed = 0xBB67AE8584CAA73Bull;
+    auto next = [&]() { seed ^= seed << 13; seed ^= seed >> 7; seed ^= seed << 17; return seed; };
+    TimetableProblem problem;
+    problem.UseStandardWeek();
+    size_t teachers = std::max<size_t>(1, classes / 4), rooms = std::max<size_t>(1, classes / 5);
+    for (size_t t = 0; t < teachers; ++t) {
+        int off = static_cast<int>(next() % 5);
+        std::vector<Meeting> hours;
+        for (int day = 0; day < 5; ++day) {
+            if (day != off) hours.push_back({day * 1440 + 8 * 60, day * 1440 + 16 * 60});
+        }
+        problem.availability["Teacher " + std::to_string(t)] = hours;
+    }
+    for (size_t r = 0; r < rooms; ++r) problem.rooms.push_back({"Room " + std::to_string(r), static_cast<uint32_t>(20 + next() % 41)});
+    problem.studentsOf.resize(classes);
+    size_t students = classes * 6;
+    for (size_t s = 0; s < students; ++s) {
+        std::set<uint32_t> picked;
+        size_t program = (next() % ((classes + 9) / 10)) * 10, size = std::min<size_t>(10, classes - program);
+        while (picked.size() < 6 && picked.size() < size) picked.insert(static_cast<uint32_t>(program + next() % size));
+        for (uint32_t c : picked) problem.studentsOf[c].push_back(static_cast<uint32_t>(s));
+    }
+    for (size_t c = 0; c < classes; ++c) {
+        problem.classes.push_back({static_cast<uint32_t>(c), "Teacher " + std::to_string(c % teachers),
+                                   static_cast<uint32_t>(problem.studentsOf[c].size()), 2 + static_cast<int>(c % 2)});
+    }
+    std::cout << "Classes: " << classes << "  Rooms: " << rooms << "  Teachers: " << teachers
+              << "  Students: " << students << "  Deadline: " << seconds << " s\n" << std::fixed << std::setprecision(1);
+    unsigned cores = std::max(1u, std::thread::hardware_concurrency());
+    for (unsigned threads : {1u, cores}) {
+        TimetableSolution solution = TimetableSolver(problem).Solve(seconds, threads);
+        std::cout << "\n" << solution.threads << " thread(s), " << solution.moves << " moves ("
+                  << solution.moves / seconds / 1e6 << "M/s)\n";
+        const size_t shown = 10;
+        for (size_t i = 0; i < solution.timeline.size(); ++i) {
+            // The first improvements, then every few, then the last
+            size_t stride = std::max<size_t>(1, solution.timeline.size() / shown);
+            if (i % stride != 0 && i + 1 != solution.timeline.size()) continue;
+            const auto& step = solution.timeline[i];
+            std::cout << "  " << std::setw(9) << step.milliseconds << " ms  violations " << step.violations
+                      << "  penalty " << step.penalty << "  (thread " << step.thread << ")\n";
+        }
+        if (cores == 1) break;
+    }
+}
+
+// Registration benchmark: an 8:00 rush where every student asks for three
+// classes (most of them for the popular fifth) from many threads at once,
+// then a churn of concurrent drops and re-enrollments. Reports throughput and
+// latency, how evenly seats went to the threads (Jain's index, 1.0 = equal),
+// and checks every class afterwards: never over capacity, seat counts equal
+// to enrollments, nobody both enrolled and waiting, and a waitlist only where
+// the class is full (so no one was overtaken).
+void RunRegistrationBenchmark(size_t students, size_t classes, unsigned threads) {
+    using Clock = std::chrono::steady_clock;
+    ModelOptions options;
+    options.store = StoreKind::Memory;
+    Model model(options);
+    const uint32_t capacity = 30;
+    for (size_t c = 0; c < classes; ++c) {
+        model.AddClass("Class " + std::to_string(c));
+        model.SetCapacity("Class " + std::to_string(c), capacity);
+    }
+    for (size_t s = 0; s < students; ++s) model.AddStudent("Student " + std::to_string(s));
+    size_t popular = std::max<size_t>(1, classes / 5);
+
+    std::vector<size_t> won(threads, 0), waitlisted(threads, 0);
+    std::vector<std::vector<double>> latencies(threads);
+    std::vector<std::vector<std::pair<size_t, size_t>>> holding(threads); // (class, student) seats each thread won
+    auto rush = [&](unsigned t) {
+        uint64_t seed = 0x510E527FADE682D1ull * (t + 1);
+        auto next = [&]() { seed ^= seed << 13; seed ^= seed >> 7; seed ^= seed << 17; return seed; };
+        for (size_t s = t; s < students; s += threads) {
+            for (int pick = 0; pick < 3; ++pick) {
+                size_t c = next() % 5 < 4 ? next() % popular : next() % classes;
+                auto start = Clock::now();
+                EnrollResult result = model.Enroll("Class " + std::to_string(c), "Student " + std::to_string(s));
+                latencies[t].push_back(std::chrono::duration<double, std::micro>(Clock::now() - start).count());
+                if (result == EnrollResult::Enrolled) {
+                    ++won[t];
+                    holding[t].emplace_back(c, s);
+                } else if (result == EnrollResult::Waitlisted) {
+                    ++waitlisted[t];
+                }
+            }
+        }
+    };
+    auto run = [&](const std::function<void(unsigned)>& work) {
+        auto start = Clock::now();
+        std::vector<std::thread> workers;
+        for (unsigned t = 1; t < threads; ++t) workers.emplace_back(work, t);
+        work(0);
+        for (auto& worker : workers) worker.join();
+        return std::chrono::duration<double>(Clock::now() - start).count();
+    };
+    double rushSeconds = run(rush);
+
+    std::vector<double> all;
+    size_t seated = 0, waiting = 0;
+    double sum = 0, squares = 0;
+    for (unsigned t = 0; t < threads; ++t) {
+        all.insert(all.end(), latencies[t].begin(), latencies[t].end());
+        seated += won[t];
+        waiting += waitlisted[t];
+        sum += won[t];
+        squares += static_cast<double>(won[t]) * won[t];
+    }
+    std::sort(all.begin(), all.end());
+    std::cout << "Students: " << students << "  Classes: " << classes << " (" << capacity << " seats)  Threads: " << threads << "\n"
+              << std::fixed << std::setprecision(1);
+    std::cout << "Rush: " << all.size() << " requests in " << rushSeconds * 1000 << " ms (" << all.size() / rushSeconds
+              << "/s), " << seated << " enrolled, " << waiting << " waitlisted\n";
+    std::cout << "Latency: p50 " << all[all.size() / 2] << " us, p99 " << all[all.size() * 99 / 100] << " us\n";
+    std::cout << std::setprecision(3) << "Seat fairness across threads: " << (squares > 0 ? sum * sum / (threads * squares) : 1.0) << "\n";
+
+    std::atomic<size_t> drops(0), promotions(0), requests(0);
+    auto churn = [&](unsigned t) {
+        uint64_t seed = 0x9B05688C2B3E6C1Full * (t + 1);
+        auto next = [&]() { seed ^= seed << 13; seed ^= seed >> 7; seed ^= seed << 17; return seed; };
+        // Give up a seat this thread holds and ask for it again, which puts
+        // the student at the back of the waitlist
+        for (size_t i = 0; i < students / threads && !holding[t].empty(); ++i) {
+            size_t pick = next() % holding[t].size();
+            std::string className = "Class " + std::to_string(holding[t][pick].first);
+            std::string studentName = "Student " + std::to_string(holding[t][pick].second);
+            std::string promoted;
+            if (model.Drop(className, studentName, &promoted) == DropResult::Dropped) ++drops;
+            if (!promoted.empty()) ++promotions;
+            if (model.Enroll(className, studentName) != EnrollResult::Enrolled) {
+                holding[t][pick] = holding[t].back();
+                holding[t].pop_back();
+            }
+            requests += 2;
+        }
+    };
+    double churnSeconds = run(churn);
+    std::cout << std::setprecision(1) << "Churn: " << requests.load() << " drop/enroll requests in " << churnSeconds * 1000
+              << " ms (" << requests.load() / churnSeconds << "/s), " << drops.load() << " drops, "
+              << promotions.load() << " promoted from waitlists\n";
+
+    size_t problems = 0;
+    Model::Snapshot snapshot = model.Pin();
+    std::set<std::pair<uint32_t, std::string>> enrolled;
+    std::vector<uint32_t> counts(classes, 0);
+    for (const auto& e : snapshot.Enrollments()) {
+        ++counts[e.classId];
+        enrolled.emplace(e.classId, snapshot.Students()[e.studentId]);
+    }
+    for (size_t c = 0; c < classes; ++c) {
+        SeatBook::Seats seats = model.GetSeats(static_cast<uint32_t>(c));
+        if (counts[c] > capacity || seats.taken != counts[c] || (seats.waiting > 0 && seats.taken < capacity)) ++problems;
+        for (const auto& name : model.GetWaitlist(static_cast<uint32_t>(c))) problems += enrolled.count({static_cast<uint32_t>(c), name});
+    }
+    std::cout << "Consistency problems: " << problems << "\n";
+}
+
+// Prerequisite benchmark: a catalog in ten levels where each class requires
+// one to three classes from the levels below it. Times building the closure
+// edge by edge, eligibility checks against students who passed a random
+// handful of classes (compared with walking the graph for each check), and
+// removing and re-adding edges.
+void RunPrerequisiteBenchmark(size_t classes, size_t students) {
+    using Clock = std::chrono::steady_clock;
+    uint64_t seed = 0x9E3779B97F4A7C15ull;
+    auto next = [&]() { seed ^= seed << 13; seed ^= seed >> 7; seed ^= seed << 17; return seed; };
+    const size_t levels = 10, perLevel = std::max<size_t>(1, classes / levels);
+    std::vector<std::pair<uint32_t, uint32_t>> edges;
+    for (size_t c = perLevel; c < classes; ++c) {
+        size_t below = std::min(c / perLevel, levels - 1) * perLevel;
+        for (uint64_t k = next() % 3 + 1; k > 0; --k) {
+            edges.emplace_back(static_cast<uint32_t>(c), static_cast<uint32_t>(next() % below));
+        }
+    }
+
+    PrerequisiteBook book;
+    book.EnsureClasses(classes);
+    auto start = Clock::now();
+    size_t added = 0;
+    for (const auto& edge : edges) added += book.AddEdge(edge.first, edge.second) == PrerequisiteBook::EdgeResult::Added;
+    double buildMs = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+
+    // Every edge runs upward, so any edge down from the top level closes a cycle
+    size_t refused = 0;
+    start = Clock::now();
+    for (size_t i = 0; i < 10000; ++i) {
+        uint32_t low = static_cast<uint32_t>(next() % perLevel), high = static_cast<uint32_t>(classes - 1 - next() % perLevel);
+        refused += book.Requires(high, low) && book.AddEdge(low, high) == PrerequisiteBook::EdgeResult::Cycle;
+    }
+    double cycleNs = std::chrono::duration<double, std::nano>(Clock::now() - start).count() / 10000;
+
+    for (size_t s = 0; s < students; ++s) {
+        for (int k = 0; k < 6; ++k) book.Complete(static_cast<uint32_t>(s), static_cast<uint32_t>(next() % classes));
+    }
+    const size_t checks = 1000000;
+    std::vector<std::pair<uint32_t, uint32_t>> queries(checks);
+    for (auto& q : queries) q = {static_cast<uint32_t>(next() % classes), static_cast<uint32_t>(next() % students)};
+    start = Clock::now();
+    size_t eligible = 0;
+    for (const auto& q : queries) eligible += book.Missing(q.first, q.second) < 0;
+    double checkSeconds = std::chrono::duration<double>(Clock::now() - start).count();
+
+    // The same answers by walking the graph from the class, stopping at completed classes
+    std::vector<std::vector<uint32_t>> direct(classes);
+    for (size_t c = 0; c < classes; ++c) direct[c] = book.Prerequisites(static_cast<uint32_t>(c));
+    const size_t walks = std::min<size_t>(checks, 20000);
+    size_t walkEligible = 0, mismatches = 0;
+    std::vector<uint32_t> seen(classes, 0), stack;
+    start = Clock::now();
+    for (size_t i = 0; i < walks; ++i) {
+        const auto& passed = book.CompletedByStudent().find(queries[i].second)->second;
+        bool ok = true;
+        stack.assign(direct[queries[i].first].begin(), direct[queries[i].first].end());
+        while (ok && !stack.empty()) {
+            uint32_t p = stack.back();
+            stack.pop_back();
+            if (seen[p] == i + 1) continue;
+            seen[p] = static_cast<uint32_t>(i + 1);
+            if (std::binary_search(passed.begin(), passed.end(), p)) continue;
+            // An unpassed prerequisite is fine only if something above it was passed and covers it
+            bool covered = false;
+            for (uint32_t done : passed) covered = covered || book.Requires(done, p);
+            if (!covered) ok = false;
+            stack.insert(stack.end(), direct[p].begin(), direct[p].end());
+        }
+        walkEligible += ok;
+        mismatches += ok != (book.Missing(queries[i].first, queries[i].second) < 0);
+    }
+    double walkSeconds = std::chrono::duration<double>(Clock::now() - start).count();
+
+    start = Clock::now();
+    const size_t churn = std::min<size_t>(edges.size(), 2000);
+    for (size_t i = 0; i < churn; ++i) {
+        const auto& edge = edges[next() % edges.size()];
+        if (book.RemoveEdge(edge.first, edge.second) == PrerequisiteBook::EdgeResult::Removed) book.AddEdge(edge.first, edge.second);
+    }
+    double churnUs = std::chrono::duration<double, std::micro>(Clock::now() - start).count() / churn;
+
+    std::cout << "Classes: " << classes << "  Edges: " << added << "  Students: " << students << "\n" << std::fixed << std::setprecision(2);
+    std::cout << "Closure built edge by edge: " << buildMs << " ms\n";
+    std::cout << "Cycle refusals: " << refused << " of 10000, " << cycleNs << " ns each\n";
+    std::cout << "Eligibility checks: " << checks / checkSeconds / 1e6 << " M/s (" << checkSeconds * 1e9 / checks
+              << " ns each), " << eligible * 100.0 / checks << "% eligible\n";
+    std::cout << "Graph walk: " << walkSeconds * 1e9 / walks << " ns each, " << walkEligible << " of " << walks
+              << " eligible, " << mismatches << " disagreements\n";
+    std::cout << "Remove and re-add an edge: " << churnUs << " us\n";
+}
+
+// Organization benchmark: a school of twelve departments, each split into
+// four sub-departments, with the classes spread over them and every student
+// in three classes. Times per-department totals and student lists read
+// through the tour intervals against scanning every enrollment and walking
+// each class's chain of parent units, then moving classes between units.
+void RunOrganizationBenchmark(size_t classes, size_t students) {
+    using Clock = std::chrono::steady_clock;
+    ModelOptions options;
+    options.store = StoreKind::Memory;
+    Model model(options);
+    const size_t departments = 12, subdepartments = 4;
+    model.AddUnit("School", "");
+    for (size_t d = 0; d < departments; ++d) {
+        model.AddUnit("Department " + std::to_string(d), "School");
+        for (size_t s = 0; s < subdepartments; ++s) {
+            model.AddUnit("Department " + std::to_string(d) + "." + std::to_string(s), "Department " + std::to_string(d));
+        }
+    }
+    for (size_t c = 0; c < classes; ++c) {
+        model.AddClass("Class " + std::to_string(c));
+        size_t unit = c % (departments * subdepartments);
+        model.PlaceClass("Class " + std::to_string(c),
+                         "Department " + std::to_string(unit / subdepartments) + "." + std::to_string(unit % subdepartments));
+    }
+    uint64_t seed = 0x6A09E667F3BCC908ull;
+    auto next = [&]() { seed ^= seed << 13; seed ^= seed >> 7; seed ^= seed << 17; return seed; };
+    for (size_t s = 0; s < students; ++s) {
+        model.AddStudent("Student " + std::to_string(s));
+        for (int k = 0; k < 3; ++k) model.Enroll("Class " + std::to_string(next() % classes), "Student " + std::to_string(s));
+    }
+
+    std::vector<uint32_t> units(departments);
+    for (size_t d = 0; d < departments; ++d) model.Organization().FindUnit("Department " + std::to_string(d), units[d]);
+    std::vector<uint32_t> unitOf(classes), parent;
+    model.Organization().Read([&](const OrganizationTree& tree) {
+        for (size_t c = 0; c < classes; ++c) unitOf[c] = tree.UnitOf(static_cast<uint32_t>(c));
+        for (uint32_t u = 0; u < tree.Units(); ++u) parent.push_back(tree.Parent(u));
+    });
+    Model::Snapshot pin = model.Pin();
+    auto under = [&](uint32_t classId, uint32_t unit) {
+        for (uint32_t u = unitOf[classId];; u = parent[u]) {
+            if (u == unit) return true;
+            if (u == OrganizationTree::kRoot) return false;
+        }
+    };
+
+    const int repeats = 100;
+    size_t enrolled = 0, mismatches = 0;
+    auto start = Clock::now();
+    for (int r = 0; r < repeats; ++r) {
+        for (uint32_t unit : units) enrolled += model.GetUnitTotals(unit).enrolled;
+    }
+    double totalsUs = std::chrono::duration<double, std::micro>(Clock::now() - start).count() / (repeats * departments);
+
+    start = Clock::now();
+    std::vector<size_t> scanned(departments, 0);
+    for (size_t d = 0; d < departments; ++d) {
+        for (const auto& e : pin.Enrollments()) scanned[d] += under(e.classId, units[d]);
+    }
+    double scanTotalsUs = std::chrono::duration<double, std::micro>(Clock::now() - start).count() / departments;
+    for (size_t d = 0; d < departments; ++d) mismatches += scanned[d] != model.GetUnitTotals(units[d]).enrolled;
+
+    start = Clock::now();
+    std::vector<size_t> listed(departments);
+    for (size_t d = 0; d < departments; ++d) listed[d] = model.StudentsUnder(units[d]).size();
+    double listUs = std::chrono::duration<double, std::micro>(Clock::now() - start).count() / departments;
+
+    start = Clock::now();
+    for (size_t d = 0; d < departments; ++d) {
+        std::vector<uint32_t> ids;
+        for (const auto& e : pin.Enrollments()) {
+            if (under(e.classId, units[d])) ids.push_back(e.studentId);
+        }
+        std::sort(ids.begin(), ids.end());
+        ids.erase(std::unique(ids.begin(), ids.end()), ids.end());
+        std::vector<std::string> names;
+        for (uint32_t id : ids) names.push_back(pin.Students()[id]);
+        std::sort(names.begin(), names.end());
+        mismatches += names.size() != listed[d];
+    }
+    double scanListUs = std::chrono::duration<double, std::micro>(Clock::now() - start).count() / departments;
+
+    // Each move makes the next read renumber the whole tree
+    const size_t moves = 1000;
+    start = Clock::now();
+    for (size_t i = 0; i < moves; ++i) {
+        size_t unit = next() % (departments * subdepartments);
+        model.PlaceClass("Class " + std::to_string(next() % classes),
+                         "Department " + std::to_string(unit / subdepartments) + "." + std::to_string(unit % subdepartments));
+        enrolled += model.GetUnitTotals(units[i % departments]).enrolled;
+    }
+    double moveUs = std::chrono::duration<double, std::micro>(Clock::now() - start).count() / moves;
+
+    std::cout << "Classes: " << classes << "  Students: " << students << "  Enrollments: " << pin.Enrollments().size()
+              << "  Units: " << parent.size() - 1 << "\n" << std::fixed << std::setprecision(2);
+    std::cout << "Department totals: " << totalsUs << " us through the tour, " << scanTotalsUs << " us scanning enrollments\n";
+    std::cout << "Department students: " << listUs << " us through the tour, " << scanListUs << " us scanning enrollments\n";
+    std::cout << "Move a class, then read totals: " << moveUs << " us\n";
+    std::cout << "Disagreements: " << mismatches << "\n";
+}
+
+// Query benchmark: a synthetic roster of the given size, queried with one
+// thread and then with every core
+void RunQueryBenchmark(size_t students, int repeats) {
+    using Clock = std::chrono::steady_clock;
+    StudentAttributeStore columns;
+    PagedList<std::string> names;
+    columns.EnsureRows(students);
+    uint64_t seed = 88172645463325252ull;
+    auto next = [&]() { seed ^= seed << 13; seed ^= seed >> 7; seed ^= seed << 17; return seed; };
+    for (size_t i = 0; i < students; ++i) {
+        StudentAttributes row;
+        row.gradeLevel = static_cast<uint8_t>(1 + next() % 12);
+        row.cohort = std::to_string(2020 + next() % 8);
+        row.status = static_cast<StudentStatus>(next() % 10 < 8 ? 0 : next() % 4);
+        row.enrollmentDay = DaysFromCivil(2020, 9, 1) + static_cast<int32_t>(next() % 2000);
+        row.gpa = static_cast<float>(next() % 401) / 100.0f;
+        columns.Set(static_cast<uint32_t>(i), row);
+        names.push_back(std::string());
+    }
+
+    StudentQuery byCohort;
+    StudentPredicate active, honors;
+    ParsePredicate("status=active", active);
+    ParsePredicate("gpa>3.0", honors);
+    byCohort.where = {active, honors};
+    byCohort.grouped = true;
+    byCohort.groupBy = StudentColumn::Cohort;
+
+    StudentQuery gpaByGrade;
+    StudentPredicate recent;
+    ParsePredicate("enrolled>=2023-01-01", recent);
+    gpaByGrade.where = {recent};
+    gpaByGrade.grouped = true;
+    gpaByGrade.groupBy = StudentColumn::GradeLevel;
+    gpaByGrade.aggregate = StudentQuery::Aggregate::Average;
+
+    unsigned cores = std::max(1u, std::thread::hardware_concurrency());
+    std::cout << "Students: " << students << "  Cores: " << cores << "\n";
+    for (const auto& named : {std::make_pair("count per cohort where status=active, gpa>3.0", &byCohort),
+                              std::make_pair("avg gpa per grade where enrolled>=2023-01-01", &gpaByGrade)}) {
+        std::cout << named.first << "\n";
+        for (unsigned threads : {1u, cores}) {
+            QueryResult result;
+            auto start = Clock::now();
+            for (int r = 0; r < repeats; ++r) result = StudentQueryEngine::Run(columns, names, *named.second, threads);
+            double ms = std::chrono::duration<double, std::milli>(Clock::now() - start).count() / repeats;
+            std::cout << "  " << result.threads << " thread(s): " << std::fixed << std::setprecision(2) << ms << " ms, "
+                      << static_cast<long long>(students / (ms / 1000.0) / 1e6) << "M rows/sec, "
+                      << result.matched << " matched\n";
+        }
+    }
+
+    // The same single-cohort count, scanned and then through a hash index
+    StudentQuery oneCohort;
+    StudentPredicate cohort;
+    ParsePredicate("cohort=2024", cohort);
+    oneCohort.where = {cohort};
+    oneCohort.grouped = true;
+    oneCohort.groupBy = StudentColumn::GradeLevel;
+    std::cout << "count per grade where cohort=2024\n";
+    for (bool indexed : {false, true}) {
+        if (indexed) columns.AddIndex(StudentColumn::Cohort, AttributeIndex::Type::Hash);
+        QueryResult result;
+        auto start = Clock::now();
+        for (int r = 0; r < repeats; ++r) result = StudentQueryEngine::Run(columns, names, oneCohort, 1);
+        double ms = std::chrono::duration<double, std::milli>(Clock::now() - start).count() / repeats;
+        std::cout << "  " << (result.index.empty() ? "scan" : result.index) << ": " << std::fixed << std::setprecision(2)
+                  << ms << " ms, " << result.matched << " matched\n";
+    }
+}
+
+int main(int argc, char* argv[]) {
+    // VClass --crash-test [trials]
+    if (argc > 1 && std::string(argv[1]) == "--crash-test") {
+        int trials = argc > 2 ? std::max(1, std::atoi(argv[2])) : 100;
+        return RunCrashTest(trials) == 0 ? 0 : 1;
+    }
+
+    // VClass --bench-contention [readers] [writers] [seconds]
+    if (argc > 1 && std::string(argv[1]) == "--bench-contention") {
+        int readers = argc > 2 ? std::max(0, std::atoi(argv[2])) : 4;
+        int writers = argc > 3 ? std::max(0, std::atoi(argv[3])) : 1;
+        int seconds = argc > 4 ? std::max(1, std::atoi(argv[4])) : 3;
+        RunContentionBenchmark(readers, writers, seconds);
+        return 0;
+    }
+
+    // VClass --bench-gradebook [students] [assessments]
+    if (argc > 1 && std::string(argv[1]) == "--bench-gradebook") {
+        size_t students = argc > 2 ? static_cast<size_t>(std::max(1, std::atoi(argv[2]))) : 500;
+        size_t assessments = argc > 3 ? static_cast<size_t>(std::max(1, std::atoi(argv[3]))) : 50;
+        RunGradebookBenchmark(students, assessments, 1000);
+        return 0;
+    }
+
+    // VClass --bench-sketch [classes] [grades per class]
+    if (argc > 1 && std::string(argv[1]) == "--bench-sketch") {
+        size_t classes = argc > 2 ? static_cast<size_t>(std::max(1, std::atoi(argv[2]))) : 4000;
+        size_t grades = argc > 3 ? static_cast<size_t>(std::max(1, std::atoi(argv[3]))) : 1000;
+        RunSketchBenchmark(classes, grades);
+        return 0;
+    }
+
+    // VClass --bench-attendance [students] [sessions]
+    if (argc > 1 && std::string(argv[1]) == "--bench-attendance") {
+        size_t students = argc > 2 ? static_cast<size_t>(std::max(1, std::atoi(argv[2]))) : 1000000;
+        size_t sessions = argc > 3 ? static_cast<size_t>(std::max(1, std::atoi(argv[3]))) : 180;
+        RunAttendanceBenchmark(students, sessions);
+        return 0;
+    }
+
+    // VClass --bench-ingest [classes] [students per class]
+    if (argc > 1 && std::string(argv[1]) == "--bench-ingest") {
+        size_t classes = argc > 2 ? static_cast<size_t>(std::max(1, std::atoi(argv[2]))) : 800;
+        size_t classSize = argc > 3 ? static_cast<size_t>(std::max(1, std::atoi(argv[3]))) : 30;
+        RunIngestBenchmark(classes, classSize);
+        return 0;
+    }
+
+    // VClass --bench-events [classes] [hours]
+    if (argc > 1 && std::string(argv[1]) == "--bench-events") {
+        size_t classes = argc > 2 ? static_cast<size_t>(std::max(1, std::atoi(argv[2]))) : 200;
+        int hours = argc > 3 ? std::max(1, std::atoi(argv[3])) : 8;
+        RunEventBenchmark(classes, hours);
+        return 0;
+    }
+
+    // VClass --bench-engagement [students] [events]
+    if (argc > 1 && std::string(argv[1]) == "--bench-engagement") {
+        size_t students = argc > 2 ? static_cast<size_t>(std::max(1, std::atoi(argv[2]))) : 100000;
+        size_t eventCount = argc > 3 ? static_cast<size_t>(std::max(1, std::atoi(argv[3]))) : 5000000;
+        RunEngagementBenchmark(students, eventCount);
+        return 0;
+    }
+
+    // VClass --bench-registration [students] [classes] [threads]
+    if (argc > 1 && std::string(argv[1]) == "--bench-registration") {
+        size_t students = argc > 2 ? static_cast<size_t>(std::max(1, std::atoi(argv[2]))) : 20000;
+        size_t classes = argc > 3 ? static_cast<size_t>(std::max(1, std::atoi(argv[3]))) : 100;
+        unsigned threads = argc > 4 ? static_cast<unsigned>(std::max(1, std::atoi(argv[4]))) : 8;
+        RunRegistrationBenchmark(students, classes, threads);
+        return 0;
+    }
+
+    // VClass --bench-prerequisites [classes] [students]
+    if (argc > 1 && std::string(argv[1]) == "--bench-prerequisites") {
+        size_t classes = argc > 2 ? static_cast<size_t>(std::max(20, std::atoi(argv[2]))) : 2000;
+        size_t students = argc > 3 ? static_cast<size_t>(std::max(1, std::atoi(argv[3]))) : 20000;
+        RunPrerequisiteBenchmark(classes, students);
+        return 0;
+    }
+
+    // VClass --bench-organization [classes] [students]
+    if (argc > 1 && std::string(argv[1]) == "--bench-organization") {
+        size_t classes = argc > 2 ? static_cast<size_t>(std::max(1, std::atoi(argv[2]))) : 2000;
+        size_t students = argc > 3 ? static_cast<size_t>(std::max(1, std::atoi(argv[3]))) : 50000;
+        RunOrganizationBenchmark(classes, students);
+        return 0;
+    }
+
+    // VClass --bench-solver [classes] [seconds]
+    if (argc > 1 && std::string(argv[1]) == "--bench-solver") {
+        size_t classes = argc > 2 ? static_cast<size_t>(std::max(1, std::atoi(argv[2]))) : 300;
+        double seconds = argc > 3 ? std::max(0.1, std::atof(argv[3])) : 5.0;
+        RunSolverBenchmark(classes, seconds);
+        return 0;
+    }
+
+    // VClass --bench-timetable [students] [classes]
+    if (argc > 1 && std::string(argv[1]) == "--bench-timetable") {
+        size_t students = argc > 2 ? static_cast<size_t>(std::max(1, std::atoi(argv[2]))) : 200000;
+        size_t classes = argc > 3 ? static_cast<size_t>(std::max(1, std::atoi(argv[3]))) : 2000;
+        RunTimetableBenchmark(students, classes);
+        return 0;
+    }
+
+    // VClass --bench-query [students] [repeats]
+    if (argc > 1 && std::string(argv[1]) == "--bench-query") {
+        size_t students = argc > 2 ? static_cast<size_t>(std::max(1, std::atoi(argv[2]))) : 1000000;
+        int repeats = argc > 3 ? std::max(1, std::atoi(argv[3])) : 10;
+        RunQueryBenchmark(students, repeats);
+        return 0;
+    }
+
+    // VClass [--store=text|journal|memory] [--index=memory|lsm|btree] [--memory-budget=MB]
+    //        [--attribute-index=COLUMN:hash|sorted|bitmap ...]
+    //        [--event-retention=HOURS] [--ingest=FILE|- [--dedupe-window=SECONDS]]
+    ModelOptions options;
+    std::string ingestPath;
+    int64_t dedupeWindow = 300;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "--store=text") {
+            options.store = StoreKind::Text;
+        } else if (arg == "--store=journal") {
+            options.store = StoreKind::Journal;
+        } else if (arg == "--store=memory") {
+            options.store = StoreKind::Memory;
+        } else if (arg.compare(0, 16, "--memory-budget=") == 0) {
+            options.memoryBudgetBytes = static_cast<size_t>(std::atof(arg.c_str() + 16) * 1024 * 1024);
+        } else if (arg == "--index=lsm") {
+            options.studentIndex = IndexKind::Lsm;
+        } else if (arg == "--index=btree") {
+            options.studentIndex = IndexKind::BTree;
+        } else if (arg == "--index=memory") {
+            options.studentIndex = IndexKind::Memory;
+        } else if (arg.compare(0, 18, "--attribute-index=") == 0) {
+            // e.g. --attribute-index=cohort:hash, repeatable
+            std::string spec = arg.substr(18);
+            size_t colon = spec.find(':');
+            StudentColumn column;
+            AttributeIndex::Type type;
+            if (colon == std::string::npos || !ParseColumn(spec.substr(0, colon), column)
+                || column == StudentColumn::Name || !ParseIndexType(spec.substr(colon + 1), type)) {
+                std::cerr << "Expected --attribute-index=COLUMN:hash|sorted|bitmap, got " << arg << "\n";
+                return 1;
+            }
+            options.attributeIndexes.emplace_back(column, type);
+        } else if (arg.compare(0, 18, "--event-retention=") == 0) {
+            options.eventRetentionMs = static_cast<int64_t>(std::atof(arg.c_str() + 18) * 3600 * 1000);
+        } else if (arg.compare(0, 9, "--ingest=") == 0) {
+            ingestPath = arg.substr(9);
+        } else if (arg.compare(0, 16, "--dedupe-window=") == 0) {
+            dedupeWindow = std::max(0LL, std::atoll(arg.c_str() + 16));
+        } else {
+            std::cerr << "Unknown option: " << arg << "\n";
+            return 1;
+        }
+    }
+
+    // Ingest a scan log into the roster without starting the UI
+    if (!ingestPath.empty()) {
+        Model model(options);
+        ScanIngester ingester(model, dedupeWindow);
+        if (!ingester.FeedFile(ingestPath)) {
+            std::cerr << "Could not open " << ingestPath << "\n";
+            return 1;
+        }
+        ingester.Finish();
+        model.Flush();
+        const ScanIngester::Stats& stats = ingester.GetStats();
+        std::cout << stats.lines << " scans, " << stats.batches << " batches: " << stats.totals.marked << " marked present, "
+                  << stats.duplicates << " repeats within " << dedupeWindow << "s, " << stats.totals.alreadyPresent
+                  << " already present, " << stats.totals.sessionsStarted << " sessions started, "
+                  << stats.totals.unknown << " unknown, " << stats.totals.notEnrolled << " not enrolled, "
+                  << stats.malformed << " malformed\n";
+        return 0;
+    }
+
+    Controller app(options);
+    app.Run();
+    return 0;
+}
\ No newline at end of file